@@ -0,0 +1,367 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: ancestorindex.cpp                                                   #
+# Description: Summary of the ancestors of every person of a Familytree,    #
+#   for finding common ancestors quickly.                                   #
+# Notes: * Check the ancestorindex.hh for more info.                        #
+#############################################################################
+*/
+#include "ancestorindex.hh"
+#include "querystats.hh"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+
+// States of a person while the signatures are computed.
+enum Visit : std::uint8_t { UNVISITED, VISITING, DONE };
+
+/**
+ * @brief founderBit
+ * @param person without parents
+ * @return the bit of the person in the signatures
+ */
+std::uint64_t founderBit(PersonIndex person)
+{
+    // Fibonacci hashing, the top 6 bits pick the bit.
+    return std::uint64_t(1) << ((person * 0x9E3779B97F4A7C15ULL) >> 58);
+}
+
+} // namespace
+
+AncestorIndex::AncestorIndex(const ChunkedColumn<ParentPair>& parents)
+{
+    std::shared_ptr<Built> built = std::make_shared<Built>();
+    built->parents_ = parents;
+    built->levels_.assign(parents.size(), 0);
+    built->labels_.resize(parents.size() * LABELINGS);
+    std::vector<std::uint64_t> founders(parents.size(), 0);
+    computeFounders(*built, founders);
+    computeLabels(*built);
+    founders_.assign(founders);
+    built_ = std::move(built);
+}
+
+bool AncestorIndex::isAncestor(PersonIndex ancestor, PersonIndex person) const
+{
+    if( ancestor == person )
+    {
+        return false;
+    }
+    if( added_.empty() )
+    {
+        return wasAncestor(ancestor, person);
+    }
+
+    // The persons reached up from the person: the ancestors then of every
+    // one reached, and a parent added to any of them or their ancestors
+    // then. Every added parent is taken once.
+    thread_local std::vector<PersonIndex> reached;
+    thread_local std::vector<bool> taken;
+    reached.assign(1, person);
+    taken.assign(added_.size(), false);
+    for( std::size_t i = 0; i < reached.size(); ++i )
+    {
+        PersonIndex current = reached[i];
+        if( current == ancestor or wasAncestor(ancestor, current) )
+        {
+            return true;
+        }
+        for( std::size_t relation = 0; relation < added_.size(); ++relation )
+        {
+            auto [child, parent] = added_[relation];
+            if( not taken[relation] and (child == current or wasAncestor(child, current)) )
+            {
+                taken[relation] = true;
+                reached.push_back(parent);
+            }
+        }
+    }
+    return false;
+}
+
+void AncestorIndex::addPerson(PersonIndex person)
+{
+    founders_.push_back(founderBit(person));
+}
+
+bool AncestorIndex::addRelation(PersonIndex child, PersonIndex parent)
+{
+    if( added_.size() >= MAX_ADDED_RELATIONS )
+    {
+        return false;
+    }
+    added_.push_back({child, parent});
+    return true;
+}
+
+bool AncestorIndex::addFounders(PersonIndex person, std::uint64_t founders)
+{
+    if( (founders_[person] & founders) == founders )
+    {
+        return false;
+    }
+    founders_.set(person, founders_[person] | founders);
+    return true;
+}
+
+bool AncestorIndex::wasAncestor(PersonIndex ancestor, PersonIndex person) const
+{
+    // Persons added since weren't anybody's ancestors.
+    const ChunkedColumn<ParentPair>& parents = built_->parents_;
+    if( ancestor >= parents.size() or person >= parents.size() )
+    {
+        return false;
+    }
+    Reach answer = reach(ancestor, person);
+    if( answer != Reach::MAYBE )
+    {
+        return answer == Reach::YES;
+    }
+
+    // Search up from the person through the ancestors the labels can't
+    // rule out. One bit per person, only the set ones are cleared after.
+    thread_local std::vector<std::uint64_t> marked;
+    thread_local std::vector<PersonIndex> stack;
+    thread_local std::vector<PersonIndex> visited;
+    if( marked.size() < parents.size() / 64 + 1 )
+    {
+        marked.resize(parents.size() / 64 + 1, 0);
+    }
+    stack.assign(1, person);
+    visited.clear();
+    bool found = false;
+    while( not stack.empty() and not found )
+    {
+        PersonIndex current = stack.back();
+        stack.pop_back();
+        for( PersonIndex parent : parents[current] )
+        {
+            if( parent == NO_PERSON or (marked[parent / 64] >> (parent % 64) & 1) )
+            {
+                continue;
+            }
+            marked[parent / 64] |= std::uint64_t(1) << (parent % 64);
+            visited.push_back(parent);
+            answer = parent == ancestor ? Reach::YES : reach(ancestor, parent);
+            if( answer == Reach::YES )
+            {
+                found = true;
+                break;
+            }
+            if( answer == Reach::MAYBE )
+            {
+                stack.push_back(parent);
+            }
+        }
+    }
+    STATS_VISITED(visited.size());
+    for( PersonIndex person_visited : visited )
+    {
+        marked[person_visited / 64] = 0;
+    }
+    return found;
+}
+
+AncestorIndex::Reach AncestorIndex::reach(PersonIndex ancestor, PersonIndex person) const
+{
+    // Every founder of an ancestor is a founder of its descendants.
+    if( (founders_[ancestor] & ~founders_[person]) != 0 )
+    {
+        return Reach::NO;
+    }
+    const Built& built = *built_;
+    if( built.acyclic_ and built.levels_[ancestor] >= built.levels_[person] )
+    {
+        return Reach::NO;
+    }
+
+    // A walk whose numbers rule the pair out is enough, and so is one that
+    // first reached the person through the ancestor.
+    for( int walk = 0; walk < LABELINGS; ++walk )
+    {
+        const Label& above = built.label(ancestor, walk);
+        const Label& below = built.label(person, walk);
+        if( above.enter_ <= below.post_ and below.post_ < above.post_ )
+        {
+            return Reach::YES;
+        }
+        if( built.acyclic_ and not (above.low_ <= below.low_ and below.post_ < above.post_) )
+        {
+            return Reach::NO;
+        }
+    }
+    return Reach::MAYBE;
+}
+
+void AncestorIndex::computeFounders(Built& built, std::vector<std::uint64_t>& founders)
+{
+    const ChunkedColumn<ParentPair>& parents = built.parents_;
+    std::vector<std::uint32_t>& levels = built.levels_;
+    // Depth first over the parents, so that every person is done after its
+    // parents, without recursing along long lines of ancestors. A person
+    // is on the stack once to visit its parents and again to be done.
+    std::vector<Visit> visits(parents.size(), UNVISITED);
+    std::vector<PersonIndex> stack;
+    for( PersonIndex start = 0; start < parents.size(); ++start )
+    {
+        stack.push_back(start);
+        while( not stack.empty() )
+        {
+            PersonIndex person = stack.back();
+            if( visits[person] == UNVISITED )
+            {
+                visits[person] = VISITING;
+                for( PersonIndex parent : parents[person] )
+                {
+                    if( parent != NO_PERSON and visits[parent] == UNVISITED )
+                    {
+                        stack.push_back(parent);
+                    }
+                }
+                continue;
+            }
+            stack.pop_back();
+            if( visits[person] == DONE )
+            {
+                continue;
+            }
+
+            visits[person] = DONE;
+            std::uint64_t signature = 0;
+            std::uint32_t level = 0;
+            bool has_parents = false;
+            for( PersonIndex parent : parents[person] )
+            {
+                if( parent == NO_PERSON )
+                {
+                    continue;
+                }
+                has_parents = true;
+                // A parent still being visited is in a cycle of relations,
+                // whose ancestors can't be told. Every bit keeps the person
+                // from being skipped.
+                signature |= visits[parent] == DONE ? founders[parent] : ~std::uint64_t(0);
+                level = std::max(level, levels[parent] + 1);
+            }
+            founders[person] = has_parents ? signature : founderBit(person);
+            levels[person] = level;
+        }
+    }
+}
+
+void AncestorIndex::computeLabels(Built& built)
+{
+    const ChunkedColumn<ParentPair>& parents = built.parents_;
+    // Children in compressed rows, a child with the same parent twice once.
+    std::vector<std::uint32_t> offsets(parents.size() + 1, 0);
+    for( PersonIndex person = 0; person < parents.size(); ++person )
+    {
+        const ParentPair& pair = parents[person];
+        for( int slot = 0; slot < 2; ++slot )
+        {
+            if( pair[slot] != NO_PERSON and (slot == 0 or pair[0] != pair[1]) )
+            {
+                ++offsets[pair[slot] + 1];
+            }
+        }
+    }
+    for( std::size_t i = 1; i < offsets.size(); ++i )
+    {
+        offsets[i] += offsets[i - 1];
+    }
+    std::vector<PersonIndex> children(offsets.back());
+    std::vector<std::uint32_t> filled(offsets.begin(), offsets.end() - 1);
+    for( PersonIndex person = 0; person < parents.size(); ++person )
+    {
+        const ParentPair& pair = parents[person];
+        for( int slot = 0; slot < 2; ++slot )
+        {
+            if( pair[slot] != NO_PERSON and (slot == 0 or pair[0] != pair[1]) )
+            {
+                children[filled[pair[slot]]++] = person;
+            }
+        }
+    }
+
+    // Each walk starts from the persons without parents in its own order,
+    // the rest are left only in cycles of relations. Every other walk goes
+    // through the children backwards. The stack holds a person and how
+    // many of its children have been gone to.
+    std::vector<PersonIndex> starts;
+    for( PersonIndex person = 0; person < parents.size(); ++person )
+    {
+        if( parents[person][0] == NO_PERSON and parents[person][1] == NO_PERSON )
+        {
+            starts.push_back(person);
+        }
+    }
+    std::size_t roots = starts.size();
+    for( PersonIndex person = 0; person < parents.size(); ++person )
+    {
+        if( parents[person][0] != NO_PERSON or parents[person][1] != NO_PERSON )
+        {
+            starts.push_back(person);
+        }
+    }
+    std::mt19937 random(parents.size());
+    std::vector<Visit> visits;
+    std::vector<std::pair<PersonIndex, std::uint32_t>> stack;
+    for( int walk = 0; walk < LABELINGS; ++walk )
+    {
+        if( walk > 0 )
+        {
+            std::shuffle(starts.begin(), starts.begin() + roots, random);
+        }
+        bool backwards = walk % 2 == 1;
+        visits.assign(parents.size(), UNVISITED);
+        std::uint32_t finished = 0;
+        for( PersonIndex start : starts )
+        {
+            if( visits[start] != UNVISITED )
+            {
+                continue;
+            }
+            visits[start] = VISITING;
+            built.label(start, walk).enter_ = finished;
+            stack.push_back({start, 0});
+            while( not stack.empty() )
+            {
+                PersonIndex person = stack.back().first;
+                std::uint32_t& gone = stack.back().second;
+                std::uint32_t count = offsets[person + 1] - offsets[person];
+                if( gone < count )
+                {
+                    PersonIndex child = children[backwards ? offsets[person + 1] - 1 - gone
+                                                           : offsets[person] + gone];
+                    ++gone;
+                    if( visits[child] == UNVISITED )
+                    {
+                        visits[child] = VISITING;
+                        built.label(child, walk).enter_ = finished;
+                        stack.push_back({child, 0});
+                    }
+                    else if( visits[child] == VISITING )
+                    {
+                        built.acyclic_ = false;
+                    }
+                    continue;
+                }
+
+                stack.pop_back();
+                visits[person] = DONE;
+                Label& done = built.label(person, walk);
+                done.post_ = finished++;
+                done.low_ = done.enter_;
+                for( std::uint32_t i = offsets[person]; i < offsets[person + 1]; ++i )
+                {
+                    done.low_ = std::min(done.low_, built.label(children[i], walk).low_);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,210 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: ancestorindex.hh                                                    #
+# Description: Summary of the ancestors of every person of a Familytree,    #
+#   for finding common ancestors quickly.                                   #
+#############################################################################
+*/
+#ifndef ANCESTORINDEX_HH
+#define ANCESTORINDEX_HH
+
+#include "chunkedcolumn.hh"
+#include "familytree.hh"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The AncestorIndex class
+ * Summaries of the ancestors and descendants of every person, built in a
+ * few passes over the parents. The index describes the tree as it was
+ * then, and is patched for the persons and parents added since.
+ *
+ * Founder signature: every person without parents is hashed to one of 64
+ * bits, and the signature of a person has the bits of all such ancestors,
+ * or its own if it has no parents. A common ancestor of two persons has a
+ * signature contained in both of theirs, so two persons whose signatures
+ * share no bit are not related, and a search for the common ancestors can
+ * skip every person whose signature shares no bit with the other person's.
+ *
+ * Levels: the length of the longest line of ancestors of a person. An
+ * ancestor has a lower level than its descendants, which also bounds how
+ * far up a search for an ancestor goes.
+ *
+ * Reachability labels: the persons are numbered in the order a depth first
+ * walk down the children finishes them. The descendants the walk first
+ * reached through a person are numbered from the person's enter number to
+ * its own, so such a pair is answered at once. Every descendant of a person
+ * has a number between the person's low number, the smallest of all its
+ * descendants, and its own, so a pair outside that range is not related.
+ * A few walks are taken, each going through the founders and the children
+ * in a different order. Only the pairs none of them answers, reached
+ * through a second parent in all of them, are searched, and the search
+ * skips the persons the labels rule out.
+ *
+ * Changes: the signatures of the new persons are added, and a new parent's
+ * bits are added to the descendants of the child. The levels and labels
+ * stay those of the tree the index was built from, and the parents added
+ * since are kept in a list, so a question about the tree now is answered
+ * from the questions about the old tree the added parents lead to. Those
+ * grow with the list, so it is kept short.
+ */
+class AncestorIndex
+{
+public:
+    /**
+     * @brief AncestorIndex
+     * @param parents of every person of the tree
+     */
+    explicit AncestorIndex(const ChunkedColumn<ParentPair>& parents);
+
+    // Most parents added since the index was built.
+    static const std::size_t MAX_ADDED_RELATIONS = 128;
+
+    /**
+     * @brief mayShareAncestor
+     * @param first
+     * @param second
+     * @return false if the persons surely have no common ancestor, where a
+     * person counts as its own ancestor
+     */
+    bool mayShareAncestor(PersonIndex first, PersonIndex second) const
+    {
+        return (founders_[first] & founders_[second]) != 0;
+    }
+
+    /**
+     * @brief isAncestor
+     * @param ancestor
+     * @param person
+     * @return true if ancestor is a parent, grandparent etc. of person
+     * Safe to call from many threads.
+     */
+    bool isAncestor(PersonIndex ancestor, PersonIndex person) const;
+
+    /**
+     * @brief founders
+     * @param person
+     * @return the founder signature of the person
+     */
+    std::uint64_t founders(PersonIndex person) const
+    {
+        return founders_[person];
+    }
+
+    /**
+     * @brief addPerson
+     * @param person added to the tree, without parents
+     */
+    void addPerson(PersonIndex person);
+
+    /**
+     * @brief addRelation
+     * @param child
+     * @param parent added to the child
+     * @return false if MAX_ADDED_RELATIONS parents have been added already,
+     * the index then being left to be built again
+     * The founders of the parent are to be added to the descendants of the
+     * child with addFounders.
+     */
+    bool addRelation(PersonIndex child, PersonIndex parent);
+
+    /**
+     * @brief addFounders
+     * @param person
+     * @param founders bits of a new ancestor
+     * @return true if the signature of the person grew, false if it had the
+     * bits already, as do its descendants then
+     */
+    bool addFounders(PersonIndex person, std::uint64_t founders);
+
+private:
+    // Answer of the labels alone.
+    enum class Reach { NO, YES, MAYBE };
+
+    /**
+     * @brief wasAncestor
+     * @param ancestor
+     * @param person other than ancestor
+     * @return true if ancestor was an ancestor of person in the tree the
+     * index was built from
+     */
+    bool wasAncestor(PersonIndex ancestor, PersonIndex person) const;
+
+    /**
+     * @brief reach
+     * @param ancestor
+     * @param person other than ancestor
+     * @return whether the labels tell if ancestor is an ancestor of person
+     */
+    Reach reach(PersonIndex ancestor, PersonIndex person) const;
+
+    // Numbers of a walk down the children, see above.
+    struct Label
+    {
+        std::uint32_t low_;
+        std::uint32_t enter_;
+        std::uint32_t post_;
+    };
+
+    // Walks in different orders, each ruling out pairs the others can't.
+    static constexpr int LABELINGS = 2;
+
+    // Summary of the tree the index was built from, shared by the patched
+    // copies of the index.
+    struct Built
+    {
+        /**
+         * @brief label
+         * @param person
+         * @param walk
+         * @return the numbers of the person in the walk
+         */
+        Label& label(PersonIndex person, int walk)
+        {
+            return labels_[person * LABELINGS + walk];
+        }
+        const Label& label(PersonIndex person, int walk) const
+        {
+            return labels_[person * LABELINGS + walk];
+        }
+
+        // The parents then, searched when the labels can't tell.
+        ChunkedColumn<ParentPair> parents_;
+        // Longest line of ancestors of every person.
+        std::vector<std::uint32_t> levels_;
+        std::vector<Label> labels_;
+
+        // The levels and low numbers are only valid without cycles of
+        // relations.
+        bool acyclic_ = true;
+    };
+
+    /**
+     * @brief computeFounders
+     * @param built
+     * @param founders filled with the signatures
+     * Compute the founder signatures and the levels.
+     */
+    static void computeFounders(Built& built, std::vector<std::uint64_t>& founders);
+
+    /**
+     * @brief computeLabels
+     * @param built
+     */
+    static void computeLabels(Built& built);
+
+    std::shared_ptr<const Built> built_;
+
+    // Signatures of every person, patched by the changes.
+    ChunkedColumn<std::uint64_t> founders_;
+
+    // Children and the parents added to them since the index was built.
+    std::vector<std::pair<PersonIndex, PersonIndex>> added_;
+};
+
+#endif // ANCESTORINDEX_HH
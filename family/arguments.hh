@@ -0,0 +1,123 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: arguments.hh                                                        #
+# Description: Parameters of a command, with the numeric ones parsed.       #
+#############################################################################
+*/
+#ifndef ARGUMENTS_HH
+#define ARGUMENTS_HH
+
+#include "utils.hh"
+
+#include <cstddef>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief The Arguments class
+ * Parameters of a command, viewing the command line. Every parameter is
+ * parsed as a number once, when the arguments are set, so the numeric ones
+ * are checked and then read by the command without parsing them again.
+ */
+class Arguments
+{
+public:
+    using const_iterator = std::vector<std::string_view>::const_iterator;
+
+    Arguments() = default;
+
+    Arguments(std::initializer_list<std::string_view> words)
+    {
+        assign(words.begin(), words.end());
+    }
+
+    template <typename Iterator>
+    Arguments(Iterator first, Iterator last)
+    {
+        assign(first, last);
+    }
+
+    /**
+     * @brief assign
+     * @param first
+     * @param last
+     * Sets the arguments to the words from first to last, reusing the
+     * memory of the earlier ones.
+     */
+    template <typename Iterator>
+    void assign(Iterator first, Iterator last)
+    {
+        words_.assign(first, last);
+        numbers_.resize(words_.size());
+        for( std::size_t i = 0; i < words_.size(); ++i )
+        {
+            if( not Utils::parseNumber(words_[i], numbers_[i]) )
+            {
+                numbers_[i] = NOT_NUMBER;
+            }
+        }
+    }
+
+    std::size_t size() const
+    {
+        return words_.size();
+    }
+
+    bool empty() const
+    {
+        return words_.empty();
+    }
+
+    std::string_view at(std::size_t i) const
+    {
+        return words_.at(i);
+    }
+
+    std::string_view front() const
+    {
+        return words_.front();
+    }
+
+    const_iterator begin() const
+    {
+        return words_.begin();
+    }
+
+    const_iterator end() const
+    {
+        return words_.end();
+    }
+
+    /**
+     * @brief isNumber
+     * @param i
+     * @return true if the i:th argument is a non-negative number that fits
+     * to an int
+     */
+    bool isNumber(std::size_t i) const
+    {
+        return numbers_.at(i) != NOT_NUMBER;
+    }
+
+    /**
+     * @brief number
+     * @param i
+     * @return the value of the i:th argument, which must be a number
+     */
+    int number(std::size_t i) const
+    {
+        return numbers_.at(i);
+    }
+
+private:
+    // Value of an argument that isn't a number.
+    static const int NOT_NUMBER = -1;
+
+    std::vector<std::string_view> words_;
+    std::vector<int> numbers_;
+};
+
+#endif // ARGUMENTS_HH
@@ -0,0 +1,45 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: allocations.cpp                                                     #
+# Description: Counting of the heap allocations of the benchmarks.          #
+# Notes: * Check the allocations.hh for more info.                          #
+#############################################################################
+*/
+#include "allocations.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<std::uint64_t> allocations{0};
+}
+
+std::uint64_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+// The array forms default to these.
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if( void* memory = std::malloc(size == 0 ? 1 : size) )
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
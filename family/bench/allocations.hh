@@ -0,0 +1,22 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: allocations.hh                                                      #
+# Description: Counting of the heap allocations of the benchmarks. Replaces #
+#   the global operator new, so it is linked into the benchmark only.       #
+#############################################################################
+*/
+#ifndef ALLOCATIONS_HH
+#define ALLOCATIONS_HH
+
+#include <cstdint>
+
+/**
+ * @brief allocationCount
+ * @return number of operator new calls made by the process so far, from any
+ * thread
+ */
+std::uint64_t allocationCount();
+
+#endif // ALLOCATIONS_HH
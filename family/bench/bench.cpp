@@ -0,0 +1,1819 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: bench.cpp                                                           #
+# Description: Benchmarks for the Familytree module. Builds synthetic trees #
+#   of growing size and times the queries on them. Every result is one      #
+#   JSON object per line on the standard output.                            #
+#############################################################################
+*/
+#include "familytree.hh"
+#include "allocations.hh"
+#include "bufferedsink.hh"
+#include "cli.hh"
+#include "loader.hh"
+#include "mappedfile.hh"
+#include "mutationlog.hh"
+#include "pedigree.hh"
+#include "queryexecutor.hh"
+#include "server.hh"
+#include "client/queryclient.hh"
+#include "snapshot.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Number of timed queries per tree size.
+const int LOOKUP_QUERIES = 200000;
+
+// Persons per generation and timed queries per level in benchGenerations.
+const int GENERATION_WIDTH = 100;
+const int GENERATION_QUERIES = 2000;
+
+// Timed commands per person-taking command in benchCommands.
+const int COMMAND_QUERIES = 20000;
+
+// Queries per thread count in benchExecutor.
+const int EXECUTOR_QUERIES = 200000;
+
+// Changes per changing command in benchCommands.
+const int MUTATION_QUERIES = 10;
+
+// Writes timed one at a time, writes per second of each phase, and the
+// length of each phase in benchMutations. The first phase has no writer.
+const int MUTATION_WRITES = 1000;
+const double MUTATION_WRITE_RATES[] = {0.0, 10.0, 100.0, 1000.0};
+const double MUTATION_SECONDS = 3.0;
+
+// Records replayed, and writers and commits per writer, in benchLog.
+const int LOG_RECORDS = 1000000;
+const int LOG_WRITERS = 8;
+const int LOG_COMMITS = 200;
+
+// Timed pairs per kind of relation in benchRelation.
+const int RELATION_QUERIES = 2000;
+
+// Queries about CACHE_PERSONS persons in benchCache, and the queries
+// between the changes of the tree in its second round.
+const int CACHE_QUERIES = 200000;
+const int CACHE_PERSONS = 500;
+const int CACHE_CHANGE_INTERVAL = 1000;
+
+// Persons asked about per degree and removal in benchCousins.
+const int COUSIN_QUERIES = 200;
+
+// Pairs per kind in benchAncestors, and how many of them the parent
+// walk it is compared to answers.
+const int ANCESTOR_PAIRS = 1000000;
+const int ANCESTOR_WALKS = 2000;
+
+// Lines per kind in benchTokenizer, the times each is split, and the
+// length of the ids on its long lines.
+const int TOKENIZER_LINES = 1000;
+const int TOKENIZER_ROUNDS = 200;
+const int TOKENIZER_LONG_ID_LENGTH = 200;
+
+// Queries of each kind in benchHeights, the k of HEIGHT-TOP, and the
+// times the members of the lineages are filtered.
+const int HEIGHT_QUERIES = 200;
+const int HEIGHT_TOP_K = 10;
+const int HEIGHT_FILTER_ROUNDS = 20;
+
+// Queries of each kind in benchHeightStats, the times the heights of the
+// members are summed, and the largest datafile the commands of every root
+// and leaf are timed with, as they go through every lineage.
+const int STATS_QUERIES = 50;
+const int STATS_SUM_ROUNDS = 20;
+const int STATS_ALL_MAX_PERSONS = 100000;
+
+// Times every command name is looked up in benchDispatch.
+const int DISPATCH_ROUNDS = 20000;
+
+// Queries per client and concurrent clients in benchDaemon.
+const int DAEMON_QUERIES = 20000;
+const int DAEMON_CLIENTS = 8;
+
+// Shape of the generated datafiles, apart from the size.
+const int DATAFILE_GENERATIONS = 20;
+const double DATAFILE_FANOUT = 3.0;
+const double DATAFILE_COLLAPSE = 0.1;
+const int DATAFILE_ID_LENGTH = 12;
+
+/**
+ * @brief The Record class
+ * One benchmark result, printed as a JSON object on its own line.
+ */
+class Record
+{
+public:
+    /**
+     * @brief Record
+     * @param bench name of the benchmark
+     */
+    explicit Record(const std::string& bench)
+    {
+        add("bench", bench);
+    }
+
+    /**
+     * @brief add
+     * @param key
+     * @param value number or string
+     * @return the record, for chaining
+     */
+    template <typename T>
+    Record& add(const std::string& key, const T& value)
+    {
+        fields_ << (first_ ? "" : ",") << '"' << key << "\":";
+        first_ = false;
+        if constexpr( std::is_arithmetic_v<T> )
+        {
+            fields_ << value;
+        }
+        else
+        {
+            fields_ << '"';
+            for( char c : std::string(value) )
+            {
+                if( c == '"' or c == '\\' )
+                {
+                    fields_ << '\\';
+                }
+                fields_ << c;
+            }
+            fields_ << '"';
+        }
+        return *this;
+    }
+
+    /**
+     * @brief print
+     * Print the record, flushing so that the line is out before a fork.
+     */
+    void print() const
+    {
+        std::cout << '{' << fields_.str() << '}' << std::endl;
+    }
+
+private:
+    std::ostringstream fields_;
+    bool first_ = true;
+};
+
+/**
+ * @brief runIsolated
+ * @param func benchmark to run
+ * @return peak resident set size of the benchmark in kilobytes
+ * Run the benchmark in a child process, so that its memory use is measured
+ * alone and freed afterwards.
+ */
+template <typename Func>
+long runIsolated(Func func)
+{
+    std::cout.flush();
+    pid_t child = fork();
+    if( child == 0 )
+    {
+        func();
+        std::cout.flush();
+        _exit(EXIT_SUCCESS);
+    }
+
+    struct rusage usage{};
+    if( child < 0 )
+    {
+        func();
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+    int status = 0;
+    wait4(child, &status, 0, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * @brief personId
+ * @param index
+ * @return synthetic id for the person with the given running number
+ */
+std::string personId(int index)
+{
+    return "person-" + std::to_string(index);
+}
+
+/**
+ * @brief buildTree
+ * @param tree
+ * @param size
+ * @return seconds spent in addNewPerson and addRelation
+ * Fill the tree with size persons whose parents are drawn from the
+ * previously added persons.
+ */
+double buildTree(Familytree& tree, int size)
+{
+    std::mt19937 random(size);
+    std::ostream null_output(nullptr);
+    Clock::time_point start = Clock::now();
+
+    for( int i = 0; i < size; ++i )
+    {
+        tree.addNewPerson(personId(i), 150 + i % 50, null_output);
+    }
+    for( int i = 1; i < size; ++i )
+    {
+        std::uniform_int_distribution<int> earlier(0, i - 1);
+        tree.addRelation(personId(i),
+                         {personId(earlier(random)), personId(earlier(random))},
+                         null_output);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+ * @brief randomQueries
+ * @param size
+ * @return parameter lists naming random persons of a tree of the given size
+ */
+std::vector<std::vector<std::string>> randomQueries(int size)
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> any(0, size - 1);
+    std::vector<std::vector<std::string>> queries;
+    queries.reserve(LOOKUP_QUERIES);
+    for( int i = 0; i < LOOKUP_QUERIES; ++i )
+    {
+        queries.push_back({personId(any(random))});
+    }
+    return queries;
+}
+
+/**
+ * @brief timeQueries
+ * @param tree
+ * @param func query to run
+ * @param queries
+ * @return average nanoseconds per query
+ */
+double timeQueries(const Familytree& tree,
+                   void (Familytree::*func)(Params, std::ostream&) const,
+                   const std::vector<std::vector<std::string>>& queries)
+{
+    // The parameters view the strings, like they view the command line in
+    // the program.
+    std::vector<Arguments> views;
+    for( const auto& params : queries )
+    {
+        views.emplace_back(params.begin(), params.end());
+    }
+
+    std::ostream null_output(nullptr);
+    Clock::time_point start = Clock::now();
+    for( const auto& params : views )
+    {
+        (tree.*func)(params, null_output);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return seconds * 1e9 / queries.size();
+}
+
+/**
+ * @brief benchLookup
+ * @param size
+ * Time id lookups through printParents on a tree of the given size.
+ */
+void benchLookup(int size)
+{
+    Familytree tree;
+    double build_seconds = buildTree(tree, size);
+
+    Record("lookup")
+        .add("persons", size)
+        .add("build_s", build_seconds)
+        .add("ns_per_query", timeQueries(tree, &Familytree::printParents, randomQueries(size)))
+        .print();
+}
+
+/**
+ * @brief benchChildren
+ * @param size
+ * Time the queries walking children lists, before and after freezing.
+ */
+void benchChildren(int size)
+{
+    Familytree tree;
+    buildTree(tree, size);
+    std::vector<std::vector<std::string>> queries = randomQueries(size);
+
+    for( bool frozen : {false, true} )
+    {
+        double freeze_seconds = 0;
+        if( frozen )
+        {
+            Clock::time_point start = Clock::now();
+            tree.freeze();
+            freeze_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        Record("children")
+            .add("persons", size)
+            .add("frozen", frozen)
+            .add("freeze_s", freeze_seconds)
+            .add("children_ns", timeQueries(tree, &Familytree::printChildren, queries))
+            .add("siblings_ns", timeQueries(tree, &Familytree::printSiblings, queries))
+            .add("cousins_ns", timeQueries(tree, &Familytree::printCousins, queries))
+            .add("tallest_ns", timeQueries(tree, &Familytree::printTallestInLineage, queries))
+            .add("shortest_ns", timeQueries(tree, &Familytree::printShortestInLineage, queries))
+            .print();
+    }
+}
+
+/**
+ * @brief benchGenerations
+ * @param size
+ * Time GRANDPARENTS and GRANDCHILDREN at growing levels on a deep tree of
+ * narrow generations, where every person's parents are drawn from the
+ * previous generation, so a few levels up all the paths share ancestors.
+ */
+void benchGenerations(int size)
+{
+    Familytree tree;
+    std::ostream null_output(nullptr);
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> in_generation(0, GENERATION_WIDTH - 1);
+    std::vector<IndexedRelation> relations;
+    for( int i = 0; i < size; ++i )
+    {
+        tree.addNewPerson(personId(i), 150 + i % 50, null_output);
+        if( i >= GENERATION_WIDTH )
+        {
+            PersonIndex previous = (i / GENERATION_WIDTH - 1) * GENERATION_WIDTH;
+            relations.push_back({PersonIndex(i),
+                                 {previous + in_generation(random),
+                                  previous + in_generation(random)}});
+        }
+    }
+    tree.addRelations(relations, 1);
+
+    // Grandparents are asked for the last generations, grandchildren for
+    // the first ones, so that the deep levels exist.
+    std::uniform_int_distribution<int> any(0, std::min(size, GENERATION_QUERIES) - 1);
+    std::vector<std::vector<std::string>> up_queries;
+    std::vector<std::vector<std::string>> down_queries;
+    for( int level : {1, 4, 16, 64} )
+    {
+        up_queries.clear();
+        down_queries.clear();
+        for( int i = 0; i < GENERATION_QUERIES; ++i )
+        {
+            int person = any(random);
+            up_queries.push_back({personId(size - 1 - person), std::to_string(level)});
+            down_queries.push_back({personId(person), std::to_string(level)});
+        }
+        Record("generations")
+            .add("persons", size)
+            .add("width", GENERATION_WIDTH)
+            .add("level", level)
+            .add("grandparents_ns", timeQueries(tree, &Familytree::printGrandParentsN, up_queries))
+            .add("grandchildren_ns", timeQueries(tree, &Familytree::printGrandChildrenN, down_queries))
+            .print();
+    }
+}
+
+/**
+ * @brief splitByChar
+ * @param str
+ * @param delim
+ * @return the parts of the string, like Utils::split
+ * The way Utils::split worked before it was built on Utils::tokenize, for
+ * comparison.
+ */
+std::vector<std::string> splitByChar(const std::string& str, char delim)
+{
+    std::vector<std::string> result = {""};
+    bool insideQuotation = false;
+    for( char currentChar : str )
+    {
+        if( currentChar == '"' )
+        {
+            insideQuotation = not insideQuotation;
+        }
+        else if( currentChar == delim and not insideQuotation )
+        {
+            result.push_back("");
+        }
+        else
+        {
+            result.back().push_back(currentChar);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief benchTokenizer
+ * Time splitting command lines, command lines with quoted ids, datafile
+ * lines and datafile lines with long ids, with the old char at a time split,
+ * the current split and tokenize with every instruction set the processor
+ * has.
+ */
+void benchTokenizer()
+{
+    struct Kind
+    {
+        std::string name_;
+        char delim_;
+        std::vector<std::string> lines_;
+    };
+    std::vector<Kind> kinds = {{"command", ' ', {}}, {"quoted_command", ' ', {}},
+                               {"datafile", ';', {}}, {"long_datafile", ';', {}}};
+    for( int i = 0; i < TOKENIZER_LINES; ++i )
+    {
+        std::string id = pedigreeId(i, DATAFILE_ID_LENGTH);
+        std::string long_id = pedigreeId(i, TOKENIZER_LONG_ID_LENGTH);
+        kinds[0].lines_.push_back("CHILDREN " + id);
+        kinds[1].lines_.push_back("COUSINS-N \"" + id + " " + id + "\" 2 1");
+        kinds[2].lines_.push_back(id + ";170;" + id + ";" + id);
+        kinds[3].lines_.push_back(long_id + ";170;" + long_id + ";" + long_id);
+    }
+
+    std::vector<std::pair<std::string, Utils::Scan>> scans = {{"tokenize_scalar", Utils::Scan::SCALAR}};
+    if( Utils::bestScan() != Utils::Scan::SCALAR )
+    {
+        scans.push_back({"tokenize_sse2", Utils::Scan::SSE2});
+    }
+    if( Utils::bestScan() == Utils::Scan::AVX2 )
+    {
+        scans.push_back({"tokenize_avx2", Utils::Scan::AVX2});
+    }
+
+    // The lengths of the parts are summed, so that the splitting isn't
+    // optimized away.
+    std::size_t chars = 0;
+    auto time = [&](const Kind& kind, const std::string& method, const auto& split)
+    {
+        std::uint64_t allocated = allocationCount();
+        Clock::time_point start = Clock::now();
+        for( int round = 0; round < TOKENIZER_ROUNDS; ++round )
+        {
+            for( const std::string& line : kind.lines_ )
+            {
+                chars += split(line, kind.delim_);
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        double lines = double(TOKENIZER_ROUNDS) * kind.lines_.size();
+        Record("tokenizer")
+            .add("lines", kind.name_)
+            .add("method", method)
+            .add("ns_per_line", seconds * 1e9 / lines)
+            .add("allocs_per_line", (allocationCount() - allocated) / lines)
+            .print();
+    };
+    auto totalSize = [](const auto& parts)
+    {
+        std::size_t total = 0;
+        for( const auto& part : parts )
+        {
+            total += part.size();
+        }
+        return total;
+    };
+
+    Utils::Tokens tokens;
+    for( const Kind& kind : kinds )
+    {
+        time(kind, "split_by_char", [&](const std::string& line, char delim)
+        {
+            return totalSize(splitByChar(line, delim));
+        });
+        time(kind, "split", [&](const std::string& line, char delim)
+        {
+            return totalSize(Utils::split(line, delim));
+        });
+        for( const auto& [method, scan] : scans )
+        {
+            time(kind, method, [&, scan = scan](const std::string& line, char delim)
+            {
+                Utils::tokenize(line, delim, tokens, scan);
+                return totalSize(tokens);
+            });
+        }
+    }
+    if( chars == 0 )
+    {
+        std::cout << "No chars split." << std::endl;
+    }
+}
+
+/**
+ * @brief findByScan
+ * @param commands
+ * @param name in any case
+ * @return the command with the name, compared to every name in turn like
+ * Cli did before its perfect hash, or nullptr
+ */
+const CommandInfo* findByScan(const std::array<CommandInfo, COMMAND_COUNT>& commands,
+                              std::string_view name)
+{
+    auto sameName = [name](std::string_view alias)
+    {
+        return alias.size() == name.size()
+                and std::equal(alias.begin(), alias.end(), name.begin(),
+                               [](char upper, char any)
+        {
+            return upper == std::toupper(static_cast<unsigned char>(any));
+        });
+    };
+    for( const CommandInfo& command : commands )
+    {
+        if( std::any_of(command.allNames_.begin(), command.allNames_.end(), sameName) )
+        {
+            return &command;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief benchDispatch
+ * Time finding the command of every name of every command in lower case,
+ * and of as many unknown names, by comparing to every name and with the
+ * perfect hash of the Cli.
+ */
+void benchDispatch()
+{
+    Cli commandline(std::make_shared<Familytree>());
+    std::vector<std::string> names;
+    for( const CommandInfo& command : commandline.commands() )
+    {
+        for( std::string_view alias : command.allNames_ )
+        {
+            std::string name(alias);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            names.push_back(name);
+            names.push_back(name + "X");
+        }
+    }
+
+    // The found commands are counted, so that the lookups aren't optimized
+    // away. Half of the names are known.
+    std::size_t found = 0;
+    auto time = [&](const std::string& method, const auto& find)
+    {
+        Clock::time_point start = Clock::now();
+        for( int round = 0; round < DISPATCH_ROUNDS; ++round )
+        {
+            for( const std::string& name : names )
+            {
+                found += find(name) != nullptr;
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Record("dispatch")
+            .add("names", names.size())
+            .add("method", method)
+            .add("ns_per_name", seconds * 1e9 / (double(DISPATCH_ROUNDS) * names.size()))
+            .print();
+    };
+    time("scan", [&](std::string_view name)
+    {
+        return findByScan(commandline.commands(), name);
+    });
+    time("perfect_hash", [&](std::string_view name)
+    {
+        return commandline.findCommand(name);
+    });
+    if( found != std::size_t(DISPATCH_ROUNDS) * names.size() )
+    {
+        std::cout << "Wrong commands found." << std::endl;
+    }
+}
+
+/**
+ * @brief writeDatafile
+ * @param path
+ * @param size
+ * @return size of the written file in bytes
+ * Write a generated pedigree of size persons to the file.
+ */
+std::uintmax_t writeDatafile(const std::string& path, int size)
+{
+    PedigreeOptions options;
+    options.persons_ = size;
+    options.generations_ = std::min(size, DATAFILE_GENERATIONS);
+    options.fanout_ = DATAFILE_FANOUT;
+    options.collapse_ = DATAFILE_COLLAPSE;
+    options.id_length_ = DATAFILE_ID_LENGTH;
+    options.seed_ = size;
+
+    std::ofstream datafile(path);
+    writePedigree(datafile, options);
+    datafile.close();
+    return std::filesystem::file_size(path);
+}
+
+/**
+ * @brief benchLoad
+ * @param path datafile of size persons
+ * @param size
+ * Time loading the datafile as a stream, mapped with different numbers of
+ * threads, and as a snapshot.
+ */
+void benchLoad(const std::string& path, int size)
+{
+    double megabytes = std::filesystem::file_size(path) / 1e6;
+
+    // Messages of the loaders go to std::cout, none are expected here.
+    {
+        std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+        Clock::time_point start = Clock::now();
+        std::ifstream datafile(path);
+        Loader::populateDatabase(datafile, tree);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Record("load")
+            .add("persons", size)
+            .add("mode", "stream")
+            .add("s", seconds)
+            .add("mb_per_s", megabytes / seconds)
+            .print();
+    }
+    std::set<unsigned int> thread_counts = {1, 2, 4, std::thread::hardware_concurrency()};
+    for( unsigned int threads : thread_counts )
+    {
+        std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+        Clock::time_point start = Clock::now();
+        MappedFile datafile;
+        datafile.open(path, MappedFile::Access::SEQUENTIAL);
+        Loader::populateDatabase(datafile.contents(), tree, threads);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Record("load")
+            .add("persons", size)
+            .add("mode", "mapped")
+            .add("threads", threads)
+            .add("s", seconds)
+            .add("mb_per_s", megabytes / seconds)
+            .print();
+    }
+
+    // Snapshot of the same tree, timed up to the first answered query.
+    std::string snapshot_path = path + ".snapshot";
+    {
+        std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+        MappedFile datafile;
+        datafile.open(path, MappedFile::Access::SEQUENTIAL);
+        Loader::populateDatabase(datafile.contents(), tree);
+        Snapshot::save(*tree, snapshot_path);
+    }
+    {
+        Clock::time_point start = Clock::now();
+        std::shared_ptr<MappedFile> snapshot = std::make_shared<MappedFile>();
+        snapshot->open(snapshot_path);
+        std::shared_ptr<Familytree> tree = Snapshot::load(snapshot);
+        std::ostream null_output(nullptr);
+        tree->printChildren({pedigreeId(0, DATAFILE_ID_LENGTH)}, null_output);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Record("load")
+            .add("persons", size)
+            .add("mode", "snapshot")
+            .add("s", seconds)
+            .add("mb", std::filesystem::file_size(snapshot_path) / 1e6)
+            .print();
+    }
+    std::remove(snapshot_path.c_str());
+}
+
+/**
+ * @brief benchCommands
+ * @param path datafile of size persons
+ * @param size
+ * Load the datafile the way the program does and run every command of the
+ * CLI on it in batch mode, the results going to /dev/null.
+ */
+void benchCommands(const std::string& path, int size)
+{
+    Clock::time_point start = Clock::now();
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+    Record("startup")
+        .add("persons", size)
+        .add("s", std::chrono::duration<double>(Clock::now() - start).count())
+        .add("id_bytes_per_person", double(tree->idBytes()) / size)
+        .print();
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    std::string snapshot_path = path + ".snapshot";
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> any(0, size - 1);
+    {
+        BufferedSink sink(null_fd);
+        std::ostream output(&sink);
+        Cli interactive(tree);
+        for( const CommandInfo& command : interactive.commands() )
+        {
+            bool mutation = command.mutatorPtr_ != nullptr;
+            if( command.funcPtr_ == nullptr and not mutation )
+            {
+                continue;
+            }
+
+            // Commands about a person are asked about random persons, the
+            // others only once. Every change copies the tree, so there are
+            // only a few of them, adding new persons.
+            auto hasParam = [&command](std::string_view name)
+            {
+                return std::any_of(command.params_.begin(), command.params_.end(),
+                                   [name](const Param& param) { return param.name_ == name; });
+            };
+            bool per_person = hasParam("person");
+            bool adds_person = mutation and hasParam("height");
+            int count = mutation ? MUTATION_QUERIES : per_person ? COMMAND_QUERIES : 1;
+            std::string script;
+            for( int i = 0; i < count; ++i )
+            {
+                script += command.allNames_.front();
+                for( const Param& command_param : command.params_ )
+                {
+                    std::string_view param = command_param.name_;
+                    script += ' ';
+                    if( param == "person" and adds_person )
+                    {
+                        script += pedigreeId(size + i, DATAFILE_ID_LENGTH);
+                    }
+                    else if( param == "person" or param == "father" or param == "mother" )
+                    {
+                        script += pedigreeId(any(random), DATAFILE_ID_LENGTH);
+                    }
+                    else if( param == "height" or param == "min" )
+                    {
+                        script += "170";
+                    }
+                    else if( param == "max" )
+                    {
+                        script += "180";
+                    }
+                    else if( param == "file" )
+                    {
+                        script += snapshot_path;
+                    }
+                    else
+                    {
+                        script += "2";
+                    }
+                }
+                script += '\n';
+            }
+
+            std::istringstream input(script);
+            Cli commandline(tree, input, output, false);
+            start = Clock::now();
+            std::uint64_t allocated = allocationCount();
+            while( commandline.exec_prompt() ){}
+            output.flush();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            Record("command")
+                .add("persons", size)
+                .add("command", command.allNames_.front())
+                .add("queries", count)
+                .add("ns_per_query", seconds * 1e9 / count)
+                .add("allocs_per_query", double(allocationCount() - allocated) / count)
+                .print();
+        }
+    }
+    close(null_fd);
+    std::remove(snapshot_path.c_str());
+}
+
+/**
+ * @brief benchExecutor
+ * @param path datafile of size persons
+ * @param size
+ * Time a mix of read queries through the QueryExecutor with growing
+ * numbers of threads.
+ */
+void benchExecutor(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+
+    const std::vector<std::string> commands = {"CHILDREN", "PARENTS", "SIBLINGS",
+                                               "COUSINS", "TALLEST", "SHORTEST"};
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> any(0, size - 1);
+    std::vector<std::string> lines;
+    for( int i = 0; i < EXECUTOR_QUERIES; ++i )
+    {
+        lines.push_back(commands.at(i % commands.size()) + " "
+                        + pedigreeId(any(random), DATAFILE_ID_LENGTH));
+    }
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    {
+        BufferedSink sink(null_fd);
+        std::ostream output(&sink);
+        Cli commandline(tree);
+        std::set<unsigned int> thread_counts = {1, 2, 4, std::thread::hardware_concurrency()};
+        for( unsigned int threads : thread_counts )
+        {
+            QueryExecutor executor(commandline, threads);
+            Clock::time_point start = Clock::now();
+            executor.run(lines, output);
+            output.flush();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            Record("executor")
+                .add("persons", size)
+                .add("threads", threads)
+                .add("queries", lines.size())
+                .add("queries_per_s", lines.size() / seconds)
+                .print();
+        }
+    }
+    close(null_fd);
+}
+
+/**
+ * @brief benchDaemon
+ * @param path datafile of size persons
+ * @param size
+ * Start a daemon on the datafile and measure the round trip times of
+ * queries from one and from several clients at a time.
+ */
+void benchDaemon(const std::string& path, int size)
+{
+    std::string socket_path = path + ".socket";
+    std::cout.flush();
+    pid_t daemon = fork();
+    if( daemon == 0 )
+    {
+        std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+        std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+        datafile->open(path, MappedFile::Access::SEQUENTIAL);
+        Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+        Cli commandline(tree);
+        Server server(commandline);
+        _exit(server.listen(socket_path) and server.run() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if( daemon < 0 )
+    {
+        return;
+    }
+
+    const std::vector<std::string> commands = {"CHILDREN", "PARENTS", "SIBLINGS",
+                                               "COUSINS", "TALLEST", "SHORTEST"};
+    for( int clients : {1, DAEMON_CLIENTS} )
+    {
+        std::vector<std::vector<double>> latencies(clients);
+        std::vector<std::thread> threads;
+        for( int client = 0; client < clients; ++client )
+        {
+            threads.emplace_back([&, client]()
+            {
+                // The daemon is listening once it has loaded the tree.
+                QueryClient connection;
+                while( not connection.connect(socket_path) )
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                std::mt19937 random(client);
+                std::uniform_int_distribution<int> any(0, size - 1);
+                std::string response;
+                for( int i = 0; i < DAEMON_QUERIES; ++i )
+                {
+                    std::string line = commands.at(i % commands.size()) + " "
+                                       + pedigreeId(any(random), DATAFILE_ID_LENGTH);
+                    Clock::time_point start = Clock::now();
+                    connection.query(line, response);
+                    latencies.at(client).push_back(
+                        std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                }
+            });
+        }
+        for( std::thread& thread : threads )
+        {
+            thread.join();
+        }
+
+        std::vector<double> all;
+        for( const std::vector<double>& client_latencies : latencies )
+        {
+            all.insert(all.end(), client_latencies.begin(), client_latencies.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto percentile = [&all](double share)
+        {
+            return all.at(std::min(all.size() - 1, static_cast<std::size_t>(share * all.size())));
+        };
+        Record("daemon")
+            .add("persons", size)
+            .add("clients", clients)
+            .add("queries", all.size())
+            .add("p50_us", percentile(0.5))
+            .add("p99_us", percentile(0.99))
+            .add("p999_us", percentile(0.999))
+            .add("max_us", all.back())
+            .print();
+    }
+    kill(daemon, SIGTERM);
+    waitpid(daemon, nullptr, 0);
+}
+
+/**
+ * @brief benchMutations
+ * @param path datafile of size persons
+ * @param size
+ * Measure the time of one write, adding a person and a relation, and the
+ * latency of reads running next to a writer at a steady rate, and without
+ * the writer for comparison.
+ */
+void benchMutations(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+    Cli commandline(tree);
+
+    const std::vector<std::string> commands = {"CHILDREN", "PARENTS", "SIBLINGS",
+                                               "COUSINS", "TALLEST", "SHORTEST"};
+    unsigned int readers = std::max(2U, std::thread::hardware_concurrency() - 1);
+    int added = 0;
+
+    // Every write adds a person and makes an existing one its parent.
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> any(0, size - 1);
+    std::ostream null_output(nullptr);
+    auto write = [&]()
+    {
+        std::string id = pedigreeId(size + added++, DATAFILE_ID_LENGTH);
+        commandline.execute("ADD " + id + " 170", null_output);
+        commandline.execute("RELATE " + id + " "
+                            + pedigreeId(any(random), DATAFILE_ID_LENGTH) + " -",
+                            null_output);
+    };
+
+    std::vector<double> write_times;
+    for( int i = 0; i < MUTATION_WRITES; ++i )
+    {
+        Clock::time_point start = Clock::now();
+        write();
+        write_times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    double total_us = std::accumulate(write_times.begin(), write_times.end(), 0.0);
+    std::sort(write_times.begin(), write_times.end());
+    Record("mutation_write")
+        .add("persons", size)
+        .add("writes", write_times.size())
+        .add("mean_us", total_us / write_times.size())
+        .add("p50_us", write_times.at(write_times.size() / 2))
+        .add("p99_us", write_times.at(write_times.size() * 99 / 100))
+        .print();
+
+    for( double write_rate : MUTATION_WRITE_RATES )
+    {
+        std::atomic<bool> stopping{false};
+        std::vector<std::vector<double>> latencies(readers);
+        std::vector<std::thread> threads;
+        for( unsigned int reader = 0; reader < readers; ++reader )
+        {
+            threads.emplace_back([&, reader]()
+            {
+                std::mt19937 random(reader);
+                std::uniform_int_distribution<int> any(0, size - 1);
+                std::ostream null_output(nullptr);
+                for( int i = 0; not stopping.load(); ++i )
+                {
+                    std::string line = commands.at(i % commands.size()) + " "
+                                       + pedigreeId(any(random), DATAFILE_ID_LENGTH);
+                    Clock::time_point start = Clock::now();
+                    commandline.execute(line, null_output);
+                    latencies.at(reader).push_back(
+                        std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                }
+            });
+        }
+
+        int writes = 0;
+        Clock::time_point start = Clock::now();
+        Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+                                    std::chrono::duration<double>(MUTATION_SECONDS));
+        while( Clock::now() < end )
+        {
+            if( write_rate == 0 )
+            {
+                std::this_thread::sleep_until(end);
+                break;
+            }
+            write();
+            ++writes;
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+                                              std::chrono::duration<double>(writes / write_rate)));
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        stopping.store(true);
+        for( std::thread& thread : threads )
+        {
+            thread.join();
+        }
+
+        std::vector<double> all;
+        for( const std::vector<double>& reader_latencies : latencies )
+        {
+            all.insert(all.end(), reader_latencies.begin(), reader_latencies.end());
+        }
+        std::sort(all.begin(), all.end());
+        auto percentile = [&all](double share)
+        {
+            return all.at(std::min(all.size() - 1, static_cast<std::size_t>(share * all.size())));
+        };
+        Record("mutations")
+            .add("persons", size)
+            .add("readers", readers)
+            .add("target_writes_per_s", write_rate)
+            .add("writes_per_s", writes / seconds)
+            .add("reads", all.size())
+            .add("p50_us", percentile(0.5))
+            .add("p99_us", percentile(0.99))
+            .add("p999_us", percentile(0.999))
+            .print();
+    }
+}
+
+/**
+ * @brief benchLog
+ * @param path datafile of size persons
+ * @param size
+ * Measure the rate of logged changes with one and with many writers
+ * sharing syncs, and the time of replaying a log of LOG_RECORDS changes
+ * compared to loading the datafile.
+ */
+void benchLog(const std::string& path, int size)
+{
+    std::string log_path = path + ".log";
+    for( int writers : {1, LOG_WRITERS} )
+    {
+        std::remove(log_path.c_str());
+        MutationLog log;
+        log.open(log_path, [](const MutationLog::Records&) {});
+        std::vector<std::thread> threads;
+        Clock::time_point start = Clock::now();
+        for( int writer = 0; writer < writers; ++writer )
+        {
+            threads.emplace_back([&, writer]()
+            {
+                for( int i = 0; i < LOG_COMMITS; ++i )
+                {
+                    std::string id = pedigreeId(size + writer * LOG_COMMITS + i,
+                                                DATAFILE_ID_LENGTH);
+                    log.commit(log.append({"ADD", id, "170"}));
+                }
+            });
+        }
+        for( std::thread& thread : threads )
+        {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Record("log_commit")
+            .add("persons", size)
+            .add("writers", writers)
+            .add("commits_per_s", writers * LOG_COMMITS / seconds)
+            .print();
+    }
+
+    // Every new person is added and given a parent from the datafile.
+    std::remove(log_path.c_str());
+    {
+        MutationLog log;
+        log.open(log_path, [](const MutationLog::Records&) {});
+        std::mt19937 random(size);
+        std::uniform_int_distribution<int> any(0, size - 1);
+        std::uint64_t last = 0;
+        for( int i = 0; i < LOG_RECORDS / 2; ++i )
+        {
+            std::string id = pedigreeId(size + i, DATAFILE_ID_LENGTH);
+            log.append({"ADD", id, "170"});
+            last = log.append({"RELATE", id, pedigreeId(any(random), DATAFILE_ID_LENGTH), "-"});
+        }
+        log.commit(last);
+    }
+
+    Clock::time_point start = Clock::now();
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+    double load_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    Cli commandline(tree);
+    commandline.openLog(log_path);
+    double replay_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    Record("log_replay")
+        .add("persons", size)
+        .add("records", LOG_RECORDS)
+        .add("log_mb", std::filesystem::file_size(log_path) / 1e6)
+        .add("load_ms", load_seconds * 1e3)
+        .add("replay_ms", replay_seconds * 1e3)
+        .add("ns_per_record", replay_seconds * 1e9 / LOG_RECORDS)
+        .print();
+    std::remove(log_path.c_str());
+}
+
+/**
+ * @brief readParents
+ * @param path generated datafile
+ * @param size
+ * @return the parents of every person
+ * The pedigree ids are running numbers, so the parents can be read from
+ * the datafile straight into indices.
+ */
+std::vector<ParentPair> readParents(const std::string& path, int size)
+{
+    std::vector<ParentPair> parents(size, ParentPair{NO_PERSON, NO_PERSON});
+    std::ifstream lines(path);
+    std::string line;
+    for( PersonIndex person = 0; std::getline(lines, line); ++person )
+    {
+        std::vector<std::string> fields = Utils::split(line, ';');
+        for( int slot = 0; slot < 2; ++slot )
+        {
+            if( fields.at(2 + slot) != "-" )
+            {
+                parents[person][slot] = std::stoi(fields.at(2 + slot).substr(1));
+            }
+        }
+    }
+    return parents;
+}
+
+/**
+ * @brief fullAncestorSearch
+ * @param parents of every person
+ * @param first
+ * @param second
+ * @return the fewest steps in total from both persons to a common ancestor,
+ * or -1 if they have none
+ * Reference for benchRelation: every ancestor of both persons, breadth
+ * first.
+ */
+int fullAncestorSearch(const std::vector<ParentPair>& parents,
+                       PersonIndex first, PersonIndex second)
+{
+    // Steps from both persons, -1 for none. Only the persons reached are
+    // reset afterwards.
+    thread_local std::vector<int> steps[2];
+    std::vector<PersonIndex> reached[2];
+    PersonIndex starts[2] = {first, second};
+    for( int side = 0; side < 2; ++side )
+    {
+        steps[side].resize(parents.size(), -1);
+        reached[side] = {starts[side]};
+        steps[side][starts[side]] = 0;
+        for( std::size_t i = 0; i < reached[side].size(); ++i )
+        {
+            PersonIndex person = reached[side][i];
+            for( PersonIndex parent : parents[person] )
+            {
+                if( parent != NO_PERSON and steps[side][parent] < 0 )
+                {
+                    steps[side][parent] = steps[side][person] + 1;
+                    reached[side].push_back(parent);
+                }
+            }
+        }
+    }
+
+    int best = -1;
+    for( PersonIndex person : reached[1] )
+    {
+        if( steps[0][person] >= 0 and (best < 0 or steps[0][person] + steps[1][person] < best) )
+        {
+            best = steps[0][person] + steps[1][person];
+        }
+    }
+    for( int side = 0; side < 2; ++side )
+    {
+        for( PersonIndex person : reached[side] )
+        {
+            steps[side][person] = -1;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief benchRelation
+ * @param path datafile of size persons
+ * @param size
+ * Time RELATION on pairs of the last generation of the pedigree: cousins
+ * of growing degree, found by walking up and down from a person, and
+ * random pairs. Compared to searching all ancestors of both persons.
+ */
+void benchRelation(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+
+    std::vector<ParentPair> parents = readParents(path, size);
+    std::vector<std::vector<PersonIndex>> children(size);
+    for( PersonIndex person = 0; person < parents.size(); ++person )
+    {
+        for( PersonIndex parent : parents[person] )
+        {
+            if( parent != NO_PERSON )
+            {
+                children[parent].push_back(person);
+            }
+        }
+    }
+
+    std::ostream null_output(nullptr);
+    Clock::time_point start = Clock::now();
+    tree->printRelation({pedigreeId(0, DATAFILE_ID_LENGTH), pedigreeId(size - 1, DATAFILE_ID_LENGTH)},
+                        null_output);
+    double index_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> last_generation(size - size / DATAFILE_GENERATIONS, size - 1);
+    for( int degree : {1, 2, 4, 0} )
+    {
+        // Degree 0 is random pairs.
+        std::vector<std::pair<PersonIndex, PersonIndex>> pairs;
+        while( pairs.size() < RELATION_QUERIES )
+        {
+            PersonIndex first = last_generation(random);
+            PersonIndex second = last_generation(random);
+            if( degree > 0 )
+            {
+                second = first;
+                for( int step = 0; step <= degree and second != NO_PERSON; ++step )
+                {
+                    second = parents[second][random() % 2];
+                }
+                for( int step = 0; step <= degree and second != NO_PERSON; ++step )
+                {
+                    const std::vector<PersonIndex>& candidates = children[second];
+                    second = candidates.empty() ? NO_PERSON : candidates[random() % candidates.size()];
+                }
+            }
+            if( second != NO_PERSON and second != first )
+            {
+                pairs.push_back({first, second});
+            }
+        }
+
+        std::vector<std::vector<std::string>> queries;
+        for( const auto& pair : pairs )
+        {
+            queries.push_back({pedigreeId(pair.first, DATAFILE_ID_LENGTH),
+                               pedigreeId(pair.second, DATAFILE_ID_LENGTH)});
+        }
+        double relation_ns = timeQueries(*tree, &Familytree::printRelation, queries);
+        start = Clock::now();
+        for( const auto& pair : pairs )
+        {
+            fullAncestorSearch(parents, pair.first, pair.second);
+        }
+        double full_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+                         / pairs.size();
+        Record("relation")
+            .add("persons", size)
+            .add("cousin_degree", degree)
+            .add("index_ms", index_ms)
+            .add("relation_ns", relation_ns)
+            .add("full_search_ns", full_ns)
+            .print();
+    }
+}
+/**
+ * @brief benchCousins
+ * @param path datafile of size persons
+ * @param size
+ * Time COUSINS-N for persons of the last generation, whose number of
+ * cousins grows with the degree, and COUSINS against its first degree.
+ */
+void benchCousins(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> last_generation(size - size / DATAFILE_GENERATIONS, size - 1);
+    std::vector<std::string> persons;
+    for( int i = 0; i < COUSIN_QUERIES; ++i )
+    {
+        persons.push_back(pedigreeId(last_generation(random), DATAFILE_ID_LENGTH));
+    }
+
+    for( int degree : {1, 2, 3, 4} )
+    {
+        for( int removed : {0, 1} )
+        {
+            std::vector<std::vector<std::string>> queries;
+            for( const std::string& person : persons )
+            {
+                queries.push_back({person, std::to_string(degree), std::to_string(removed)});
+            }
+
+            // The output has a line per cousin and one more per query.
+            std::ostringstream output;
+            for( const auto& params : queries )
+            {
+                tree->printCousinsN({params.begin(), params.end()}, output);
+            }
+            std::string text = output.str();
+            double cousins = double(std::count(text.begin(), text.end(), '\n') - queries.size())
+                             / queries.size();
+
+            Record record("cousins");
+            record.add("persons", size)
+                .add("degree", degree)
+                .add("removed", removed)
+                .add("mean_cousins", cousins)
+                .add("ns_per_query", timeQueries(*tree, &Familytree::printCousinsN, queries));
+            if( degree == 1 and removed == 0 )
+            {
+                std::vector<std::vector<std::string>> first;
+                for( const std::string& person : persons )
+                {
+                    first.push_back({person});
+                }
+                record.add("cousins_ns", timeQueries(*tree, &Familytree::printCousins, first));
+            }
+            record.print();
+        }
+    }
+}
+
+/**
+ * @brief benchHeights
+ * @param path datafile of size persons
+ * @param size
+ * Time HEIGHT-COUNT, HEIGHT-RANGE and HEIGHT-TOP with the height index,
+ * and LINEAGE-RANGE for persons of the first half of the datafile. Then the
+ * filter of LINEAGE-RANGE alone, over random members, with every
+ * instruction set the processor has.
+ */
+void benchHeights(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+
+    // The generated heights are from 100 to 200 cm.
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> low(100, 190);
+    std::uniform_int_distribution<int> first_half(0, size / 2);
+    std::vector<std::vector<std::string>> counts;
+    std::vector<std::vector<std::string>> ranges;
+    std::vector<std::vector<std::string>> tops;
+    std::vector<std::vector<std::string>> lineages;
+    for( int i = 0; i < HEIGHT_QUERIES; ++i )
+    {
+        std::string from = std::to_string(low(random));
+        std::string to = std::to_string(std::stoi(from) + 10);
+        counts.push_back({from, to});
+        ranges.push_back({from, from});
+        tops.push_back({std::to_string(HEIGHT_TOP_K)});
+        lineages.push_back({pedigreeId(first_half(random), DATAFILE_ID_LENGTH), from, to});
+    }
+    Record("heights")
+        .add("persons", size)
+        .add("count_ns", timeQueries(*tree, &Familytree::printHeightCount, counts))
+        .add("range_1cm_ns", timeQueries(*tree, &Familytree::printHeightRange, ranges))
+        .add("top_ns", timeQueries(*tree, &Familytree::printTallestK, tops))
+        .add("lineage_range_ns", timeQueries(*tree, &Familytree::printLineageHeightRange, lineages))
+        .print();
+
+    std::vector<int> heights(size);
+    for( int& height : heights )
+    {
+        height = low(random);
+    }
+    std::uniform_int_distribution<std::uint32_t> any(0, size - 1);
+    std::vector<std::uint32_t> members(size / 10 + 1);
+    for( std::uint32_t& member : members )
+    {
+        member = any(random);
+    }
+    std::vector<std::pair<std::string, Utils::Scan>> scans = {{"scalar", Utils::Scan::SCALAR}};
+    if( Utils::bestScan() == Utils::Scan::AVX2 )
+    {
+        scans.push_back({"avx2", Utils::Scan::AVX2});
+    }
+    std::vector<std::uint32_t> selected;
+    std::size_t found = 0;
+    for( const auto& [method, scan] : scans )
+    {
+        Clock::time_point start = Clock::now();
+        for( int round = 0; round < HEIGHT_FILTER_ROUNDS; ++round )
+        {
+            Utils::selectInRange(heights.data(), members, 170, 180, selected, scan);
+            found += selected.size();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Record("height_filter")
+            .add("persons", size)
+            .add("members", members.size())
+            .add("method", method)
+            .add("ns_per_member", seconds * 1e9 / (double(HEIGHT_FILTER_ROUNDS) * members.size()))
+            .print();
+    }
+    if( found == 0 )
+    {
+        std::cout << "No heights selected." << std::endl;
+    }
+}
+
+/**
+ * @brief benchHeightStats
+ * @param path datafile of size persons
+ * @param size
+ * Time LINEAGE-STATS and ANCESTRY-STATS for persons of the datafile, and
+ * LINEAGE-STATS-ALL and ANCESTRY-STATS-ALL once on small datafiles. Then the sum and the
+ * squared deviations of the heights alone, over random members, with every
+ * instruction set the processor has.
+ */
+void benchHeightStats(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> first_half(0, size / 2);
+    std::uniform_int_distribution<int> second_half(size / 2, size - 1);
+    std::vector<std::vector<std::string>> lineages;
+    std::vector<std::vector<std::string>> ancestries;
+    for( int i = 0; i < STATS_QUERIES; ++i )
+    {
+        lineages.push_back({pedigreeId(first_half(random), DATAFILE_ID_LENGTH)});
+        ancestries.push_back({pedigreeId(second_half(random), DATAFILE_ID_LENGTH)});
+    }
+    Record record("height_stats");
+    record.add("persons", size)
+        .add("lineage_ns", timeQueries(*tree, &Familytree::printLineageStats, lineages))
+        .add("ancestry_ns", timeQueries(*tree, &Familytree::printAncestryStats, ancestries));
+    if( size <= STATS_ALL_MAX_PERSONS )
+    {
+        record.add("lineage_all_ns", timeQueries(*tree, &Familytree::printLineageStatsOfRoots, {{}}))
+            .add("ancestry_all_ns", timeQueries(*tree, &Familytree::printAncestryStatsOfLeaves, {{}}));
+    }
+    record.print();
+
+    std::uniform_int_distribution<int> height(100, 200);
+    std::vector<int> heights(size);
+    for( int& value : heights )
+    {
+        value = height(random);
+    }
+    std::uniform_int_distribution<std::uint32_t> any(0, size - 1);
+    std::vector<std::uint32_t> members(size / 10 + 1);
+    for( std::uint32_t& member : members )
+    {
+        member = any(random);
+    }
+    std::vector<std::pair<std::string, Utils::Scan>> scans = {{"scalar", Utils::Scan::SCALAR}};
+    if( Utils::bestScan() == Utils::Scan::AVX2 )
+    {
+        scans.push_back({"avx2", Utils::Scan::AVX2});
+    }
+    std::vector<int> gathered;
+    double total = 0;
+    for( const auto& [method, scan] : scans )
+    {
+        Clock::time_point start = Clock::now();
+        for( int round = 0; round < STATS_SUM_ROUNDS; ++round )
+        {
+            Utils::Summary summary = Utils::gatherValues(heights.data(), members, gathered, scan);
+            double mean = double(summary.sum_) / gathered.size();
+            total += Utils::squaredDeviations(gathered, mean, scan);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        Record("height_sums")
+            .add("persons", size)
+            .add("members", members.size())
+            .add("method", method)
+            .add("ns_per_member", seconds * 1e9 / (double(STATS_SUM_ROUNDS) * members.size()))
+            .print();
+    }
+    if( total == 0 )
+    {
+        std::cout << "No deviations summed." << std::endl;
+    }
+}
+
+/**
+ * @brief benchCache
+ * @param path datafile of size persons
+ * @param size
+ * Time queries about a few popular persons through the result cache of the
+ * Cli, against calling the Familytree directly. Then again with the parents
+ * of a person swapped now and then, each change dropping the results near
+ * the person.
+ */
+void benchCache(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+    std::vector<ParentPair> parents = readParents(path, size);
+
+    const std::vector<std::string> commands = {"CHILDREN", "SIBLINGS", "COUSINS",
+                                               "GRANDPARENTS", "COUSINS-N"};
+    const std::vector<std::string> numbers = {"", "", "", " 2", " 2 0"};
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> last_generation(size - size / DATAFILE_GENERATIONS, size - 1);
+    std::vector<PersonIndex> persons;
+    for( int i = 0; i < CACHE_PERSONS; ++i )
+    {
+        persons.push_back(last_generation(random));
+    }
+    std::vector<std::string> lines;
+    for( int i = 0; i < CACHE_QUERIES; ++i )
+    {
+        std::size_t command = random() % commands.size();
+        lines.push_back(commands.at(command) + " "
+                        + pedigreeId(persons.at(random() % persons.size()), DATAFILE_ID_LENGTH)
+                        + numbers.at(command));
+    }
+
+    std::ostream null_output(nullptr);
+    Cli commandline(tree);
+    Utils::Tokens tokens;
+    Arguments params;
+    Clock::time_point start = Clock::now();
+    for( const std::string& line : lines )
+    {
+        Utils::tokenize(line, ' ', tokens);
+        params.assign(tokens.begin() + 1, tokens.end());
+        const CommandInfo* command = commandline.commandOf(line);
+        (tree.get()->*(command->funcPtr_))(params, null_output);
+    }
+    double direct_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+                       / lines.size();
+
+    start = Clock::now();
+    for( const std::string& line : lines )
+    {
+        commandline.execute(line, null_output);
+    }
+    double cached_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+                       / lines.size();
+    ResultCache::Stats stats = commandline.cacheStats();
+    Record("cache")
+        .add("persons", size)
+        .add("changes", 0)
+        .add("direct_ns", direct_ns)
+        .add("cached_ns", cached_ns)
+        .add("hits", stats.hits_)
+        .add("misses", stats.misses_)
+        .add("invalidated", stats.invalidated_)
+        .print();
+
+    // A change swaps the parents of a random person of the last generation.
+    // Only the queries are timed, the changes copy the whole tree.
+    Cli changing(tree);
+    int changes = 0;
+    double query_seconds = 0;
+    for( std::size_t i = 0; i < lines.size(); i += CACHE_CHANGE_INTERVAL )
+    {
+        PersonIndex child = last_generation(random);
+        changing.execute("RELATE " + pedigreeId(child, DATAFILE_ID_LENGTH) + " "
+                         + pedigreeId(parents[child][1], DATAFILE_ID_LENGTH) + " "
+                         + pedigreeId(parents[child][0], DATAFILE_ID_LENGTH), null_output);
+        std::swap(parents[child][0], parents[child][1]);
+        ++changes;
+
+        start = Clock::now();
+        for( std::size_t j = i; j < std::min(lines.size(), i + CACHE_CHANGE_INTERVAL); ++j )
+        {
+            changing.execute(lines[j], null_output);
+        }
+        query_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    cached_ns = query_seconds * 1e9 / lines.size();
+    stats = changing.cacheStats();
+    Record("cache")
+        .add("persons", size)
+        .add("changes", changes)
+        .add("direct_ns", direct_ns)
+        .add("cached_ns", cached_ns)
+        .add("hits", stats.hits_)
+        .add("misses", stats.misses_)
+        .add("invalidated", stats.invalidated_)
+        .print();
+}
+
+/**
+ * @brief walkParents
+ * @param parents of every person
+ * @param ancestor
+ * @param person
+ * @return true if ancestor is an ancestor of person
+ * Reference for benchAncestors: depth first up from the person.
+ */
+bool walkParents(const std::vector<ParentPair>& parents, PersonIndex ancestor, PersonIndex person)
+{
+    thread_local std::vector<bool> seen;
+    seen.assign(parents.size(), false);
+    std::vector<PersonIndex> stack = {person};
+    while( not stack.empty() )
+    {
+        PersonIndex current = stack.back();
+        stack.pop_back();
+        for( PersonIndex parent : parents[current] )
+        {
+            if( parent == ancestor )
+            {
+                return true;
+            }
+            if( parent != NO_PERSON and not seen[parent] )
+            {
+                seen[parent] = true;
+                stack.push_back(parent);
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief benchAncestors
+ * @param path datafile of size persons
+ * @param size
+ * Time isAncestor on random pairs, mostly unrelated, and on pairs of a
+ * person and one of its ancestors, one at a time and in bulk. Compared to
+ * walking the parents.
+ */
+void benchAncestors(const std::string& path, int size)
+{
+    std::shared_ptr<MappedFile> datafile = std::make_shared<MappedFile>();
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    datafile->open(path, MappedFile::Access::SEQUENTIAL);
+    Loader::populateDatabase(datafile->contents(), tree, std::thread::hardware_concurrency());
+    std::vector<ParentPair> parents = readParents(path, size);
+
+    Clock::time_point start = Clock::now();
+    tree->isAncestor(0, size - 1);
+    double index_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::mt19937 random(size);
+    std::uniform_int_distribution<int> any(0, size - 1);
+    for( bool related : {false, true} )
+    {
+        std::vector<AncestryPair> pairs;
+        while( pairs.size() < ANCESTOR_PAIRS )
+        {
+            PersonIndex person = any(random);
+            PersonIndex ancestor = any(random);
+            if( related )
+            {
+                // Up a random number of generations along random parents.
+                ancestor = person;
+                for( int steps = 1 + random() % DATAFILE_GENERATIONS; steps > 0; --steps )
+                {
+                    PersonIndex parent = parents[ancestor][random() % 2];
+                    if( parent == NO_PERSON )
+                    {
+                        break;
+                    }
+                    ancestor = parent;
+                }
+                if( ancestor == person )
+                {
+                    continue;
+                }
+            }
+            pairs.push_back({ancestor, person});
+        }
+
+        start = Clock::now();
+        std::size_t found = 0;
+        for( const AncestryPair& pair : pairs )
+        {
+            found += tree->isAncestor(pair.ancestor_, pair.person_);
+        }
+        double single_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+                           / pairs.size();
+
+        unsigned int threads = std::thread::hardware_concurrency();
+        start = Clock::now();
+        std::vector<std::uint8_t> answers = tree->areAncestors(pairs, threads);
+        double bulk_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for( int i = 0; i < ANCESTOR_WALKS; ++i )
+        {
+            walkParents(parents, pairs[i].ancestor_, pairs[i].person_);
+        }
+        double walk_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+                         / ANCESTOR_WALKS;
+
+        Record("ancestors")
+            .add("persons", size)
+            .add("related", related ? "yes" : "no")
+            .add("index_ms", index_ms)
+            .add("ancestors_found", found)
+            .add("ns_per_pair", single_ns)
+            .add("threads", threads)
+            .add("bulk_pairs_per_s", pairs.size() / bulk_seconds)
+            .add("walk_ns", walk_ns)
+            .print();
+    }
+}
+}
+
+/**
+ * @brief main
+ * @param argc
+ * @param argv tree sizes to benchmark, defaults to 10^4 ... 10^7
+ * @return
+ * Every benchmark runs in a child process of its own. The peak memory use
+ * of the program is the one of loading the datafile and running the
+ * commands.
+ */
+int main(int argc, char* argv[])
+{
+    std::vector<int> sizes = {10000, 100000, 1000000, 10000000};
+    if( argc > 1 )
+    {
+        sizes.clear();
+        for( int i = 1; i < argc; ++i )
+        {
+            sizes.push_back(std::atoi(argv[i]));
+        }
+    }
+
+    runIsolated([&]() { benchTokenizer(); });
+    runIsolated([&]() { benchDispatch(); });
+    for( int size : sizes )
+    {
+        std::string path = (std::filesystem::temp_directory_path()
+                            / ("familybench-" + std::to_string(size) + ".csv")).string();
+        std::uintmax_t bytes = writeDatafile(path, size);
+
+        long peak_kb = runIsolated([&]() { benchCommands(path, size); });
+        Record("memory")
+            .add("persons", size)
+            .add("datafile_mb", bytes / 1e6)
+            .add("peak_rss_kb", peak_kb)
+            .add("bytes_per_person", peak_kb * 1024.0 / size)
+            .print();
+
+        runIsolated([&]() { benchLoad(path, size); });
+        runIsolated([&]() { benchExecutor(path, size); });
+        runIsolated([&]() { benchCache(path, size); });
+        runIsolated([&]() { benchDaemon(path, size); });
+        runIsolated([&]() { benchMutations(path, size); });
+        runIsolated([&]() { benchLog(path, size); });
+        runIsolated([&]() { benchRelation(path, size); });
+        runIsolated([&]() { benchAncestors(path, size); });
+        runIsolated([&]() { benchCousins(path, size); });
+        runIsolated([&]() { benchHeights(path, size); });
+        runIsolated([&]() { benchHeightStats(path, size); });
+        runIsolated([&]() { benchLookup(size); });
+        runIsolated([&]() { benchChildren(size); });
+        runIsolated([&]() { benchGenerations(size); });
+        std::remove(path.c_str());
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+TEMPLATE = app
+TARGET = familybench
+CONFIG += console c++17 thread
+CONFIG -= app_bundle
+CONFIG -= qt
+
+INCLUDEPATH += ..
+
+SOURCES += bench.cpp \
+    allocations.cpp \
+    pedigree.cpp \
+    ../client/queryclient.cpp \
+    ../ancestorindex.cpp \
+    ../bufferedsink.cpp \
+    ../cli.cpp \
+    ../familytree.cpp \
+    ../loader.cpp \
+    ../mappedfile.cpp \
+    ../mutationlog.cpp \
+    ../queryexecutor.cpp \
+    ../querystats.cpp \
+    ../resultcache.cpp \
+    ../server.cpp \
+    ../snapshot.cpp \
+    ../threadpool.cpp \
+    ../treeversions.cpp \
+    ../utils.cpp
+
+HEADERS += \
+    allocations.hh \
+    pedigree.hh \
+    ../client/queryclient.hh \
+    ../ancestorindex.hh \
+    ../arguments.hh \
+    ../bufferedsink.hh \
+    ../chunkedcolumn.hh \
+    ../cli.hh \
+    ../column.hh \
+    ../commandtable.hh \
+    ../familytree.hh \
+    ../loader.hh \
+    ../mappedfile.hh \
+    ../mutationlog.hh \
+    ../personset.hh \
+    ../protocol.hh \
+    ../queryexecutor.hh \
+    ../querystats.hh \
+    ../resultcache.hh \
+    ../server.hh \
+    ../snapshot.hh \
+    ../stringsink.hh \
+    ../threadpool.hh \
+    ../treeversions.hh \
+    ../utils.hh
@@ -0,0 +1,93 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: generator.cpp                                                       #
+# Description: Writes a synthetic pedigree datafile for testing and         #
+#   benchmarking the program.                                               #
+# Notes: * Usage: familygen [-n persons] [-g generations] [-f fanout] [-c   #
+#          collapse] [-l id_length] [-s seed] [-o file]                     #
+#############################################################################
+*/
+#include "pedigree.hh"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace
+{
+/**
+ * @brief printUsage
+ * @param program
+ * Print the command line options.
+ */
+void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [-n persons] [-g generations] [-f fanout] [-c collapse]"
+                 " [-l id_length] [-s seed] [-o file]" << std::endl;
+}
+}
+
+/**
+ * @brief main
+ * @return
+ * Write a pedigree of the given shape to the output file or, without one,
+ * to the standard output.
+ */
+int main(int argc, char* argv[])
+{
+    PedigreeOptions options;
+    std::string output_path;
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string option = argv[i];
+        if( i + 1 == argc or option.size() != 2 or option.at(0) != '-' )
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        std::string value = argv[++i];
+        try
+        {
+            switch( option.at(1) )
+            {
+            case 'n': options.persons_ = std::stoi(value); break;
+            case 'g': options.generations_ = std::stoi(value); break;
+            case 'f': options.fanout_ = std::stod(value); break;
+            case 'c': options.collapse_ = std::stod(value); break;
+            case 'l': options.id_length_ = std::stoi(value); break;
+            case 's': options.seed_ = std::stoul(value); break;
+            case 'o': output_path = value; break;
+            default:
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        catch( const std::exception& )
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::ofstream output_file;
+    if( not output_path.empty() )
+    {
+        output_file.open(output_path);
+        if( not output_file )
+        {
+            std::cerr << "Could not open file: " << output_path << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& output = output_path.empty() ? std::cout : output_file;
+    if( not writePedigree(output, options) )
+    {
+        std::cerr << "Invalid options or write error." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,11 @@
+TEMPLATE = app
+TARGET = familygen
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+
+SOURCES += generator.cpp \
+    pedigree.cpp
+
+HEADERS += \
+    pedigree.hh
@@ -0,0 +1,83 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: pedigree.cpp                                                        #
+# Description: Synthetic pedigrees in the datafile format for the           #
+#   benchmarks and the generator.                                           #
+# Notes: * Check the pedigree.hh for more info.                             #
+#############################################################################
+*/
+#include "pedigree.hh"
+
+#include <algorithm>
+#include <random>
+
+std::string pedigreeId(int index, int id_length)
+{
+    std::string number = std::to_string(index);
+    int padding = std::max(0, id_length - 1 - static_cast<int>(number.size()));
+    return "P" + std::string(padding, '0') + number;
+}
+
+bool writePedigree(std::ostream& output, const PedigreeOptions& options)
+{
+    if( options.persons_ < 1 or options.generations_ < 1
+        or options.generations_ > options.persons_
+        or options.fanout_ < 1 or options.collapse_ < 0 or options.collapse_ > 1 )
+    {
+        return false;
+    }
+
+    std::mt19937_64 random(options.seed_);
+    std::uniform_int_distribution<int> height(100, 200);
+    std::bernoulli_distribution collapsed(options.collapse_);
+
+    // The children of a couple get consecutive running numbers, so persons
+    // close to each other in a generation are siblings or cousins.
+    int window = std::max(1, static_cast<int>(2 * options.fanout_));
+    int previous_first = 0;
+    int previous_size = 0;
+    int first = 0;
+    for( int generation = 0; generation < options.generations_; ++generation )
+    {
+        int size = options.persons_ / options.generations_
+                   + (generation < options.persons_ % options.generations_ ? 1 : 0);
+        int couples = std::max(1, static_cast<int>(size / options.fanout_));
+        int couple = -1;
+        std::string father = "-";
+        std::string mother = "-";
+        for( int child = 0; child < size; ++child )
+        {
+            if( generation > 0 and child * static_cast<long long>(couples) / size != couple )
+            {
+                couple = child * static_cast<long long>(couples) / size;
+                int father_index = std::uniform_int_distribution<int>(0, previous_size - 1)(random);
+                int mother_index = 0;
+                if( collapsed(random) )
+                {
+                    int low = std::max(0, father_index - window);
+                    int high = std::min(previous_size - 1, father_index + window);
+                    mother_index = std::uniform_int_distribution<int>(low, high)(random);
+                }
+                else
+                {
+                    mother_index = std::uniform_int_distribution<int>(0, previous_size - 1)(random);
+                }
+                if( mother_index == father_index and previous_size > 1 )
+                {
+                    mother_index = (father_index + 1) % previous_size;
+                }
+                father = pedigreeId(previous_first + father_index, options.id_length_);
+                mother = pedigreeId(previous_first + mother_index, options.id_length_);
+            }
+            output << pedigreeId(first + child, options.id_length_) << ';'
+                   << height(random) << ';' << father << ';' << mother << '\n';
+        }
+        previous_first = first;
+        previous_size = size;
+        first += size;
+    }
+    output.flush();
+    return static_cast<bool>(output);
+}
@@ -0,0 +1,61 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: pedigree.hh                                                         #
+# Description: Synthetic pedigrees in the datafile format for the           #
+#   benchmarks and the generator.                                           #
+#############################################################################
+*/
+#ifndef PEDIGREE_HH
+#define PEDIGREE_HH
+
+#include <iostream>
+#include <string>
+
+/**
+ * @brief The PedigreeOptions struct
+ * Shape of a generated pedigree. The persons are split evenly into
+ * generations, the first generation has no parents, and every later person
+ * has a father and a mother from the previous generation.
+ */
+struct PedigreeOptions
+{
+    // Number of persons in the datafile.
+    int persons_ = 10000;
+
+    // Number of generations, at least one.
+    int generations_ = 10;
+
+    // Average number of children per couple.
+    double fanout_ = 3.0;
+
+    // Share of couples whose partners are close relatives, such as
+    // siblings and cousins, instead of random persons of the generation.
+    double collapse_ = 0.1;
+
+    // Minimum length of the ids, longer ids are padded with zeros.
+    int id_length_ = 8;
+
+    unsigned int seed_ = 1;
+};
+
+/**
+ * @brief pedigreeId
+ * @param index running number of the person
+ * @param id_length
+ * @return id of the person in a pedigree generated with the id_length
+ */
+std::string pedigreeId(int index, int id_length);
+
+/**
+ * @brief writePedigree
+ * @param output
+ * @param options
+ * @return true if the options were valid and writing succeeded
+ * Write the pedigree as datafile lines id;height;father;mother, persons
+ * in the order of their running numbers.
+ */
+bool writePedigree(std::ostream& output, const PedigreeOptions& options);
+
+#endif // PEDIGREE_HH
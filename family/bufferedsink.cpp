@@ -0,0 +1,95 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: bufferedsink.cpp                                                    #
+# Description: Output stream buffer that collects the output to a large     #
+#   buffer and writes it with one system call when the buffer fills.        #
+# Notes: * Check the bufferedsink.hh for more info.                         #
+#############################################################################
+*/
+#include "bufferedsink.hh"
+
+#include <cerrno>
+#include <unistd.h>
+
+BufferedSink::BufferedSink(int fd, std::size_t capacity):
+    fd_(fd), buffer_(capacity > 0 ? capacity : 1)
+{
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+BufferedSink::~BufferedSink()
+{
+    flushBuffer();
+}
+
+BufferedSink::int_type BufferedSink::overflow(int_type c)
+{
+    if( not flushBuffer() )
+    {
+        return traits_type::eof();
+    }
+    if( not traits_type::eq_int_type(c, traits_type::eof()) )
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize BufferedSink::xsputn(const char* data, std::streamsize count)
+{
+    std::size_t size = static_cast<std::size_t>(count);
+    std::size_t space = static_cast<std::size_t>(epptr() - pptr());
+    if( size <= space )
+    {
+        traits_type::copy(pptr(), data, size);
+        pbump(static_cast<int>(size));
+        return count;
+    }
+
+    // Writes longer than the buffer skip it.
+    if( not flushBuffer() )
+    {
+        return 0;
+    }
+    if( size >= buffer_.size() )
+    {
+        return writeAll(data, size) ? count : 0;
+    }
+    traits_type::copy(pptr(), data, size);
+    pbump(static_cast<int>(size));
+    return count;
+}
+
+int BufferedSink::sync()
+{
+    return flushBuffer() ? 0 : -1;
+}
+
+bool BufferedSink::writeAll(const char* data, std::size_t count)
+{
+    while( count > 0 )
+    {
+        ssize_t written = ::write(fd_, data, count);
+        if( written < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        count -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+bool BufferedSink::flushBuffer()
+{
+    bool success = writeAll(pbase(), static_cast<std::size_t>(pptr() - pbase()));
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return success;
+}
@@ -0,0 +1,64 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: bufferedsink.hh                                                     #
+# Description: Output stream buffer that collects the output to a large     #
+#   buffer and writes it with one system call when the buffer fills.        #
+#############################################################################
+*/
+#ifndef BUFFEREDSINK_HH
+#define BUFFEREDSINK_HH
+
+#include <cstddef>
+#include <streambuf>
+#include <vector>
+
+/**
+ * @brief The BufferedSink class
+ * Stream buffer writing to a file descriptor. Nothing is written before the
+ * buffer is full, the stream is flushed, or the sink is destroyed. Note that
+ * std::endl flushes, so lines written through the sink should end in '\n'.
+ */
+class BufferedSink : public std::streambuf
+{
+public:
+    /**
+     * @brief BufferedSink
+     * @param fd file descriptor to write to, not closed by the sink
+     * @param capacity size of the buffer in bytes
+     */
+    explicit BufferedSink(int fd, std::size_t capacity = DEFAULT_CAPACITY);
+    ~BufferedSink() override;
+
+    BufferedSink(const BufferedSink&) = delete;
+    BufferedSink& operator=(const BufferedSink&) = delete;
+
+    // Default size of the buffer.
+    static const std::size_t DEFAULT_CAPACITY = 1 << 20;
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* data, std::streamsize count) override;
+    int sync() override;
+
+private:
+    /**
+     * @brief writeAll
+     * @param data
+     * @param count
+     * @return true if all count bytes were written to the file descriptor
+     */
+    bool writeAll(const char* data, std::size_t count);
+
+    /**
+     * @brief flushBuffer
+     * @return true if the buffered bytes were written
+     */
+    bool flushBuffer();
+
+    int fd_;
+    std::vector<char> buffer_;
+};
+
+#endif // BUFFEREDSINK_HH
@@ -0,0 +1,231 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: chunkedcolumn.hh                                                    #
+# Description: Column of a Familytree changed in place, stored in chunks    #
+#   shared with its copies until one of them changes a chunk.               #
+#############################################################################
+*/
+#ifndef CHUNKEDCOLUMN_HH
+#define CHUNKEDCOLUMN_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief The ChunkedColumn class
+ * Array of T in chunks of CHUNK_SIZE elements. Copies share the chunks,
+ * and a chunk is copied when a column sharing it changes one of its
+ * elements, so a version of a tree that changes a few persons copies a
+ * few chunks instead of the whole column. The chunks may also view
+ * external elements, e.g. a mapped snapshot file, which are copied the
+ * same way when changed.
+ */
+template <typename T>
+class ChunkedColumn
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "the elements are copied as they are");
+
+public:
+    using value_type = T;
+
+    static constexpr std::size_t CHUNK_BITS = 12;
+    static constexpr std::size_t CHUNK_SIZE = std::size_t(1) << CHUNK_BITS;
+
+    /**
+     * @brief The const_iterator class
+     * Goes through the elements in order.
+     */
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator(const ChunkedColumn* column, std::size_t i) :
+            column_(column), i_(i)
+        {
+        }
+
+        const T& operator*() const { return (*column_)[i_]; }
+        const T* operator->() const { return &(*column_)[i_]; }
+        const_iterator& operator++() { ++i_; return *this; }
+        bool operator==(const const_iterator& other) const { return i_ == other.i_; }
+        bool operator!=(const const_iterator& other) const { return i_ != other.i_; }
+
+    private:
+        const ChunkedColumn* column_;
+        std::size_t i_;
+    };
+
+    ChunkedColumn() = default;
+
+    /**
+     * @brief ChunkedColumn
+     * @param count
+     * @param value
+     * Column of count copies of value.
+     */
+    ChunkedColumn(std::size_t count, const T& value) { assign(count, value); }
+
+    /**
+     * @brief view
+     * @param data
+     * @param size
+     * Replace the contents with a view to size elements at data. The
+     * elements must outlive the column or its copies.
+     */
+    void view(const T* data, std::size_t size)
+    {
+        clear();
+        for( std::size_t first = 0; first < size; first += CHUNK_SIZE )
+        {
+            chunks_.push_back(data + first);
+            owners_.emplace_back();
+        }
+        size_ = size;
+    }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+    const T& back() const { return (*this)[size_ - 1]; }
+    const T& operator[](std::size_t i) const
+    {
+        return chunks_[i >> CHUNK_BITS][i & (CHUNK_SIZE - 1)];
+    }
+
+    /**
+     * @brief forEachChunk
+     * @param func called with the elements of every chunk in order, and
+     * their number
+     */
+    template <typename Func>
+    void forEachChunk(Func func) const
+    {
+        for( std::size_t chunk = 0; chunk < chunks_.size(); ++chunk )
+        {
+            func(chunks_[chunk], std::min(CHUNK_SIZE, size_ - chunk * CHUNK_SIZE));
+        }
+    }
+
+    /**
+     * @brief set
+     * @param i
+     * @param value
+     * Change the i:th element, copying its chunk first if it is shared.
+     * After detach, many threads may set different elements at once.
+     */
+    void set(std::size_t i, const T& value)
+    {
+        writable(i >> CHUNK_BITS)[i & (CHUNK_SIZE - 1)] = value;
+    }
+
+    void push_back(const T& value)
+    {
+        if( size_ % CHUNK_SIZE == 0 )
+        {
+            addChunk();
+        }
+        writable(size_ >> CHUNK_BITS)[size_ & (CHUNK_SIZE - 1)] = value;
+        ++size_;
+    }
+
+    void assign(std::size_t count, const T& value)
+    {
+        clear();
+        while( size_ < count )
+        {
+            addChunk();
+            std::size_t filled = std::min(CHUNK_SIZE, count - size_);
+            std::fill_n(owners_.back().get(), filled, value);
+            size_ += filled;
+        }
+    }
+
+    void assign(const std::vector<T>& values)
+    {
+        clear();
+        while( size_ < values.size() )
+        {
+            addChunk();
+            std::size_t filled = std::min(CHUNK_SIZE, values.size() - size_);
+            std::copy_n(values.begin() + size_, filled, owners_.back().get());
+            size_ += filled;
+        }
+    }
+
+    void reserve(std::size_t count)
+    {
+        chunks_.reserve((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        owners_.reserve((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    }
+
+    void clear()
+    {
+        chunks_.clear();
+        owners_.clear();
+        size_ = 0;
+    }
+
+    /**
+     * @brief detach
+     * Copy every chunk that is shared or viewed, so that set changes the
+     * elements in place.
+     */
+    void detach()
+    {
+        for( std::size_t chunk = 0; chunk < chunks_.size(); ++chunk )
+        {
+            writable(chunk);
+        }
+    }
+
+private:
+    /**
+     * @brief addChunk
+     * Add an empty chunk of its own to the end.
+     */
+    void addChunk()
+    {
+        owners_.emplace_back(new T[CHUNK_SIZE]);
+        chunks_.push_back(owners_.back().get());
+    }
+
+    /**
+     * @brief writable
+     * @param chunk
+     * @return the elements of the chunk, copied first unless only this
+     * column owns them
+     */
+    T* writable(std::size_t chunk)
+    {
+        if( owners_[chunk] == nullptr or owners_[chunk].use_count() > 1 )
+        {
+            std::shared_ptr<T[]> copy(new T[CHUNK_SIZE]);
+            std::size_t first = chunk * CHUNK_SIZE;
+            std::copy_n(chunks_[chunk], size_ > first ? std::min(CHUNK_SIZE, size_ - first) : 0,
+                        copy.get());
+            chunks_[chunk] = copy.get();
+            owners_[chunk] = std::move(copy);
+        }
+        return owners_[chunk].get();
+    }
+
+    // Elements of every chunk, and their owners. A viewed chunk has none.
+    std::vector<const T*> chunks_;
+    std::vector<std::shared_ptr<T[]>> owners_;
+    std::size_t size_ = 0;
+};
+
+#endif // CHUNKEDCOLUMN_HH
@@ -10,77 +10,427 @@
 #############################################################################
 */
 #include "cli.hh"
+#include "snapshot.hh"
+#include "stringsink.hh"
 #include "utils.hh"
 
+#include <chrono>
+#include <climits>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
 
-Cli::Cli(std::shared_ptr<Familytree> db) : database_(db)
+namespace
 {
+
+// Biggest numeric parameter of a cached query.
+const int MAX_CACHED_NUMBER = 9999;
+
+/**
+ * @brief syncFile
+ * @param path
+ * @return true once the contents of the file are on the disk
+ */
+bool syncFile(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if( fd < 0 )
+    {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+
+/**
+ * @brief cacheRadius
+ * @param command
+ * @param params of the command, the numeric ones checked
+ * @return the radius of the result of the command, or UINT_MAX if it
+ * isn't cached
+ */
+unsigned int cacheRadius(const CommandInfo& command, Params params)
+{
+    const auto& radius = command.cacheRadius_;
+    if( radius.empty() )
+    {
+        return UINT_MAX;
+    }
+    unsigned int total = radius.front();
+    for( std::size_t i = 1; i < radius.size(); ++i )
+    {
+        // A number this big is too far to cache anyway.
+        if( params.number(i) > MAX_CACHED_NUMBER )
+        {
+            return UINT_MAX;
+        }
+        total += radius[i] * params.number(i);
+    }
+    return total;
+}
+
+} // namespace
+
+Cli::Cli(std::shared_ptr<Familytree> db, std::istream& input,
+         std::ostream& output, bool prompt) :
+    database_(std::make_shared<TreeVersions>(db)),
+    cache_(std::make_unique<ResultCache>(RESULT_CACHE_ENTRIES)), input_(input),
+    output_(output), prompt_(prompt)
+{
+    std::vector<std::string> names;
+    for( const CommandInfo& command : COMMANDS )
+    {
+        names.push_back(std::string(command.allNames_.front()));
+    }
+    stats_ = std::make_unique<QueryStats>(names);
 }
 
 bool Cli::exec_prompt()
 {
     // Query for the command
     std::string line;
-    std::cout << PROMPT;
-    std::getline(std::cin, line);
+    if( prompt_ )
+    {
+        output_ << PROMPT << std::flush;
+    }
+    if( not std::getline(input_, line) )
+    {
+        return false;
+    }
+    return execute(line, output_);
+}
 
-    // Parsing command to the actual command and its parameters
-    std::vector<std::string> input = Utils::split(line, ' ');
-    if ( input.empty() or Utils::isEmpty(input.at(0)) )
+Cli::~Cli()
+{
+    if( not stats_path_.empty() )
     {
-        return true;
+        std::ofstream file(stats_path_);
+        stats_->printJson(file);
+    }
+}
+
+void Cli::setStatsFile(const std::string& path)
+{
+    stats_path_ = path;
+}
+
+bool Cli::execute(const std::string& line, std::ostream& output, bool remote) const
+{
+#ifndef FAMILY_NO_STATS
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    QueryStats::visited() = 0;
+    QueryStats::results() = 0;
+    const CommandInfo* command = nullptr;
+    bool go_on = run(line, output, remote, command);
+    if( command != nullptr and (command->funcPtr_ != nullptr or command->mutatorPtr_ != nullptr) )
+    {
+        std::uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now() - start).count();
+        stats_->record(command - COMMANDS.data(), nanoseconds, QueryStats::results(),
+                       QueryStats::visited());
     }
-    std::string command_str = input.front();
-    input.erase(input.begin());
+    return go_on;
+#else
+    const CommandInfo* command = nullptr;
+    return run(line, output, remote, command);
+#endif
+}
 
+bool Cli::run(const std::string& line, std::ostream& output, bool remote,
+              const CommandInfo*& command) const
+{
+    // Parsing command to the actual command and its parameters. The
+    // parameters view the line, or the unquoted copies in tokens.
+    thread_local Utils::Tokens tokens;
+    thread_local Arguments input;
+    Utils::tokenize(line, ' ', tokens);
+    if ( tokens.empty() or Utils::isEmpty(tokens[0]) )
+    {
+        return true;
+    }
+    input.assign(tokens.begin() + 1, tokens.end());
 
-    CommandInfo* command = findCommand(command_str);
+    command = findCommand(tokens[0]);
 
     // Checking special commands
     if( command == nullptr )
     {
-        std::cout << UNKNOWN_COMMAND << std::endl;
+        output << UNKNOWN_COMMAND << '\n';
         return true;
     }
-    if( command->id_ == "Q" )
+    if( command->kind_ == CommandKind::QUIT )
     {
         return false;
     }
+    if( command->kind_ == CommandKind::LOCAL and remote )
+    {
+        output << NOT_SERVED << '\n';
+        return true;
+    }
     if( command->params_.size() != input.size() )
     {
-        std::cout << WRONG_PARAMETERS << std::endl;
+        output << WRONG_PARAMETERS << '\n';
+        return true;
+    }
+    for( std::size_t i = 0; i < input.size(); ++i )
+    {
+        if( command->params_[i].type_ == ParamType::NUMBER and not input.isNumber(i) )
+        {
+            output << NOT_NUMERIC << '\n';
+            return true;
+        }
+    }
+
+    // Calling command method through the function pointer, changes to a
+    // new version of the tree
+    if( command->mutatorPtr_ != nullptr )
+    {
+        // Nothing gets to the log after it has failed, so no change is made.
+        if( log_ != nullptr and log_->failed() )
+        {
+            output << LOG_FAILED << '\n';
+            return true;
+        }
+
+        // The change is logged in the order it is made, but the sync is
+        // waited for only after the next writer may go on, so that
+        // concurrent changes share a sync. The new version is published,
+        // and the result printed, only once the change is on the disk.
+        std::uint64_t sequence = 0;
+        std::ostringstream result;
+        std::vector<PersonIndex> changed_persons;
+        std::uint64_t prepared = database_->prepare([&](Familytree& tree)
+        {
+            tree.clearChanges();
+            bool changed = (tree.*(command->mutatorPtr_))(input, result);
+            if( changed and log_ != nullptr )
+            {
+                std::vector<std::string> fields = {std::string(command->allNames_.front())};
+                fields.insert(fields.end(), input.begin(), input.end());
+                sequence = log_->append(fields);
+            }
+            changed_persons = tree.changes();
+            return changed;
+        });
+
+        if( sequence != 0 and not log_->commit(sequence) )
+        {
+            database_->discard(prepared);
+            output << LOG_FAILED << '\n';
+            return true;
+        }
+        if( prepared != 0 )
+        {
+            database_->publish(prepared);
+        }
+
+        // Only once the change is visible, so that no result of the tree
+        // before it gets cached after this.
+        if( not changed_persons.empty() )
+        {
+            cache_->invalidate(database_->read().tree(), changed_persons);
+        }
+        output << result.str();
+        return true;
+    }
+    if( command->kind_ == CommandKind::STATS )
+    {
+#ifndef FAMILY_NO_STATS
+        stats_->print(output);
+#else
+        output << STATS_DISABLED << '\n';
+#endif
         return true;
     }
-    if( command->id_ == "N" and not Utils::isNumeric(input.at(1)))
+    if( command->kind_ == CommandKind::CACHE )
     {
-        std::cout << NOT_NUMERIC << std::endl;
+        ResultCache::Stats stats = cacheStats();
+        output << "Cache: " << stats.entries_ << " results, " << stats.hits_ << " hits, "
+               << stats.misses_ << " misses, " << stats.invalidated_ << " invalidated." << '\n';
         return true;
     }
 
-    // Calling command method through the function pointer
-    (database_.get()->*(command->funcPtr_))(input, std::cout);
-    return true;
-}
+    // A cached result is written out as it is. Otherwise the result is
+    // printed to a string first, to be cached if the person exists.
+    unsigned int radius = cacheRadius(*command, input);
+    std::string key;
+    if( radius <= ResultCache::MAX_RADIUS )
+    {
+        key = command->allNames_.front();
+        for( std::string_view param : input )
+        {
+            key += ' ';
+            key += param;
+        }
+        std::shared_ptr<const std::string> cached = cache_->find(key);
+        if( cached != nullptr )
+        {
+            output.write(cached->data(), cached->size());
+            return true;
+        }
+    }
+    std::uint64_t generation = cache_->generation();
+    TreeVersions::ReadGuard guard = database_->read();
+    if( key.empty() )
+    {
+        (guard.tree().*(command->funcPtr_))(input, output);
+        return true;
+    }
 
-CommandInfo *Cli::findCommand(std::string& command_name)
-{
-    for( unsigned int i = 0; i < command_name.size(); i++ )
+    thread_local StringSink sink;
+    thread_local std::ostream captured(&sink);
+    std::string result;
+    sink.setTarget(&result);
+    (guard.tree().*(command->funcPtr_))(input, captured);
+    output.write(result.data(), result.size());
+    PersonIndex subject = guard.tree().getIndex(input.front());
+    if( subject != NO_PERSON )
     {
-        command_name.at(i) = std::toupper(command_name.at(i));
+        cache_->insert(key, std::move(result), subject, radius, generation);
     }
+    return true;
+}
 
-    for( auto iter = commands_.begin(); iter != commands_.end(); ++iter )
+bool Cli::openLog(const std::string& path)
+{
+    // All the logged changes are made to one copy of the tree. The persons
+    // are added as they come. The ids of the relations are looked up a
+    // batch at a time, and the parents set all at once at the end, like the
+    // loader sets those of the datafile, with the lineages computed once.
+    // The logged changes were checked when they were made, so no relation
+    // needs a person added after it. Any other change is made through its
+    // command, after the changes before it.
+    std::unique_ptr<MutationLog> log = std::make_unique<MutationLog>();
+    std::vector<IndexedRelation> relations;
+    std::vector<std::string_view> ids;
+    std::vector<PersonIndex> indexes;
+    Arguments params;
+    std::ostream discard(nullptr);
+    bool opened = false;
+    database_->update([&](Familytree& tree)
     {
-        for( auto& alias : iter->allNames_ )
+        auto setParents = [&]()
         {
-            if( alias == command_name )
+            tree.getIndexes(ids, indexes);
+            for( std::size_t i = 0; i < ids.size(); i += 3 )
             {
-                return &(*iter);
+                IndexedRelation relation;
+                relation.child_ = indexes[i];
+                bool found = relation.child_ != NO_PERSON;
+                for( int slot = 0; slot < 2; ++slot )
+                {
+                    if( ids[i + 1 + slot] != "-" )
+                    {
+                        relation.parents_[slot] = indexes[i + 1 + slot];
+                        found = found and relation.parents_[slot] != NO_PERSON
+                                and relation.parents_[slot] != relation.child_;
+                    }
+                }
+                if( found )
+                {
+                    relations.push_back(relation);
+                }
             }
+            ids.clear();
+        };
+        opened = log->open(path, [&](const MutationLog::Records& records)
+        {
+            for( const std::vector<std::string_view>& fields : records )
+            {
+                const CommandInfo* command = findCommand(fields.empty() ? "" : fields.front());
+                if( command == nullptr or command->mutatorPtr_ == nullptr
+                    or command->params_.size() + 1 != fields.size() )
+                {
+                    continue;
+                }
+                int height = 0;
+                if( command->mutatorPtr_ == &Familytree::addPerson )
+                {
+                    // Like ADD, also for a log written before ADD checked the id.
+                    if( not fields[1].empty() and fields[1] != "-"
+                        and Utils::parseNumber(fields[2], height) )
+                    {
+                        tree.addNewPerson(fields[1], height, discard);
+                    }
+                }
+                else if( command->mutatorPtr_ == &Familytree::addParents )
+                {
+                    ids.insert(ids.end(), fields.begin() + 1, fields.end());
+                }
+                else
+                {
+                    setParents();
+                    if( not relations.empty() )
+                    {
+                        tree.addRelations(relations, std::thread::hardware_concurrency());
+                        relations.clear();
+                    }
+                    tree.deferExtremes();
+                    params.assign(fields.begin() + 1, fields.end());
+                    (tree.*(command->mutatorPtr_))(params, discard);
+                }
+            }
+            // The ids view the batch.
+            setParents();
+        });
+        if( not relations.empty() )
+        {
+            tree.addRelations(relations, std::thread::hardware_concurrency());
         }
+        tree.clearChanges();
+        return opened and log->records() > 0;
+    });
+    if( opened )
+    {
+        log_ = std::move(log);
     }
-    return nullptr;
+    return opened;
+}
+
+bool Cli::compactLog(const std::string& datafile, bool snapshot)
+{
+    if( log_ == nullptr )
+    {
+        return false;
+    }
+    TreeVersions::ReadGuard guard = database_->read();
+    bool saved = snapshot ? Snapshot::save(guard.tree(), datafile)
+                          : guard.tree().saveDatafile(datafile);
+
+    // The log may go only once the datafile is safe on the disk. If the
+    // program stops before that, replaying the log again on top of the new
+    // datafile changes nothing.
+    return saved and syncFile(datafile) and log_->reset();
 }
 
+ResultCache::Stats Cli::cacheStats() const
+{
+    return cache_->stats();
+}
+
+const CommandInfo* Cli::commandOf(const std::string& line) const
+{
+    Utils::Tokens tokens;
+    Utils::tokenize(line, ' ', tokens);
+    if ( tokens.empty() or Utils::isEmpty(tokens[0]) )
+    {
+        return nullptr;
+    }
+    return findCommand(tokens[0]);
+}
+
+const std::array<CommandInfo, COMMAND_COUNT>& Cli::commands() const
+{
+    return COMMANDS;
+}
+
+const CommandInfo* Cli::findCommand(std::string_view command_name) const
+{
+    std::size_t index = COMMAND_NAMES.find(command_name);
+    return index == COMMAND_NAMES.NOT_FOUND ? nullptr : &COMMANDS[index];
+}
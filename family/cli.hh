@@ -17,29 +17,80 @@
 #ifndef CLI_HH
 #define CLI_HH
 
+#include "commandtable.hh"
 #include "familytree.hh"
+#include "mutationlog.hh"
+#include "querystats.hh"
+#include "resultcache.hh"
+#include "treeversions.hh"
 
+#include <array>
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
 // Declare a type of function called
-using MemberFunc = void (Familytree::*)(const std::vector<std::string>& params,
+using MemberFunc = void (Familytree::*)(Params params,
                                         std::ostream&) const;
 
+// Type of function changing the tree, returning true if it did
+using MutatorFunc = bool (Familytree::*)(Params params,
+                                         std::ostream&);
+
+// What the Cli does with a command, apart from calling its function. LOCAL
+// commands are called like CALL ones, but not for the clients of the daemon,
+// as they use the files of the machine.
+enum class CommandKind { CALL, LOCAL, QUIT, CACHE, STATS };
+
+// Type of a parameter, checked before the command is called
+enum class ParamType { TEXT, NUMBER };
+
+// Parameter of a command
+struct Param
+{
+    constexpr Param(const char* name = "", ParamType type = ParamType::TEXT) :
+        name_(name), type_(type)
+    {
+    }
+
+    std::string_view name_;
+    ParamType type_;
+};
+
+// Most names, parameters and cache radius terms of a command
+const std::size_t MAX_COMMAND_NAMES = 5;
+const std::size_t MAX_COMMAND_PARAMS = 3;
+
 // Struct describing a command
 struct CommandInfo
 {
-    std::string id_; // needed only for quit and commands with numeric params
-    std::vector<std::string> allNames_;
-    std::vector<std::string> params_;
+    CommandKind kind_;
+    FixedList<std::string_view, MAX_COMMAND_NAMES> allNames_;
+    FixedList<Param, MAX_COMMAND_PARAMS> params_;
     MemberFunc funcPtr_;
+    MutatorFunc mutatorPtr_ = nullptr; // for commands changing the tree
+    // For cached queries about the first param: the radius of the result,
+    // a base and a multiplier for every numeric param, see ResultCache
+    FixedList<unsigned int, MAX_COMMAND_PARAMS + 1> cacheRadius_ = {};
+    // Goes through the whole tree, so the daemon runs it off its event loop
+    bool long_ = false;
 };
 
+// Commands the Cli recognizes, see Cli::COMMANDS
+const std::size_t COMMAND_COUNT = 26;
+
 // Error messages
 const std::string WRONG_PARAMETERS = "Wrong amount of parameters.";
 const std::string NOT_NUMERIC = "Wrong type of parameters.";
 const std::string UNKNOWN_COMMAND = "Unknown command.";
+const std::string LOG_FAILED = "Error. Could not write the change to the log.";
+const std::string STATS_DISABLED = "Error. Statistics are not compiled in.";
+const std::string NOT_SERVED = "Error. The command can only be used locally.";
+
+// Most results kept in the cache.
+const std::size_t RESULT_CACHE_ENTRIES = 4096;
 
 
 class Cli
@@ -47,45 +98,168 @@ class Cli
 public:    
     /**
      * @brief Cli
-     * @param db (database) pointer to the Familytree
+     * @param db (database) pointer to the Familytree, changed only through
+     * the Cli from now on
+     * @param input stream the commands are read from
+     * @param output stream the results are printed to
+     * @param prompt false in batch mode, where no prompt is printed
      */
-    Cli(std::shared_ptr<Familytree> db);
+    Cli(std::shared_ptr<Familytree> db, std::istream& input = std::cin,
+        std::ostream& output = std::cout, bool prompt = true);
+
+    /**
+     * @brief ~Cli
+     * Print the statistics to the file given to setStatsFile, if any.
+     */
+    ~Cli();
 
     /**
      * @brief exec_prompt runs the interface
-     * @return true for normal commands, false for exit command
+     * @return true for normal commands, false for exit command or the end
+     * of the input
      */
     bool exec_prompt();
 
+    /**
+     * @brief execute runs one command line
+     * @param line
+     * @param output stream the result is printed to
+     * @param remote true for a line from a client of the daemon, which
+     * can't run the LOCAL commands
+     * @return false for exit command, true otherwise
+     * Doesn't change the Cli, so many threads can execute lines at once.
+     */
+    bool execute(const std::string& line, std::ostream& output,
+                 bool remote = false) const;
+
+    /**
+     * @brief setStatsFile
+     * @param path file the statistics of the commands are printed to as
+     * JSON when the Cli is destroyed, empty for none
+     */
+    void setStatsFile(const std::string& path);
+
+    /**
+     * @brief openLog
+     * @param path
+     * @return true if the log could be opened
+     * Replay the changes in the log as one new version of the tree, and
+     * append every later change to the log before reporting it done.
+     */
+    bool openLog(const std::string& path);
+
+    /**
+     * @brief compactLog
+     * @param datafile replaced with the current version of the tree
+     * @param snapshot true to write a snapshot, false for a CSV datafile
+     * @return true if the datafile was written and the log emptied
+     * Fold the logged changes into a new datafile. No command may be
+     * executed at the same time.
+     */
+    bool compactLog(const std::string& datafile, bool snapshot);
+
+    /**
+     * @brief cacheStats
+     * @return the counters of the result cache, also printed by CACHE
+     */
+    ResultCache::Stats cacheStats() const;
+
+    /**
+     * @brief commandOf
+     * @param line
+     * @return the command of the line, or nullptr if there is none
+     */
+    const CommandInfo* commandOf(const std::string& line) const;
+
+    /**
+     * @brief findCommand
+     * @param command_name in any case
+     * @return pointer to the command found from COMMANDS; if not found,
+     * returns a nullptr
+     */
+    const CommandInfo* findCommand(std::string_view command_name) const;
+
+    /**
+     * @brief commands
+     * @return the commands the CLI recognizes
+     */
+    const std::array<CommandInfo, COMMAND_COUNT>& commands() const;
+
 private:
-    // Pointer to the Familytree object the functions are called to
-    std::shared_ptr<Familytree> database_;
+    // Versions of the Familytree the functions are called to. Commands
+    // read the current version, changes make a new one.
+    std::shared_ptr<TreeVersions> database_;
+
+    // Log of the changes, if any
+    std::unique_ptr<MutationLog> log_;
+
+    // Results of the latest queries
+    std::unique_ptr<ResultCache> cache_;
+
+    // Statistics of the commands, and the file they are printed to at the end
+    std::unique_ptr<QueryStats> stats_;
+    std::string stats_path_;
+
+    // Streams for the commands and the results
+    std::istream& input_;
+    std::ostream& output_;
+
+    // Is the prompt printed before every command
+    bool prompt_;
 
     // Prompt printed for every query
     const std::string PROMPT = "> ";
 
-    // Vector containing those commands the CLI can recognize
-    std::vector<CommandInfo> commands_ = {
-        {"Q",{"QUIT","EXIT","Q","LOPETA"}, {}, nullptr},
-        {"",{"PRINT","TREE","FAMILYTREE","SUKUPUU","PUU"}, {}, &Familytree::printPersons},
-        {"",{"CHILDREN","LAPSET"}, {"person"}, &Familytree::printChildren},
-        {"",{"COUSINS","SERKUT"}, {"person"}, &Familytree::printCousins},
-        {"",{"SIBLINGS","SISARUKSET"},{"person"},&Familytree::printSiblings},
-        {"",{"PARENTS","VANHEMMAT"},{"person"},&Familytree::printParents},
-        {"",{"TALLEST","PISIN"}, {"person"},&Familytree::printTallestInLineage},
-        {"",{"SHORTEST","LYHYIN","LYHIN"}, {"person"}, &Familytree::printShortestInLineage},
-        {"N",{"GRANDCHILDREN","LAPSENLAPSET","GC","LL"}, {"person", "N"},&Familytree::printGrandChildrenN},
-        {"N",{"GRANDPARENTS","ISOVANHEMMAT","GP","IV"}, {"person", "N"},&Familytree::printGrandParentsN},
-        {"",{},{},nullptr}
-    };
+    // Shorthands for the table
+    static constexpr CommandKind CALL = CommandKind::CALL;
+    static constexpr ParamType NUMBER = ParamType::NUMBER;
+
+    // Those commands the CLI can recognize. The numeric parameters are
+    // checked before a command is called.
+    static constexpr std::array<CommandInfo, COMMAND_COUNT> COMMANDS = {{
+        {CommandKind::QUIT,{"QUIT","EXIT","Q","LOPETA"}, {}, nullptr},
+        {CALL,{"PRINT","TREE","FAMILYTREE","SUKUPUU","PUU"}, {}, &Familytree::printPersons, nullptr, {}, true},
+        {CALL,{"CHILDREN","LAPSET"}, {"person"}, &Familytree::printChildren, nullptr, {1}},
+        {CALL,{"COUSINS","SERKUT"}, {"person"}, &Familytree::printCousins, nullptr, {4}},
+        {CALL,{"COUSINS-N","SERKUT-N"}, {"person", {"N", NUMBER}, {"K", NUMBER}}, &Familytree::printCousinsN, nullptr, {2, 2, 1}},
+        {CALL,{"SIBLINGS","SISARUKSET"},{"person"},&Familytree::printSiblings, nullptr, {2}},
+        {CALL,{"PARENTS","VANHEMMAT"},{"person"},&Familytree::printParents, nullptr, {1}},
+        {CALL,{"TALLEST","PISIN"}, {"person"},&Familytree::printTallestInLineage},
+        {CALL,{"SHORTEST","LYHYIN","LYHIN"}, {"person"}, &Familytree::printShortestInLineage},
+        {CALL,{"HEIGHT-RANGE","PITUUSVALI"}, {{"min", NUMBER}, {"max", NUMBER}}, &Familytree::printHeightRange},
+        {CALL,{"HEIGHT-COUNT","PITUUSMAARA"}, {{"min", NUMBER}, {"max", NUMBER}}, &Familytree::printHeightCount},
+        {CALL,{"HEIGHT-TOP","PISIMMAT"}, {{"K", NUMBER}}, &Familytree::printTallestK},
+        {CALL,{"LINEAGE-RANGE","SUVUN-PITUUSVALI"}, {"person", {"min", NUMBER}, {"max", NUMBER}}, &Familytree::printLineageHeightRange},
+        {CALL,{"LINEAGE-STATS","SUKUTILASTOT"}, {"person"}, &Familytree::printLineageStats},
+        {CALL,{"ANCESTRY-STATS","ESIVANHEMPITILASTOT"}, {"person"}, &Familytree::printAncestryStats},
+        {CALL,{"LINEAGE-STATS-ALL","SUKUTILASTOT-KAIKKI"}, {}, &Familytree::printLineageStatsOfRoots, nullptr, {}, true},
+        {CALL,{"ANCESTRY-STATS-ALL","ESIVANHEMPITILASTOT-KAIKKI"}, {}, &Familytree::printAncestryStatsOfLeaves, nullptr, {}, true},
+        {CALL,{"GRANDCHILDREN","LAPSENLAPSET","GC","LL"}, {"person", {"N", NUMBER}},&Familytree::printGrandChildrenN, nullptr, {1, 1}},
+        {CALL,{"GRANDPARENTS","ISOVANHEMMAT","GP","IV"}, {"person", {"N", NUMBER}},&Familytree::printGrandParentsN, nullptr, {1, 1}},
+        {CALL,{"RELATION","SUKULAISUUS"}, {"person", "relative"}, &Familytree::printRelation},
+        {CALL,{"IS-ANCESTOR","ESIVANHEMPI"}, {"ancestor", "person"}, &Familytree::printIsAncestor},
+        {CommandKind::LOCAL,{"SAVE","TALLENNA"}, {"file"}, &Familytree::saveSnapshot},
+        {CALL,{"ADD","LISAA"}, {"person", {"height", NUMBER}}, nullptr, &Familytree::addPerson},
+        {CALL,{"RELATE","SUHTEUTA"}, {"person", "father", "mother"}, nullptr, &Familytree::addParents},
+        {CommandKind::CACHE,{"CACHE","VALIMUISTI"}, {}, nullptr},
+        {CommandKind::STATS,{"STATS","TILASTOT"}, {}, nullptr}
+    }};
+
+    // Perfect hash from every name of every command to the command, so
+    // that a command is found with one probe
+    static constexpr NameTable<512, 96> COMMAND_NAMES{COMMANDS};
 
     /**
-     * @brief findCommand
-     * @param command_name
-     * @return pointer to the command found from the commands_ vector;
-     * if not found, returns a nullptr
+     * @brief run
+     * @param line
+     * @param output
+     * @param remote
+     * @param command set to the command of the line, if any
+     * @return false for exit command, true otherwise
+     * Run one command line, see execute.
      */
-    CommandInfo* findCommand(std::string& command_name);
+    bool run(const std::string& line, std::ostream& output, bool remote,
+             const CommandInfo*& command) const;
 };
 
 #endif // CLI_HH
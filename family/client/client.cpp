@@ -0,0 +1,57 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: client.cpp                                                          #
+# Description: Command line client of the query daemon. Reads commands like #
+#   the interactive program and prints the answers of the daemon.           #
+# Notes: * Usage: familyclient socket                                       #
+#############################################################################
+*/
+#include "queryclient.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+// Prompt printed for every query when the input is a terminal
+const std::string PROMPT = "> ";
+
+/**
+ * @brief main
+ * @return
+ * Connect to the daemon and send it the lines of the standard input until
+ * the exit command or the end of the input.
+ */
+int main(int argc, char* argv[])
+{
+    if( argc != 2 )
+    {
+        std::cerr << "Usage: " << argv[0] << " socket" << std::endl;
+        return EXIT_FAILURE;
+    }
+    QueryClient client;
+    if( not client.connect(argv[1]) )
+    {
+        std::cerr << "Could not connect to socket: " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    bool interactive = isatty(STDIN_FILENO);
+    std::string line;
+    std::string response;
+    while( true )
+    {
+        if( interactive )
+        {
+            std::cout << PROMPT << std::flush;
+        }
+        if( not std::getline(std::cin, line) or not client.query(line, response) )
+        {
+            break;
+        }
+        std::cout << response;
+    }
+    return EXIT_SUCCESS;
+}
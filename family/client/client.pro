@@ -0,0 +1,14 @@
+TEMPLATE = app
+TARGET = familyclient
+CONFIG += console c++17
+CONFIG -= app_bundle
+CONFIG -= qt
+
+INCLUDEPATH += ..
+
+SOURCES += client.cpp \
+    queryclient.cpp
+
+HEADERS += \
+    queryclient.hh \
+    ../protocol.hh
@@ -0,0 +1,95 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: queryclient.cpp                                                     #
+# Description: Connection to the query daemon.                              #
+# Notes: * Check the queryclient.hh for more info.                          #
+#############################################################################
+*/
+#include "queryclient.hh"
+#include "protocol.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+QueryClient::~QueryClient()
+{
+    if( fd_ >= 0 )
+    {
+        close(fd_);
+    }
+}
+
+bool QueryClient::connect(const std::string& path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if( fd_ >= 0 or path.empty() or path.size() >= sizeof(address.sun_path) )
+    {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if( fd_ < 0 )
+    {
+        return false;
+    }
+    if( ::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 )
+    {
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+bool QueryClient::query(const std::string& line, std::string& response)
+{
+    if( fd_ < 0 )
+    {
+        return false;
+    }
+    std::string request = line + '\n';
+    std::size_t written = 0;
+    while( written < request.size() )
+    {
+        ssize_t sent = send(fd_, request.data() + written, request.size() - written,
+                            MSG_NOSIGNAL);
+        if( sent < 0 and errno == EINTR )
+        {
+            continue;
+        }
+        if( sent < 0 )
+        {
+            return false;
+        }
+        written += static_cast<std::size_t>(sent);
+    }
+
+    std::size_t end = received_.find(END_OF_RESPONSE);
+    while( end == std::string::npos )
+    {
+        char buffer[1 << 14];
+        ssize_t count = recv(fd_, buffer, sizeof(buffer), 0);
+        if( count < 0 and errno == EINTR )
+        {
+            continue;
+        }
+        if( count <= 0 )
+        {
+            return false;
+        }
+        std::size_t searched = received_.size();
+        received_.append(buffer, static_cast<std::size_t>(count));
+        end = received_.find(END_OF_RESPONSE, searched);
+    }
+    response.assign(received_, 0, end);
+    received_.erase(0, end + 1);
+    return true;
+}
@@ -0,0 +1,51 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: queryclient.hh                                                      #
+# Description: Connection to the query daemon.                              #
+#############################################################################
+*/
+#ifndef QUERYCLIENT_HH
+#define QUERYCLIENT_HH
+
+#include <string>
+
+/**
+ * @brief The QueryClient class
+ * Blocking connection to the UNIX domain socket of the daemon, sending one
+ * command line at a time and waiting for its output.
+ */
+class QueryClient
+{
+public:
+    QueryClient() = default;
+    ~QueryClient();
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    /**
+     * @brief connect
+     * @param path of the socket
+     * @return true if the daemon accepted the connection
+     */
+    bool connect(const std::string& path);
+
+    /**
+     * @brief query
+     * @param line command line without the newline
+     * @param response set to the output of the command
+     * @return false if the daemon closed the connection, as it does after
+     * the exit command, or on an error
+     */
+    bool query(const std::string& line, std::string& response);
+
+private:
+    int fd_ = -1;
+
+    // Bytes received after the end of the last response.
+    std::string received_;
+};
+
+#endif // QUERYCLIENT_HH
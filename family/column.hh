@@ -0,0 +1,191 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: column.hh                                                           #
+# Description: Column of a Familytree. Owns its elements, shared with its   #
+#   copies, or views elements owned by someone else, e.g. a mapped          #
+#   snapshot file.                                                          #
+#############################################################################
+*/
+#ifndef COLUMN_HH
+#define COLUMN_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief The Column class
+ * Contiguous array of T that is only appended to or replaced as a whole,
+ * never changed in place. Copies share the elements, so copying a column
+ * costs nothing, and one copy may go on appending to the shared buffer as
+ * long as the elements after its end are unused. The versions of a tree
+ * thus add persons without copying the columns of the versions before.
+ * Otherwise, e.g. for a viewed column or a copy that isn't the last one to
+ * append, the elements are first copied to a new buffer of twice the size.
+ */
+template <typename T>
+class Column
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "the elements are copied as they are");
+
+public:
+    using value_type = T;
+
+    Column() = default;
+
+    /**
+     * @brief Column
+     * @param count
+     * @param value
+     * Column of count copies of value.
+     */
+    Column(std::size_t count, const T& value) { assign(count, value); }
+
+    /**
+     * @brief view
+     * @param data
+     * @param size
+     * Replace the contents with a view to size elements at data. The
+     * elements must outlive the column or its copies.
+     */
+    void view(const T* data, std::size_t size)
+    {
+        buffer_.reset();
+        data_ = data;
+        size_ = size;
+    }
+
+    const T* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+    const T& back() const { return data_[size_ - 1]; }
+    const T& operator[](std::size_t i) const { return data_[i]; }
+
+    void push_back(T value) { *grow(1) = value; }
+
+    /**
+     * @brief append
+     * @param values
+     * @param count
+     * Append count values, which may be elements of the column itself.
+     */
+    void append(const T* values, std::size_t count)
+    {
+        // The buffer the values may be in is kept until they are copied.
+        std::shared_ptr<Buffer> source = buffer_;
+        T* place = grow(count);
+        std::copy(values, values + count, place);
+    }
+
+    /**
+     * @brief append
+     * @param values
+     * Append the values, for columns of characters.
+     */
+    void append(std::basic_string_view<T> values)
+    {
+        append(values.data(), values.size());
+    }
+
+    void assign(std::size_t count, const T& value)
+    {
+        clear();
+        std::fill_n(grow(count), count, value);
+    }
+
+    void assign(const std::vector<T>& values)
+    {
+        clear();
+        std::copy(values.begin(), values.end(), grow(values.size()));
+    }
+
+    void clear()
+    {
+        buffer_.reset();
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    void reserve(std::size_t count)
+    {
+        if( buffer_ == nullptr or buffer_->capacity_ < count )
+        {
+            reallocate(count);
+        }
+    }
+
+    void shrink_to_fit()
+    {
+        if( buffer_ != nullptr and buffer_->capacity_ > size_ )
+        {
+            reallocate(size_);
+        }
+    }
+
+private:
+    // Elements shared by the copies of a column. Those before used_ belong
+    // to some copy, the rest are free for the copy ending at used_.
+    struct Buffer
+    {
+        explicit Buffer(std::size_t capacity) :
+            values_(new T[capacity]), capacity_(capacity)
+        {
+        }
+
+        std::unique_ptr<T[]> values_;
+        std::size_t capacity_;
+        std::atomic<std::size_t> used_{0};
+    };
+
+    // Smallest buffer allocated when growing.
+    static constexpr std::size_t MIN_CAPACITY = 16;
+
+    /**
+     * @brief grow
+     * @param count
+     * @return the place of count new elements at the end, left for the
+     * caller to fill
+     */
+    T* grow(std::size_t count)
+    {
+        std::size_t size = size_;
+        if( buffer_ == nullptr or buffer_->capacity_ - size < count
+            or not buffer_->used_.compare_exchange_strong(size, size_ + count) )
+        {
+            reallocate(std::max({size_ + count, 2 * size_, MIN_CAPACITY}));
+            buffer_->used_.store(size_ + count);
+        }
+        T* place = buffer_->values_.get() + size_;
+        size_ += count;
+        return place;
+    }
+
+    /**
+     * @brief reallocate
+     * @param capacity at least size()
+     * Copy the elements to a new buffer of its own.
+     */
+    void reallocate(std::size_t capacity)
+    {
+        std::shared_ptr<Buffer> buffer = std::make_shared<Buffer>(capacity);
+        std::copy(data_, data_ + size_, buffer->values_.get());
+        buffer->used_.store(size_);
+        buffer_ = std::move(buffer);
+        data_ = buffer_->values_.get();
+    }
+
+    std::shared_ptr<Buffer> buffer_;
+    const T* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif // COLUMN_HH
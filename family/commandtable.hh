@@ -0,0 +1,247 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: commandtable.hh                                                     #
+# Description: Lists of fixed capacity and a perfect hash of names, for     #
+#   tables of commands built at compile time.                               #
+#############################################################################
+*/
+#ifndef COMMANDTABLE_HH
+#define COMMANDTABLE_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string_view>
+
+/**
+ * @brief The FixedList class
+ * At most CAPACITY items stored in place, so that a list can be a part of a
+ * table that is built at compile time.
+ */
+template <typename T, std::size_t CAPACITY>
+class FixedList
+{
+public:
+    constexpr FixedList() :
+        items_(), size_(0)
+    {
+    }
+
+    constexpr FixedList(std::initializer_list<T> items) :
+        items_(), size_(0)
+    {
+        if( items.size() > CAPACITY )
+        {
+            throw std::length_error("Too many items for a FixedList.");
+        }
+        for( const T& item : items )
+        {
+            items_[size_++] = item;
+        }
+    }
+
+    constexpr std::size_t size() const
+    {
+        return size_;
+    }
+
+    constexpr bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    constexpr const T& operator[](std::size_t index) const
+    {
+        return items_[index];
+    }
+
+    constexpr const T& front() const
+    {
+        return items_[0];
+    }
+
+    constexpr const T* begin() const
+    {
+        return items_.data();
+    }
+
+    constexpr const T* end() const
+    {
+        return items_.data() + size_;
+    }
+
+private:
+    std::array<T, CAPACITY> items_;
+    std::size_t size_;
+};
+
+/**
+ * @brief The NameTable class
+ * Perfect hash of the names of the commands in a table, found at compile
+ * time by trying seeds until every name has a slot of its own. A name is
+ * then found with one hash, one probe and one comparison. The names are in
+ * upper case, and they are looked up in any case. Every name is hashed
+ * once, and a seed only remixes the hashes, so that trying many seeds
+ * stays cheap for the compiler.
+ */
+template <std::size_t SLOTS, std::size_t MAX_NAMES>
+class NameTable
+{
+public:
+    // Returned by find for an unknown name
+    static constexpr std::size_t NOT_FOUND = SIZE_MAX;
+
+    /**
+     * @brief NameTable
+     * @param commands each with a non-empty list of upper case allNames_,
+     * no name shared by two commands
+     */
+    template <typename Command, std::size_t COUNT>
+    constexpr explicit NameTable(const std::array<Command, COUNT>& commands) :
+        names_(), hashes_(), commands_(), slots_(), count_(0), seed_(0), longest_(0)
+    {
+        static_assert((SLOTS & (SLOTS - 1)) == 0, "The slots must be a power of two.");
+        static_assert(COUNT <= UINT8_MAX and MAX_NAMES < UINT8_MAX,
+                      "Too many commands or names for a NameTable.");
+        for( std::size_t i = 0; i < COUNT; ++i )
+        {
+            if( commands[i].allNames_.empty() )
+            {
+                throw std::logic_error("A command without a name.");
+            }
+            for( std::string_view name : commands[i].allNames_ )
+            {
+                if( count_ == MAX_NAMES )
+                {
+                    throw std::length_error("Too many names for the NameTable.");
+                }
+                names_[count_] = name;
+                hashes_[count_] = hash(name);
+                commands_[count_] = static_cast<std::uint8_t>(i);
+                longest_ = name.size() > longest_ ? name.size() : longest_;
+                ++count_;
+            }
+        }
+        while( not fill() )
+        {
+            if( ++seed_ == MAX_SEED )
+            {
+                throw std::logic_error("No perfect hash for the names; add slots.");
+            }
+        }
+    }
+
+    /**
+     * @brief find
+     * @param name in any case
+     * @return index of the command with the name, or NOT_FOUND
+     */
+    constexpr std::size_t find(std::string_view name) const
+    {
+        if( name.empty() or name.size() > longest_ )
+        {
+            return NOT_FOUND;
+        }
+        std::uint8_t slot = slots_[slotOf(hash(name), seed_)];
+        if( slot == 0 or names_[slot - 1].size() != name.size() )
+        {
+            return NOT_FOUND;
+        }
+        std::string_view found = names_[slot - 1];
+        for( std::size_t i = 0; i < name.size(); ++i )
+        {
+            if( upperCase(name[i]) != found[i] )
+            {
+                return NOT_FOUND;
+            }
+        }
+        return commands_[slot - 1];
+    }
+
+private:
+    // Seeds tried before giving up
+    static constexpr std::uint32_t MAX_SEED = 100000;
+
+    // Every name, its hash and the index of its command
+    std::array<std::string_view, MAX_NAMES> names_;
+    std::array<std::uint32_t, MAX_NAMES> hashes_;
+    std::array<std::uint8_t, MAX_NAMES> commands_;
+
+    // One more than the index of the name in the slot, 0 for none
+    std::array<std::uint8_t, SLOTS> slots_;
+
+    std::size_t count_;
+    std::uint32_t seed_;
+    std::size_t longest_;
+
+    /**
+     * @brief upperCase
+     * @param c
+     * @return c in upper case, if it is an ASCII letter
+     */
+    static constexpr char upperCase(char c)
+    {
+        return c >= 'a' and c <= 'z' ? char(c - 'a' + 'A') : c;
+    }
+
+    /**
+     * @brief hash
+     * @param name
+     * @return FNV-1a hash of the name in upper case
+     */
+    static constexpr std::uint32_t hash(std::string_view name)
+    {
+        std::uint32_t value = 2166136261u;
+        for( char c : name )
+        {
+            value = (value ^ static_cast<unsigned char>(upperCase(c))) * 16777619u;
+        }
+        return value;
+    }
+
+    /**
+     * @brief slotOf
+     * @param hash of a name
+     * @param seed
+     * @return the slot of the name with the seed
+     */
+    static constexpr std::size_t slotOf(std::uint32_t hash, std::uint32_t seed)
+    {
+        std::uint32_t value = hash + seed * 0x9e3779b9u;
+        value ^= value >> 16;
+        value *= 0x85ebca6bu;
+        value ^= value >> 13;
+        value *= 0xc2b2ae35u;
+        value ^= value >> 16;
+        return value & (SLOTS - 1);
+    }
+
+    /**
+     * @brief fill
+     * @return true if no two names share a slot with the current seed, the
+     * slots then filled
+     */
+    constexpr bool fill()
+    {
+        for( std::uint8_t& slot : slots_ )
+        {
+            slot = 0;
+        }
+        for( std::size_t i = 0; i < count_; ++i )
+        {
+            std::uint8_t& slot = slots_[slotOf(hashes_[i], seed_)];
+            if( slot != 0 )
+            {
+                return false;
+            }
+            slot = static_cast<std::uint8_t>(i + 1);
+        }
+        return true;
+    }
+};
+
+#endif // COMMANDTABLE_HH
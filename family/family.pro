@@ -1,16 +1,50 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++17 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
+# The statistics of the commands are compiled out with "qmake CONFIG+=nostats".
+nostats: DEFINES += FAMILY_NO_STATS
+
 SOURCES += main.cpp \
+    ancestorindex.cpp \
+    bufferedsink.cpp \
     familytree.cpp \
     cli.cpp \
+    loader.cpp \
+    mappedfile.cpp \
+    mutationlog.cpp \
+    queryexecutor.cpp \
+    querystats.cpp \
+    resultcache.cpp \
+    server.cpp \
+    snapshot.cpp \
+    threadpool.cpp \
+    treeversions.cpp \
     utils.cpp
 
 HEADERS += \
+    ancestorindex.hh \
+    arguments.hh \
+    bufferedsink.hh \
+    chunkedcolumn.hh \
+    column.hh \
+    commandtable.hh \
     familytree.hh \
     cli.hh \
+    loader.hh \
+    mappedfile.hh \
+    mutationlog.hh \
+    personset.hh \
+    protocol.hh \
+    queryexecutor.hh \
+    querystats.hh \
+    resultcache.hh \
+    server.hh \
+    snapshot.hh \
+    stringsink.hh \
+    threadpool.hh \
+    treeversions.hh \
     utils.hh
 
 DISTFILES += \
@@ -1,15 +1,251 @@
 #include "familytree.hh"
+#include "ancestorindex.hh"
+#include "mappedfile.hh"
+#include "personset.hh"
+#include "querystats.hh"
+#include "snapshot.hh"
+#include "threadpool.hh"
+#include "utils.hh"
 #include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
-#include <set>
+#include <numeric>
 #include <vector>
-#include <queue>
+#include <thread>
+#include <unistd.h>
 
 using namespace std;
 
-// Helper functions declaration, these help in finding the tallest and shortest persons in the family tree.
-Person* findTallest(Person* p);
-Person* findShortest(Person* p);
+namespace {
+// Smallest size of the id hash table, which is kept at most half full.
+const size_t MIN_ID_TABLE_SIZE = 16;
+
+// A descendant level whose frontier holds more than 1/DENSE_FRONTIER_SHARE
+// of all persons is expanded with a sweep over every person.
+const size_t DENSE_FRONTIER_SHARE = 16;
+
+// Starting size of the ancestor tables of a relation search.
+const size_t MIN_STEP_MAP_SIZE = 64;
+
+// Ids ahead of the one looked up whose slots getIndexes fetches, enough to
+// cover the latency of memory.
+const size_t LOOKUP_AHEAD = 8;
+
+// Persons frozen since the orders of everyone were built are kept apart
+// until there are more than this many and more than 1/PENDING_SHARE of
+// those in the orders.
+const size_t MIN_PENDING_PERSONS = 1024;
+const size_t PENDING_SHARE = 256;
+
+// The places the children lists have left unused are dropped when there
+// are more than this many and more than there are children.
+const size_t MIN_UNUSED_CHILD_PLACES = 4096;
+
+// Percentiles of the height statistics, by the nearest rank, and their names.
+const array<size_t, 5> HEIGHT_PERCENTILES = {10, 25, 50, 75, 90};
+const array<const char*, 5> PERCENTILE_NAMES = {"10%", "25%", "median", "75%", "90%"};
+
+/**
+* @brief: FNV-1a hash of a person's id, used for the id hash table.
+* @param: id
+* Returns the hash value.
+*/
+uint32_t hashId(string_view id) {
+    uint32_t hash = 2166136261U;
+    for (char c : id) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619U;
+    }
+    // Mix the high bits into the low ones used for the table slot.
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+/**
+* @brief: The first eight characters of an id as a number that compares like the ids.
+* @param: id
+* Returns the characters in big endian order, padded with zeros.
+*/
+uint64_t idPrefix(string_view id) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < sizeof(prefix); ++i) {
+        prefix <<= 8;
+        if (i < id.size()) {
+            prefix |= static_cast<unsigned char>(id[i]);
+        }
+    }
+    return prefix;
+}
+
+/**
+* @brief: Gives the buffer for the members of a printed group. It is kept between the
+*         queries of a thread, so that a query doesn't allocate once the buffer is big enough.
+* Returns the buffer, empty.
+*/
+vector<PersonIndex>& groupBuffer() {
+    thread_local vector<PersonIndex> members;
+    members.clear();
+    return members;
+}
+
+/**
+* @brief: Tells if a child with the given parents is in the children list of the parent in the slot.
+* @param: parents: The parents of the child.
+* @param: slot: 0 for the first parent, 1 for the second.
+* Returns true when it is, a child with the same parent twice is listed once.
+*/
+bool isListed(const ParentPair& parents, int slot) {
+    return parents[slot] != NO_PERSON && (slot == 0 || parents[0] != parents[1]);
+}
+
+/**
+* @brief: Steps from a person up to its ancestors, in an open addressing hash table that
+*         grows when half full.
+*/
+class StepMap {
+public:
+    StepMap() : slots_(MIN_STEP_MAP_SIZE, {NO_PERSON, 0}) {}
+
+    /**
+    * @brief: Adds the steps of the person unless it has some already.
+    * Returns true if the person was added.
+    */
+    bool insert(PersonIndex person, uint32_t steps) {
+        if (2 * (count_ + 1) > slots_.size()) {
+            vector<Slot> old(slots_.size() * 2, {NO_PERSON, 0});
+            old.swap(slots_);
+            count_ = 0;
+            for (const Slot& slot : old) {
+                if (slot.person_ != NO_PERSON) {
+                    insert(slot.person_, slot.steps_);
+                }
+            }
+        }
+        size_t i = find(person);
+        if (slots_[i].person_ == person) {
+            return false;
+        }
+        slots_[i] = {person, steps};
+        ++count_;
+        return true;
+    }
+
+    /**
+    * @brief: Returns the steps of the person, or UINT32_MAX if it has none.
+    */
+    uint32_t steps(PersonIndex person) const {
+        const Slot& slot = slots_[find(person)];
+        return slot.person_ == person ? slot.steps_ : UINT32_MAX;
+    }
+
+private:
+    struct Slot {
+        PersonIndex person_;
+        uint32_t steps_;
+    };
+
+    size_t find(PersonIndex person) const {
+        size_t mask = slots_.size() - 1;
+        size_t i = (person * 0x9E3779B1U) & mask;
+        while (slots_[i].person_ != NO_PERSON && slots_[i].person_ != person) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    vector<Slot> slots_;
+    size_t count_ = 0;
+};
+
+/**
+* @brief: Names a number in a cousin relation.
+* @param: n: 1 or more.
+* Returns "first", "second", ... for the small numbers, otherwise "21st" etc.
+*/
+string ordinal(unsigned int n) {
+    static const vector<string> NAMES = {"first", "second", "third", "fourth", "fifth",
+                                         "sixth", "seventh", "eighth", "ninth", "tenth"};
+    if (n <= NAMES.size()) {
+        return NAMES.at(n - 1);
+    }
+    if (n % 100 / 10 == 1 || n % 10 == 0 || n % 10 > 3) {
+        return to_string(n) + "th";
+    }
+    return to_string(n) + (n % 10 == 1 ? "st" : n % 10 == 2 ? "nd" : "rd");
+}
+
+/**
+* @brief: Repeats "great-" as many times as asked.
+* @param: n
+*/
+string greats(unsigned int n) {
+    string result;
+    for (unsigned int i = 0; i < n; ++i) {
+        result += "great-";
+    }
+    return result;
+}
+
+/**
+* @brief: Names how many generations apart two cousins are.
+* @param: removed
+* Returns "", " once removed", " twice removed" or e.g. " 3 times removed".
+*/
+string removedName(unsigned int removed) {
+    if (removed == 0) {
+        return "";
+    }
+    if (removed <= 2) {
+        return removed == 1 ? " once removed" : " twice removed";
+    }
+    return " " + to_string(removed) + " times removed";
+}
+
+/**
+* @brief: Names the relative of a person related through a common ancestor.
+* @param: person_steps: Steps from the person up to the ancestor.
+* @param: relative_steps: Steps from the relative up to the ancestor.
+* @param: half: True if the relation goes through one ancestor instead of a couple.
+* Returns e.g. "grandparent", "half sibling" or "second cousin once removed".
+*/
+string kinshipName(unsigned int person_steps, unsigned int relative_steps, bool half) {
+    if (relative_steps == 0) {
+        return person_steps == 1 ? "parent" : greats(person_steps - 2) + "grandparent";
+    }
+    if (person_steps == 0) {
+        return relative_steps == 1 ? "child" : greats(relative_steps - 2) + "grandchild";
+    }
+    string name = half ? "half " : "";
+    if (person_steps == 1 && relative_steps == 1) {
+        return name + "sibling";
+    }
+    if (relative_steps == 1) {
+        return name + greats(person_steps - 2) + "aunt/uncle";
+    }
+    if (person_steps == 1) {
+        return name + greats(relative_steps - 2) + "niece/nephew";
+    }
+    unsigned int removed = max(person_steps, relative_steps) - min(person_steps, relative_steps);
+    return name + ordinal(min(person_steps, relative_steps) - 1) + " cousin" + removedName(removed);
+}
+}
+
+/**
+* @brief: Calls func for every child of the person, in the order they were added.
+* @param: person: The index of the parent.
+* @param: func: Function taking the index of a child.
+*/
+template <typename Func>
+void Familytree::forEachChild(PersonIndex person, Func func) const {
+    const PersonIndex* end = child_list_.data() + child_end_[person];
+    for (const PersonIndex* child = child_list_.data() + child_begin_[person]; child != end; ++child) {
+        func(*child);
+    }
+}
 
 
 // Constructor for the Familytree class. Initializes an empty family tree.
@@ -18,496 +254,2078 @@ Familytree::Familytree() {
 }
 
 /**
-* @brief: Adds a new person to the family tree.
-* @param  id: The unique name/ID of the person.
-* @param  height: The height of the person.
-* @param  output (A stream to print out errors or confirmations).
+* @brief: Adds a new person to the family tree.
+* @param  id: The unique name/ID of the person.
+* @param  height: The height of the person.
+* @param  output (A stream to print out errors or confirmations).
+*/
+void Familytree::addNewPerson(string_view id, int height, ostream &output) {
+    // Check if the person is already in the tree using the getIndex function.
+    if (getIndex(id) != NO_PERSON) {
+        output << ALREADY_ADDED << '\n'; // If already added, print error and return.
+        return;
+    }
+
+    // Append the new person to the end of every column.
+    PersonIndex new_person = static_cast<PersonIndex>(heights_.size());
+    id_chars_.append(id);
+    id_offsets_.push_back(static_cast<uint32_t>(id_chars_.size()));
+    heights_.push_back(height);
+    parents_.push_back({NO_PERSON, NO_PERSON});
+    tallest_.push_back(new_person);
+    shortest_.push_back(new_person);
+    child_begin_.push_back(static_cast<uint32_t>(child_list_.size()));
+    child_end_.push_back(static_cast<uint32_t>(child_list_.size()));
+
+    // Index the new person by id.
+    insertToIdTable({new_person, hashId(id)});
+
+    // The ancestor index gets the new person as a founder.
+    shared_ptr<const AncestorIndex> index = atomic_load(&ancestor_index_.index_);
+    if (index != nullptr) {
+        shared_ptr<AncestorIndex> patched = make_shared<AncestorIndex>(*index);
+        patched->addPerson(new_person);
+        atomic_store(&ancestor_index_.index_, shared_ptr<const AncestorIndex>(move(patched)));
+    }
+}
+
+/**
+* @brief: This function establishes a parent-child relationship between people in the family tree.
+* @param child_id: The name of the child.
+* @param parents: A list of parent names (up to two).
+* @param output (A stream to print out errors if needed).
+*/
+void Familytree::addRelation(const string& child_id, const vector<string>& parents, ostream& output) {
+    // Look for the child in the family tree.
+    PersonIndex child = getIndex(child_id);
+
+    // If the child doesn't exist, print an error and return.
+    if (child == NO_PERSON) {
+        printNotFound(child_id, output);
+        return;
+    }
+
+    // Loop through the parents and connect them to the child.
+    for (size_t i = 0; i < parents.size() && i < 2; ++i) {
+        if (parents[i] != "-") { // If parent is valid (not "-").
+            // Find the parent in the family tree.
+            PersonIndex parent = getIndex(parents[i]);
+            if (parent != NO_PERSON) {
+                setParent(child, static_cast<int>(i), parent);
+            }
+        }
+    }
+}
+
+/**
+* @brief: Establishes a parent-child relationship between persons already looked up.
+* @param child: The index of the child.
+* @param parents: The indices of the parents, NO_PERSON for an unknown parent.
+*/
+void Familytree::addRelation(PersonIndex child, const ParentPair& parents) {
+    for (int slot = 0; slot < 2; ++slot) {
+        if (parents[slot] != NO_PERSON) {
+            setParent(child, slot, parents[slot]);
+        }
+    }
+}
+
+/**
+* @brief: Establishes many parent-child relationships at once and freezes the tree.
+* @param relations: Children and their parents, NO_PERSON for an unknown parent.
+* @param threads: Number of threads assigning the parents.
+*/
+void Familytree::addRelations(const vector<IndexedRelation>& relations, unsigned int threads) {
+    // The first relation of every child is applied in parallel, so that no
+    // two threads write the same child. Later relations of the same child
+    // are applied in order afterwards.
+    vector<bool> seen(heights_.size(), false);
+    vector<size_t> repeated;
+    vector<bool> is_repeated(relations.size(), false);
+    for (size_t i = 0; i < relations.size(); ++i) {
+        if (seen[relations[i].child_]) {
+            repeated.push_back(i);
+            is_repeated[i] = true;
+        }
+        seen[relations[i].child_] = true;
+    }
+
+    // Copy the shared and viewed chunks before the threads write to them.
+    parents_.detach();
+    auto apply = [this](const IndexedRelation& relation) {
+        ParentPair parents = parents_[relation.child_];
+        for (int slot = 0; slot < 2; ++slot) {
+            if (relation.parents_[slot] != NO_PERSON) {
+                parents[slot] = relation.parents_[slot];
+            }
+        }
+        parents_.set(relation.child_, parents);
+    };
+    threads = max(1U, threads);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            size_t begin = relations.size() * t / threads;
+            size_t end = relations.size() * (t + 1) / threads;
+            for (size_t i = begin; i < end; ++i) {
+                if (!is_repeated[i]) {
+                    apply(relations[i]);
+                }
+            }
+        });
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    for (size_t i : repeated) {
+        apply(relations[i]);
+    }
+
+    // The children lists no longer match the parents, pack the children
+    // from the parents instead.
+    packChildren();
+    orderIds();
+    orderHeights();
+    pending_ids_.clear();
+    pending_heights_.clear();
+    computeExtremes();
+    atomic_store(&ancestor_index_.index_, shared_ptr<const AncestorIndex>());
+}
+
+/**
+* @brief: Tells if a person is an ancestor of another.
+* @param: ancestor
+* @param: person
+* Returns true if it is.
+*/
+bool Familytree::isAncestor(PersonIndex ancestor, PersonIndex person) const {
+    return ancestorIndex()->isAncestor(ancestor, person);
+}
+
+/**
+* @brief: Tells for many pairs if the first person is an ancestor of the second.
+* @param: pairs
+* @param: threads: Number of threads answering, each a contiguous part of the pairs.
+* Returns 1 for the pairs where it is, 0 for the others.
+*/
+vector<uint8_t> Familytree::areAncestors(const vector<AncestryPair>& pairs, unsigned int threads) const {
+    shared_ptr<const AncestorIndex> index = ancestorIndex();
+    vector<uint8_t> answers(pairs.size(), 0);
+    threads = max(1U, threads);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            size_t begin = pairs.size() * t / threads;
+            size_t end = pairs.size() * (t + 1) / threads;
+            for (size_t i = begin; i < end; ++i) {
+                answers[i] = index->isAncestor(pairs[i].ancestor_, pairs[i].person_);
+            }
+        });
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    return answers;
+}
+
+/**
+* @brief: Reserves room for persons to be added.
+* @param: persons: The number of persons.
+* @param: id_chars: The total length of their IDs.
+*/
+void Familytree::reserve(size_t persons, size_t id_chars) {
+    size_t total = heights_.size() + persons;
+    id_chars_.reserve(id_chars_.size() + id_chars);
+    id_offsets_.reserve(total + 1);
+    heights_.reserve(total);
+    parents_.reserve(total);
+    tallest_.reserve(total);
+    shortest_.reserve(total);
+    child_begin_.reserve(total);
+    child_end_.reserve(total);
+    // Grow the id table once instead of doubling it on the way.
+    size_t table_size = max(MIN_ID_TABLE_SIZE, id_table_.size());
+    while (table_size < 2 * total) {
+        table_size *= 2;
+    }
+    if (table_size > id_table_.size()) {
+        growIdTable(table_size);
+    }
+}
+
+/**
+* @brief: Orders the persons added since the last freeze, and drops the places the children
+*         lists have left unused once there are more of them than children.
+*/
+void Familytree::freeze() {
+    if (child_list_.size() - listed_children_ > max(MIN_UNUSED_CHILD_PLACES, listed_children_)) {
+        compactChildren();
+    }
+    placeNewPersons();
+
+    // Lineages left behind by deferExtremes are computed all at once.
+    if (extremes_deferred_) {
+        computeExtremes();
+        extremes_deferred_ = false;
+    }
+}
+
+/**
+* @brief: Packs the children lists and merges every person into the orders, so that the
+*         tree can be saved as it is.
+*/
+void Familytree::pack() {
+    if (!children_packed_) {
+        compactChildren();
+    }
+    orderIds();
+    orderHeights();
+    pending_ids_.clear();
+    pending_heights_.clear();
+    if (extremes_deferred_) {
+        computeExtremes();
+        extremes_deferred_ = false;
+    }
+}
+
+/**
+* @brief: Tells if the tree is packed, see pack.
+*/
+bool Familytree::isPacked() const {
+    return children_packed_ && id_order_.size() == size() && height_order_.size() == size()
+           && !extremes_deferred_;
+}
+
+/**
+* @brief: Places the persons added since the last call into the pending orders, which are
+*         small enough to be merged with them quickly. Once they grow too big, they are
+*         merged into the orders of everyone instead.
+*/
+void Familytree::placeNewPersons() {
+    size_t ordered = id_order_.size();
+    size_t placed = ordered + pending_ids_.size();
+    if (placed == size()) {
+        return;
+    }
+    if (size() - ordered > max(MIN_PENDING_PERSONS, ordered / PENDING_SHARE)) {
+        orderIds();
+        orderHeights();
+        pending_ids_.clear();
+        pending_heights_.clear();
+        return;
+    }
+
+    vector<PersonIndex> added(size() - placed);
+    iota(added.begin(), added.end(), static_cast<PersonIndex>(placed));
+    sortById(added);
+    size_t middle = pending_ids_.size();
+    pending_ids_.insert(pending_ids_.end(), added.begin(), added.end());
+    inplace_merge(pending_ids_.begin(), pending_ids_.begin() + middle, pending_ids_.end(),
+        [this](PersonIndex a, PersonIndex b) {
+            return idOf(a) < idOf(b);
+        });
+
+    sortByHeight(added);
+    middle = pending_heights_.size();
+    pending_heights_.insert(pending_heights_.end(), added.begin(), added.end());
+    inplace_merge(pending_heights_.begin(), pending_heights_.begin() + middle, pending_heights_.end(),
+        [this](PersonIndex a, PersonIndex b) {
+            return heightBefore(a, b);
+        });
+}
+
+/**
+* @brief: Stops updating the tallest and shortest person of the lineages on every new
+*         relation, until the tree is frozen again.
+*/
+void Familytree::deferExtremes() {
+    extremes_deferred_ = true;
+}
+
+/**
+* @brief: Merges the persons added since the last freeze into the id order. Only the new
+*         persons are sorted, and only the ranks after the first of them change.
+*/
+void Familytree::orderIds() {
+    size_t ordered = id_order_.size();
+    if (ordered == heights_.size()) {
+        return;
+    }
+
+    // Most ids differ in their first characters, so sort by those before
+    // looking at the ids themselves.
+    vector<pair<uint64_t, PersonIndex>> added;
+    added.reserve(heights_.size() - ordered);
+    for (PersonIndex person = static_cast<PersonIndex>(ordered); person < heights_.size(); ++person) {
+        added.push_back({idPrefix(idOf(person)), person});
+    }
+    sort(added.begin(), added.end(),
+        [this](const pair<uint64_t, PersonIndex>& a, const pair<uint64_t, PersonIndex>& b) {
+            return a.first != b.first ? a.first < b.first : idOf(a.second) < idOf(b.second);
+        });
+
+    vector<PersonIndex> order;
+    order.reserve(heights_.size());
+    const PersonIndex* next = id_order_.begin();
+    size_t first_changed = 0;
+    for (const auto& [prefix, person] : added) {
+        const PersonIndex* place = lower_bound(next, id_order_.end(), person,
+            [this](PersonIndex a, PersonIndex b) {
+                return idOf(a) < idOf(b);
+            });
+        order.insert(order.end(), next, place);
+        if (person == added.front().second) {
+            first_changed = order.size();
+        }
+        order.push_back(person);
+        next = place;
+    }
+    order.insert(order.end(), next, id_order_.end());
+
+    id_order_.assign(order);
+    vector<uint32_t> ranks(id_rank_.begin(), id_rank_.end());
+    ranks.resize(heights_.size());
+    for (size_t i = first_changed; i < id_order_.size(); ++i) {
+        ranks[id_order_[i]] = static_cast<uint32_t>(i);
+    }
+    id_rank_.assign(ranks);
+}
+
+/**
+* @brief: Sorts persons by their IDs, comparing ranks where the persons have them.
+* @param: persons: Sorted in place, NO_PERSON and repeated persons are removed.
+*/
+void Familytree::sortById(vector<PersonIndex>& persons) const {
+    persons.erase(remove(persons.begin(), persons.end(), NO_PERSON), persons.end());
+    size_t ranked = id_rank_.size();
+    sort(persons.begin(), persons.end(), [this, ranked](PersonIndex a, PersonIndex b) {
+        if (a < ranked && b < ranked) {
+            return id_rank_[a] < id_rank_[b];
+        }
+        return idOf(a) < idOf(b);
+    });
+    persons.erase(unique(persons.begin(), persons.end()), persons.end());
+}
+
+/**
+* @brief: Merges the persons added since the last call into the height order. The ids are
+*         ordered first, so that the persons of the same height can be merged by rank.
+*/
+void Familytree::orderHeights() {
+    size_t ordered = height_order_.size();
+    if (ordered == heights_.size()) {
+        return;
+    }
+
+    vector<PersonIndex> added(heights_.size() - ordered);
+    iota(added.begin(), added.end(), static_cast<PersonIndex>(ordered));
+    sortByHeight(added);
+
+    vector<PersonIndex> order(heights_.size());
+    merge(height_order_.begin(), height_order_.end(), added.begin(), added.end(), order.begin(),
+        [this](PersonIndex a, PersonIndex b) {
+            return heights_[a] != heights_[b] ? heights_[a] < heights_[b] : id_rank_[a] < id_rank_[b];
+        });
+    height_order_.assign(order);
+}
+
+/**
+* @brief: Sorts persons by their heights, and those of the same height by their IDs.
+* @param: persons: Sorted in place.
+*/
+void Familytree::sortByHeight(vector<PersonIndex>& persons) const {
+    sort(persons.begin(), persons.end(), [this](PersonIndex a, PersonIndex b) {
+        return heightBefore(a, b);
+    });
+}
+
+/**
+* @brief: Compares persons by their heights, and those of the same height by their IDs,
+*         comparing ranks where the persons have them.
+* @param: first
+* @param: second
+* Returns true if the first comes before the second.
+*/
+bool Familytree::heightBefore(PersonIndex first, PersonIndex second) const {
+    if (heights_[first] != heights_[second]) {
+        return heights_[first] < heights_[second];
+    }
+    size_t ranked = id_rank_.size();
+    if (first < ranked && second < ranked) {
+        return id_rank_[first] < id_rank_[second];
+    }
+    return idOf(first) < idOf(second);
+}
+
+/**
+* @brief: Gives every person in the order of their heights, in two parts to be merged.
+* @param: sorted: Used for the order if some persons were added after the last freeze.
+* Returns the first and the past the last person of both parts.
+*/
+array<Familytree::Persons, 2> Familytree::heightOrders(vector<PersonIndex>& sorted) const {
+    if (height_order_.size() + pending_heights_.size() == heights_.size()) {
+        return {{{height_order_.begin(), height_order_.end()},
+                 {pending_heights_.data(), pending_heights_.data() + pending_heights_.size()}}};
+    }
+    sorted.resize(heights_.size());
+    iota(sorted.begin(), sorted.end(), 0);
+    sortByHeight(sorted);
+    const PersonIndex* end = sorted.data() + sorted.size();
+    return {{{sorted.data(), end}, {end, end}}};
+}
+
+/**
+* @brief: Finds the persons whose height is in a range, with two binary searches of both
+*         parts of the height order. The persons of the parts are merged only if both
+*         have some.
+* @param: low: The lowest height.
+* @param: high: The highest height.
+* @param: sorted: See heightOrders, also used for the merged persons.
+* Returns the first and the past the last person of the range.
+*/
+Familytree::Persons Familytree::heightRange(int low, int high, vector<PersonIndex>& sorted) const {
+    array<Persons, 2> found = heightOrders(sorted);
+    for (Persons& part : found) {
+        part.first = lower_bound(part.first, part.second, low, [this](PersonIndex person, int height) {
+            return heights_[person] < height;
+        });
+        part.second = upper_bound(part.first, part.second, high, [this](int height, PersonIndex person) {
+            return height < heights_[person];
+        });
+    }
+    if (found[1].first == found[1].second) {
+        return found[0];
+    }
+    if (found[0].first == found[0].second) {
+        return found[1];
+    }
+    vector<PersonIndex> merged(found[0].second - found[0].first + found[1].second - found[1].first);
+    merge(found[0].first, found[0].second, found[1].first, found[1].second, merged.begin(),
+        [this](PersonIndex a, PersonIndex b) {
+            return heightBefore(a, b);
+        });
+    sorted.swap(merged);
+    return {sorted.data(), sorted.data() + sorted.size()};
+}
+
+/**
+* @brief: Counts the children of every person and places them into child_list_ in index order.
+*/
+void Familytree::packChildren() {
+    vector<uint32_t> offsets(heights_.size() + 1, 0);
+    for (const ParentPair& parents : parents_) {
+        for (int slot = 0; slot < 2; ++slot) {
+            if (isListed(parents, slot)) {
+                ++offsets[parents[slot] + 1];
+            }
+        }
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+
+    vector<uint32_t> next_free(offsets.begin(), offsets.end() - 1);
+    vector<PersonIndex> children(offsets.back(), NO_PERSON);
+    for (PersonIndex child = 0; child < parents_.size(); ++child) {
+        const ParentPair& parents = parents_[child];
+        for (int slot = 0; slot < 2; ++slot) {
+            if (isListed(parents, slot)) {
+                children[next_free[parents[slot]]++] = child;
+            }
+        }
+    }
+    child_list_.assign(children);
+    child_end_.assign(next_free);
+    offsets.pop_back();
+    child_begin_.assign(offsets);
+    listed_children_ = children.size();
+    children_packed_ = true;
+}
+
+/**
+* @brief: Copies the children lists next to each other in person order, every list keeping
+*         its order, and drops the places left unused between them.
+*/
+void Familytree::compactChildren() {
+    vector<PersonIndex> children;
+    children.reserve(listed_children_);
+    vector<uint32_t> begins(size());
+    vector<uint32_t> ends(size());
+    for (PersonIndex person = 0; person < size(); ++person) {
+        begins[person] = static_cast<uint32_t>(children.size());
+        forEachChild(person, [&children](PersonIndex child) {
+            children.push_back(child);
+        });
+        ends[person] = static_cast<uint32_t>(children.size());
+    }
+    child_list_.assign(children);
+    child_begin_.assign(begins);
+    child_end_.assign(ends);
+    children_packed_ = true;
+}
+
+/**
+* @brief:Prints all the people in the family tree in alphabetical order by their ID.
+* @param output (The stream where the list of people is printed).
+ */
+void Familytree::printPersons(Params, ostream& output) const {
+    // The people are kept in alphabetical order by freeze, those frozen
+    // lately apart from the others. Only if some were added after the last
+    // freeze everyone is sorted here.
+    const PersonIndex* begin = id_order_.begin();
+    const PersonIndex* end = id_order_.end();
+    vector<PersonIndex> sorted_persons;
+    if (id_order_.size() + pending_ids_.size() != heights_.size()) {
+        sorted_persons.resize(heights_.size());
+        iota(sorted_persons.begin(), sorted_persons.end(), 0);
+        sortById(sorted_persons);
+    } else if (!pending_ids_.empty()) {
+        sorted_persons.resize(heights_.size());
+        merge(id_order_.begin(), id_order_.end(), pending_ids_.begin(), pending_ids_.end(),
+              sorted_persons.begin(), [this](PersonIndex a, PersonIndex b) {
+                  return idOf(a) < idOf(b);
+              });
+    }
+    if (!sorted_persons.empty()) {
+        begin = sorted_persons.data();
+        end = begin + sorted_persons.size();
+    }
+
+    // Print each person's ID and height.
+    STATS_RESULTS(heights_.size());
+    printHeights(begin, end, output);
+}
+
+/**
+* @brief: Prints all children of a given person in the family tree.
+* @param A list where params[0] is the person's name.
+* @param output (The stream to print the list of children).
+*/
+void Familytree::printChildren(Params params, ostream& output) const {
+    // Find the person using their name (ID).
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output); // If not found, print error and return.
+        return;
+    }
+
+    // Check if the person has children.
+    vector<PersonIndex>& children = groupBuffer();
+    forEachChild(person, [&children](PersonIndex child) {
+        children.push_back(child);
+    });
+    if (children.empty()) {
+        output << params.at(0) << " has no children." << '\n';
+    } else {
+        printGroup(params.at(0), "children", children, output);
+    }
+}
+
+/**
+* @brief: Prints all parents of a given person in the family tree.
+* @param A list where params[0] is the person's name.
+* @param output (The stream to print the list of parents).
+*/
+void Familytree::printParents(Params params, ostream& output) const {
+    // Find the person using their name (ID).
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output); // If not found, print error and return.
+        return;
+    }
+
+    // Get the person's parents and print them.
+    vector<PersonIndex>& parents = groupBuffer();
+    parents.assign(parents_[person].begin(), parents_[person].end());
+    sortById(parents);
+    if (parents.empty()) {
+        output << params.at(0) << " has no parents." << '\n';
+    } else {
+        printGroup(params.at(0), "parents", parents, output);
+    }
+}
+
+/**
+* @brief: Prints all siblings of a given person in the family tree.
+* @param: A list where params[0] is the person's name.
+* @param output (The stream to print the list of siblings).
+*/
+void Familytree::printSiblings(Params params, ostream& output) const {
+    // Find the person using their name (ID).
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output); // If not found, print error and return.
+        return;
+    }
+
+    // Find siblings by looking at the parents' other children.
+    vector<PersonIndex>& siblings = groupBuffer();
+    for (PersonIndex parent : parents_[person]) {
+        if (parent != NO_PERSON) {
+            forEachChild(parent, [&](PersonIndex sibling) {
+                STATS_VISITED(1);
+                if (sibling != person) {
+                    siblings.push_back(sibling);
+                }
+            });
+        }
+    }
+
+    // Print the siblings, or show that none exist.
+    if (siblings.empty()) {
+        output << params.at(0) << " has no siblings." << '\n';
+    } else {
+        printGroup(params.at(0), "siblings", siblings, output);
+    }
+}
+
+/**
+* @brief: Prints all cousins of a given person in the family tree.
+* @param: A list where params[0] is the person's name.
+* @param: output (The stream to print the list of cousins).
+*/
+void Familytree::printCousins(Params params, ostream& output) const {
+    // Find the person using their name (ID).
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output); // If not found, print error and return.
+        return;
+    }
+
+    // Find cousins by checking parents' siblings' children.
+    vector<PersonIndex>& cousins = groupBuffer();
+    for (PersonIndex parent : parents_[person]) {
+        if (parent != NO_PERSON) {
+            for (PersonIndex grandparent : parents_[parent]) {
+                if (grandparent != NO_PERSON) {
+                    forEachChild(grandparent, [&](PersonIndex uncle_aunt) {
+                        STATS_VISITED(1);
+                        if (uncle_aunt != parent) {
+                            forEachChild(uncle_aunt, [&](PersonIndex cousin) {
+                                STATS_VISITED(1);
+                                cousins.push_back(cousin);
+                            });
+                        }
+                    });
+                }
+            }
+        }
+    }
+
+    // Print the cousins, or show that none exist.
+    if (cousins.empty()) {
+        output << params.at(0) << " has no cousins." << '\n';
+    } else {
+        printGroup(params.at(0), "cousins", cousins, output);
+    }
+}
+
+/**
+* @brief: Prints the n-th cousins k times removed of a given person.
+* @param: A list where params[0] is the person's name, params[1] the degree n and params[2]
+*         the removal k.
+* @param: output (The stream to print the list of cousins).
+*/
+void Familytree::printCousinsN(Params params, ostream& output) const {
+    int degree = params.number(1);
+    int removed = params.number(2);
+    if (degree < 1) {
+        output << WRONG_LEVEL << '\n';
+        return;
+    }
+
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output);
+        return;
+    }
+
+    string group = ordinal(degree) + " cousins" + removedName(removed);
+    vector<PersonIndex>& found = groupBuffer();
+    cousins(person, degree, removed, found);
+    printGroup(params.at(0), group, found, output);
+}
+
+/**
+* @brief: Prints the grandchildren of a person up to a given level (generation).
+* @param: A list where params[0] is the person's name and params[1] is the level.
+* @param: output (The stream to print the list of grandchildren).
+*/
+void Familytree::printGrandChildrenN(Params params, ostream& output) const {
+    printGeneration(params, Direction::DOWN, "grandchildren", output);
+}
+
+/**
+* @brief: Prints all the grandparents of a person up to a given generation.
+* @param: A list where params[0] is the person's name and params[1] is the level.
+* @param: output (The stream to print the list of grandparents).
+*/
+void Familytree::printGrandParentsN(Params params, std::ostream& output) const {
+    printGeneration(params, Direction::UP, "grandparents", output);
+}
+
+/**
+* @brief: Prints how two persons are related.
+* @param: A list where params[0] is the person's name and params[1] the relative's.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printRelation(Params params, ostream& output) const {
+    PersonIndex person = getIndex(params.at(0));
+    PersonIndex relative = getIndex(params.at(1));
+    if (person == NO_PERSON || relative == NO_PERSON) {
+        printNotFound(person == NO_PERSON ? params.at(0) : params.at(1), output);
+        return;
+    }
+    if (person == relative) {
+        output << params.at(0) << " and " << params.at(1) << " are the same person." << '\n';
+        return;
+    }
+
+    Kinship found = kinship(person, relative);
+    if (found.ancestors_.empty()) {
+        output << params.at(0) << " and " << params.at(1) << " are not related." << '\n';
+        return;
+    }
+    bool direct_line = found.person_steps_ == 0 || found.relative_steps_ == 0;
+    output << params.at(1) << " is " << params.at(0) << "'s "
+           << kinshipName(found.person_steps_, found.relative_steps_, found.ancestors_.size() == 1)
+           << "." << '\n';
+    STATS_RESULTS(found.ancestors_.size());
+    if (!direct_line) {
+        vector<PersonIndex> ancestors = found.ancestors_;
+        sortById(ancestors);
+        output << params.at(0) << " and " << params.at(1) << " have " << ancestors.size()
+               << " lowest common ancestors:" << '\n';
+        for (PersonIndex ancestor : ancestors) {
+            output << idOf(ancestor) << '\n';
+        }
+    }
+}
+
+/**
+* @brief: Prints whether a person is an ancestor of another.
+* @param: A list where params[0] is the ancestor's name and params[1] the person's.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printIsAncestor(Params params, ostream& output) const {
+    PersonIndex ancestor = getIndex(params.at(0));
+    PersonIndex person = getIndex(params.at(1));
+    if (ancestor == NO_PERSON || person == NO_PERSON) {
+        printNotFound(ancestor == NO_PERSON ? params.at(0) : params.at(1), output);
+        return;
+    }
+    output << params.at(0) << (isAncestor(ancestor, person) ? " is " : " is not ")
+           << "an ancestor of " << params.at(1) << "." << '\n';
+}
+
+/**
+* @brief: Finds and prints the tallest person in a given person's lineage.
+* @param: A list where params[0] is the person's name.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printTallestInLineage(Params params, ostream& output) const {
+    // Find the person using their name (ID).
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output); // If not found, print error and return.
+        return;
+    }
+
+    // Find the tallest person in their lineage.
+    PersonIndex tallest = tallest_[person];
+    if (tallest != NO_PERSON) {
+        if (tallest == person) {
+            // Print if the person themselves is the tallest.
+            output << "With the height of " << heights_[tallest] << ", "
+                   << idOf(tallest) << " is the tallest person in his/her lineage." << '\n';
+        } else {
+            // Print if someone else in the lineage is taller.
+            output << "With the height of " << heights_[tallest] << ", "
+                   << idOf(tallest) << " is the tallest person in "
+                   << idOf(person) << "'s lineage." << '\n';
+        }
+    }
+}
+
+/**
+* @brief: Finds and prints the shortest person in a given person's lineage.
+* @param: A list where params[0] is the person's name.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printShortestInLineage(Params params, ostream& output) const {
+    // Find the person using their name (ID).
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output); // If not found, print error and return.
+        return;
+    }
+
+    // Find the shortest person in their lineage.
+    PersonIndex shortest = shortest_[person];
+    if (shortest != NO_PERSON) {
+        output << "With the height of " << heights_[shortest] << ", "
+               << idOf(shortest) << " is the shortest person in his/her lineage." << '\n';
+    }
+}
+
+/**
+* @brief: Prints the persons whose height is in the given range, shortest first.
+* @param: A list where params[0] is the lowest and params[1] the highest height.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printHeightRange(Params params, ostream& output) const {
+    int low = params.number(0);
+    int high = params.number(1);
+    vector<PersonIndex>& sorted = groupBuffer();
+    auto [begin, end] = heightRange(low, high, sorted);
+    STATS_RESULTS(end - begin);
+    if (begin == end) {
+        output << "Nobody is from " << low << " to " << high << " cm tall." << '\n';
+    } else {
+        output << end - begin << " persons are from " << low << " to " << high << " cm tall:" << '\n';
+        printHeights(begin, end, output);
+    }
+}
+
+/**
+* @brief: Prints the number of persons whose height is in the given range.
+* @param: A list where params[0] is the lowest and params[1] the highest height.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printHeightCount(Params params, ostream& output) const {
+    int low = params.number(0);
+    int high = params.number(1);
+    vector<PersonIndex>& sorted = groupBuffer();
+    auto [begin, end] = heightRange(low, high, sorted);
+    output << end - begin << " persons are from " << low << " to " << high << " cm tall." << '\n';
+}
+
+/**
+* @brief: Prints the tallest persons, the tallest first.
+* @param: A list where params[0] is the number of persons.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printTallestK(Params params, ostream& output) const {
+    int k = params.number(0);
+    if (k < 1) {
+        output << WRONG_COUNT << '\n';
+        return;
+    }
+    vector<PersonIndex>& sorted = groupBuffer();
+    array<Persons, 2> parts = heightOrders(sorted);
+    size_t everyone = (parts[0].second - parts[0].first) + (parts[1].second - parts[1].first);
+    size_t count = min(static_cast<size_t>(k), everyone);
+    STATS_RESULTS(count);
+    output << "The " << count << " tallest persons:" << '\n';
+
+    // The tallest come last in both parts of the height order. Every height is
+    // printed from its first person, so that the persons of the same height
+    // are by ID, merging the parts if both have persons of the height.
+    size_t left = count;
+    vector<PersonIndex> merged;
+    while (left > 0) {
+        int height = INT_MIN;
+        for (const Persons& part : parts) {
+            if (part.first != part.second) {
+                height = max(height, heights_[*(part.second - 1)]);
+            }
+        }
+        array<Persons, 2> runs;
+        for (int i = 0; i < 2; ++i) {
+            const PersonIndex* run_begin = lower_bound(parts[i].first, parts[i].second, height,
+                [this](PersonIndex person, int h) {
+                    return heights_[person] < h;
+                });
+            runs[i] = {run_begin, parts[i].second};
+            parts[i].second = run_begin;
+        }
+        Persons run = runs[0].first != runs[0].second ? runs[0] : runs[1];
+        if (runs[0].first != runs[0].second && runs[1].first != runs[1].second) {
+            merged.resize((runs[0].second - runs[0].first) + (runs[1].second - runs[1].first));
+            merge(runs[0].first, runs[0].second, runs[1].first, runs[1].second, merged.begin(),
+                [this](PersonIndex a, PersonIndex b) {
+                    return heightBefore(a, b);
+                });
+            run = {merged.data(), merged.data() + merged.size()};
+        }
+        size_t printed = min(left, static_cast<size_t>(run.second - run.first));
+        printHeights(run.first, run.first + printed, output);
+        left -= printed;
+    }
+}
+
+/**
+* @brief: Prints the persons in a given person's lineage whose height is in the given range,
+*         shortest first. The heights of the whole lineage are filtered in one vectorized
+*         pass, and only the persons found are sorted.
+* @param: A list where params[0] is the person's name, params[1] the lowest and params[2]
+*         the highest height.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printLineageHeightRange(Params params, ostream& output) const {
+    // Find the person using their name (ID).
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output); // If not found, print error and return.
+        return;
+    }
+    int low = params.number(1);
+    int high = params.number(2);
+
+    thread_local vector<PersonIndex> members;
+    lineage(person, Direction::DOWN, members);
+    vector<PersonIndex>& found = groupBuffer();
+    Utils::selectInRange(heights_.data(), members, low, high, found);
+    sortByHeight(found);
+    STATS_RESULTS(found.size());
+    if (found.empty()) {
+        output << params.at(0) << "'s lineage has nobody from " << low << " to " << high
+               << " cm tall." << '\n';
+    } else {
+        output << params.at(0) << "'s lineage has " << found.size() << " persons from " << low
+               << " to " << high << " cm tall:" << '\n';
+        printHeights(found.data(), found.data() + found.size(), output);
+    }
+}
+
+/**
+* @brief: Prints the statistics of the heights in a given person's lineage.
+* @param: A list where params[0] is the person's name.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printLineageStats(Params params, ostream& output) const {
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output);
+        return;
+    }
+    printHeightStats(person, Direction::DOWN, heightStats(person, Direction::DOWN), output);
+}
+
+/**
+* @brief: Prints the statistics of the heights of a given person and their ancestors.
+* @param: A list where params[0] is the person's name.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printAncestryStats(Params params, ostream& output) const {
+    PersonIndex person = getIndex(params.at(0));
+    if (person == NO_PERSON) {
+        printNotFound(params.at(0), output);
+        return;
+    }
+    printHeightStats(person, Direction::UP, heightStats(person, Direction::UP), output);
+}
+
+/**
+* @brief: Prints the statistics of the lineage of every person without parents.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printLineageStatsOfRoots(Params, ostream& output) const {
+    printStatsOfAll(Direction::DOWN, output);
+}
+
+/**
+* @brief: Prints the statistics of the ancestry of every person without children.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printAncestryStatsOfLeaves(Params, ostream& output) const {
+    printStatsOfAll(Direction::UP, output);
+}
+
+/**
+* @brief: Computes the statistics of the heights in a person's lineage or ancestry. The
+*         members are collected once, and their heights gathered, summed and compared in
+*         vectorized passes before the percentiles are selected.
+* @param: person: The index of the person.
+* @param: direction: DOWN for the lineage, UP for the ancestry.
+* Returns the statistics, the person included.
+*/
+Familytree::HeightStats Familytree::heightStats(PersonIndex person, Direction direction) const {
+    // Kept between the calls of a thread, like the group buffer.
+    thread_local vector<PersonIndex> members;
+    thread_local vector<int> heights;
+    lineage(person, direction, members);
+    Utils::Summary summary = Utils::gatherValues(heights_.data(), members, heights);
+
+    HeightStats stats;
+    stats.count_ = heights.size();
+    stats.mean_ = static_cast<double>(summary.sum_) / stats.count_;
+    stats.variance_ = Utils::squaredDeviations(heights, stats.mean_) / stats.count_;
+    stats.min_ = summary.min_;
+    stats.max_ = summary.max_;
+
+    // Every selection leaves the larger heights after the one found, so the
+    // next one searches only those.
+    vector<int>::iterator first = heights.begin();
+    for (size_t i = 0; i < HEIGHT_PERCENTILES.size(); ++i) {
+        size_t rank = max<size_t>(1, (HEIGHT_PERCENTILES[i] * stats.count_ + 99) / 100);
+        vector<int>::iterator nth = heights.begin() + (rank - 1);
+        nth_element(first, nth, heights.end());
+        stats.percentiles_[i] = *nth;
+        first = nth;
+    }
+    return stats;
+}
+
+/**
+* @brief: Prints the statistics of the heights in a person's lineage or ancestry on one line.
+* @param: person: The index of the person.
+* @param: direction: DOWN for the lineage, UP for the ancestry.
+* @param: stats: The statistics.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printHeightStats(PersonIndex person, Direction direction,
+                                  const HeightStats& stats, ostream& output) const {
+    // Formatted apart, so that the precision of the stream isn't changed.
+    char moments[64];
+    snprintf(moments, sizeof(moments), "mean %.2f, variance %.2f", stats.mean_, stats.variance_);
+    output << "Heights in " << idOf(person) << (direction == Direction::DOWN ? "'s lineage: " : "'s ancestry: ")
+           << stats.count_ << " persons, " << moments << ", min " << stats.min_;
+    for (size_t i = 0; i < HEIGHT_PERCENTILES.size(); ++i) {
+        output << ", " << PERCENTILE_NAMES[i] << " " << stats.percentiles_[i];
+    }
+    output << ", max " << stats.max_ << "." << '\n';
+}
+
+/**
+* @brief: Prints the statistics of the lineages of the persons without parents, or of the
+*         ancestries of the persons without children, in the order of their IDs. The
+*         statistics are computed on the shared pool, a person at a time, so that a big
+*         lineage doesn't keep the other cores waiting. A query already run on a pool
+*         thread, like those of QueryExecutor, computes them alone, the other cores being
+*         busy with the other queries.
+* @param: direction: DOWN for the lineages, UP for the ancestries.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printStatsOfAll(Direction direction, ostream& output) const {
+    vector<uint8_t> has_children(size(), 0);
+    for (const ParentPair& parents : parents_) {
+        for (PersonIndex parent : parents) {
+            if (parent != NO_PERSON) {
+                has_children[parent] = 1;
+            }
+        }
+    }
+    vector<PersonIndex>& starts = groupBuffer();
+    for (PersonIndex person = 0; person < size(); ++person) {
+        bool root = parents_[person][0] == NO_PERSON && parents_[person][1] == NO_PERSON;
+        if (direction == Direction::DOWN ? root : !has_children[person]) {
+            starts.push_back(person);
+        }
+    }
+    sortById(starts);
+
+    vector<HeightStats> stats(starts.size());
+    auto compute = [&](size_t i) {
+        stats[i] = heightStats(starts[i], direction);
+    };
+    if (ThreadPool::onWorker()) {
+        for (size_t i = 0; i < starts.size(); ++i) {
+            compute(i);
+        }
+    } else {
+        ThreadPool::shared().forEach(starts.size(), compute);
+    }
+    STATS_RESULTS(starts.size());
+    for (size_t i = 0; i < starts.size(); ++i) {
+        printHeightStats(starts[i], direction, stats[i], output);
+    }
+}
+
+/**
+* @brief: Recomputes the tallest and shortest person in a person's lineage from those of the children.
+*         Ties go to the person first in the order person, first child's lineage, second child's...
+* @param: person: The index of the person.
+* Returns true if either of them changed.
+*/
+bool Familytree::foldExtremes(PersonIndex person) {
+    PersonIndex tallest = person;
+    PersonIndex shortest = person;
+    forEachChild(person, [&](PersonIndex child) {
+        if (heights_[tallest_[child]] > heights_[tallest]) {
+            tallest = tallest_[child];
+        }
+        if (heights_[shortest_[child]] < heights_[shortest]) {
+            shortest = shortest_[child];
+        }
+    });
+    if (tallest == tallest_[person] && shortest == shortest_[person]) {
+        return false;
+    }
+    tallest_.set(person, tallest);
+    shortest_.set(person, shortest);
+    return true;
+}
+
+/**
+* @brief: Computes the tallest and shortest person in every lineage. Persons are
+*         handled once all their children are, so shared descendants are visited once.
+*/
+void Familytree::computeExtremes() {
+    vector<PersonIndex> everyone(heights_.size());
+    for (PersonIndex person = 0; person < everyone.size(); ++person) {
+        everyone[person] = person;
+    }
+    tallest_.assign(everyone);
+    shortest_.assign(everyone);
+
+    // Number of children not handled yet.
+    vector<uint32_t> remaining(heights_.size(), 0);
+    vector<PersonIndex> ready;
+    for (PersonIndex person = 0; person < heights_.size(); ++person) {
+        forEachChild(person, [&remaining, person](PersonIndex) {
+            ++remaining[person];
+        });
+        if (remaining[person] == 0) {
+            ready.push_back(person);
+        }
+    }
+
+    while (!ready.empty()) {
+        PersonIndex person = ready.back();
+        ready.pop_back();
+        foldExtremes(person);
+        for (int slot = 0; slot < 2; ++slot) {
+            if (isListed(parents_[person], slot) && --remaining[parents_[person][slot]] == 0) {
+                ready.push_back(parents_[person][slot]);
+            }
+        }
+    }
+
+    // Persons in a cycle of relations never got ready, they get what their
+    // children have so far.
+    for (PersonIndex person = 0; person < heights_.size(); ++person) {
+        if (remaining[person] > 0) {
+            foldExtremes(person);
+        }
+    }
+}
+
+/**
+* @brief: Updates the tallest and shortest person in the lineages of the changed persons and
+*         their ancestors. An ancestor is revisited only when a child's values changed.
+* @param: changed: The persons whose children changed.
+*/
+void Familytree::updateExtremes(vector<PersonIndex> changed) {
+    // Guard against cycles of relations, every change moves the values one
+    // way so a bounded number of rounds is enough for any real tree.
+    size_t rounds_left = 4 * heights_.size() + changed.size();
+    while (!changed.empty() && rounds_left-- > 0) {
+        PersonIndex person = changed.back();
+        changed.pop_back();
+        if (foldExtremes(person)) {
+            for (int slot = 0; slot < 2; ++slot) {
+                if (isListed(parents_[person], slot)) {
+                    changed.push_back(parents_[person][slot]);
+                }
+            }
+        }
+    }
+}
+
+/**
+* @brief: Saves the family tree to a binary snapshot file.
+* @param: A list where params[0] is the file name.
+* @param: output (The stream to print the result).
+*/
+void Familytree::saveSnapshot(Params params, ostream& output) const {
+    if (Snapshot::save(*this, string(params.at(0)))) {
+        output << "Saved " << size() << " persons to " << params.at(0) << "." << '\n';
+    } else {
+        output << "Error. Could not write " << params.at(0) << "." << '\n';
+    }
+}
+
+/**
+* @brief: Writes the tree as a datafile, one line per person in index order,
+* so that loading it gives every person the same index. The file replaces
+* path only when complete.
+* @param: path
+* Returns true if the file was written.
+*/
+bool Familytree::saveDatafile(const string& path) const {
+    // Quote the ids the loader would otherwise split or skip.
+    auto writeId = [](ostream& file, string_view id) {
+        if (id.find(';') != string_view::npos or id.front() == '#') {
+            file << '"' << id << '"';
+        } else {
+            file << id;
+        }
+    };
+
+    string temporary_path = path + ".tmp." + to_string(getpid());
+    ofstream file(temporary_path, ios::binary | ios::trunc);
+    for (PersonIndex person = 0; person < size(); ++person) {
+        // The loader refuses an empty id and reads "-" as a missing parent,
+        // so such a tree isn't saved at all. ADD doesn't create them.
+        string_view id = idOf(person);
+        if (id.empty() or id == "-") {
+            file.close();
+            remove(temporary_path.c_str());
+            return false;
+        }
+        writeId(file, id);
+        file << ';' << heights_[person];
+        for (PersonIndex parent : parents_[person]) {
+            file << ';';
+            if (parent == NO_PERSON) {
+                file << '-';
+            } else {
+                writeId(file, idOf(parent));
+            }
+        }
+        file << '\n';
+    }
+    file.close();
+    if (not file or rename(temporary_path.c_str(), path.c_str()) != 0) {
+        remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+* @brief: Adds a new person without parents.
+* @param: A list where params[0] is the person's name and params[1] the height.
+* @param: output (The stream to print the result).
+* Returns true if the person was added.
+*/
+bool Familytree::addPerson(Params params, ostream& output) {
+    // "-" stands for a missing parent, like in the datafile.
+    if (params.at(0).empty() || params.at(0) == "-") {
+        output << WRONG_ID << '\n';
+        return false;
+    }
+    size_t persons = size();
+    addNewPerson(params.at(0), params.number(1), output);
+    if (size() == persons) {
+        return false;
+    }
+    output << "Added " << params.at(0) << "." << '\n';
+    return true;
+}
+
+/**
+* @brief: Sets the parents of a person.
+* @param: A list where params[0] is the child's name, params[1] the father's and params[2] the mother's.
+* "-" as a parent keeps the parent as it is.
+* @param: output (The stream to print the result).
+* Returns true if the parents were set.
+*/
+bool Familytree::addParents(Params params, ostream& output) {
+    // Every person must exist before anything is changed.
+    PersonIndex child = getIndex(params.at(0));
+    if (child == NO_PERSON) {
+        printNotFound(params.at(0), output);
+        return false;
+    }
+    ParentPair parents{NO_PERSON, NO_PERSON};
+    for (size_t i = 1; i < params.size() && i <= parents.size(); ++i) {
+        if (params.at(i) == "-") {
+            continue;
+        }
+        parents[i - 1] = getIndex(params.at(i));
+        if (parents[i - 1] == NO_PERSON) {
+            printNotFound(params.at(i), output);
+            return false;
+        }
+        if (parents[i - 1] == child) {
+            output << OWN_PARENT << '\n';
+            return false;
+        }
+        // The queries rely on there being no cycles of relations.
+        if (descendsFrom(parents[i - 1], child)) {
+            output << OWN_ANCESTOR << '\n';
+            return false;
+        }
+    }
+
+    changed_.push_back(child);
+    for (int slot = 0; slot < 2; ++slot) {
+        if (parents[slot] != NO_PERSON) {
+            changed_.push_back(parents_[child][slot]);
+            changed_.push_back(parents[slot]);
+        }
+    }
+    addRelation(child, parents);
+    output << "Set the parents of " << params.at(0) << "." << '\n';
+    return true;
+}
+
+/**
+* @brief: Returns the persons whose relations the commands have changed since clearChanges.
+* Parents removed or set are included, NO_PERSON stands for a missing parent.
 */
-void Familytree::addNewPerson(const string& id, int height, ostream &output) {
-    // Check if the person is already in the tree using the getPointer function.
-    if (getPointer(id) != nullptr) {
-        output << ALREADY_ADDED << endl; // If already added, print error and return.
-        return;
-    }
+const vector<PersonIndex>& Familytree::changes() const {
+    return changed_;
+}
+
+/**
+* @brief: Forgets the persons whose relations have changed so far.
+*/
+void Familytree::clearChanges() {
+    changed_.clear();
+}
 
-    // Create a new person and assign the provided id and height.
-    Person* new_person = new Person;
-    new_person->id_ = id;
-    new_person->height_ = height;
+//UTILITY FUNCTIONS BELOW
 
-    // Add the new person to the family tree (vector of persons).
-    persons_.push_back(new_person);
+/**
+* @brief: Returns the number of persons in the family tree.
+*/
+size_t Familytree::size() const {
+    return heights_.size();
 }
 
 /**
-* @brief: This function establishes a parent-child relationship between people in the family tree.
-* @param child_id: The name of the child.
-* @param parents: A list of parent names (up to two).
-* @param output (A stream to print out errors if needed).
+* @brief: Searches for a person in the family tree by their ID.
+* @param: id which is The person's name/ID.
+* Returns the index of the person if found, or NO_PERSON if not found.
 */
-void Familytree::addRelation(const string& child_id, const vector<string>& parents, ostream& output) {
-    // Look for the child in the family tree.
-    Person* child = getPointer(child_id);
+PersonIndex Familytree::getIndex(string_view id) const {
+    if (id_table_.empty()) {
+        return NO_PERSON;
+    }
+    return findId(id, hashId(id));
+}
 
-    // If the child doesn't exist, print an error and return.
-    if (child == nullptr) {
-        printNotFound(child_id, output);
+/**
+* @brief: Looks up many ids at once.
+* @param: ids
+* @param: indexes: Set to the index of every id, NO_PERSON for unknown ones.
+* The slots are far apart in a big table, so each lookup waits for memory.
+* The hashes are computed first, and the slot of the id LOOKUP_AHEAD places
+* later is prefetched before an id is looked up, so the waits overlap.
+*/
+void Familytree::getIndexes(const vector<string_view>& ids, vector<PersonIndex>& indexes) const {
+    indexes.assign(ids.size(), NO_PERSON);
+    if (id_table_.empty()) {
         return;
     }
-
-    // Loop through the parents and connect them to the child.
-    for (size_t i = 0; i < parents.size(); ++i) {
-        if (parents[i] != "-") { // If parent is valid (not "-").
-            // Find the parent in the family tree.
-            Person* parent = getPointer(parents[i]);
-            if (parent != nullptr) {
-                // Assign the parent to the child's parent list.
-                child->parents_.at(i) = parent;
-                // Add the child to the parent's list of children.
-                parent->children_.push_back(child);
-            }
+    thread_local vector<uint32_t> hashes;
+    hashes.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        hashes[i] = hashId(ids[i]);
+    }
+    size_t mask = id_table_.size() - 1;
+    for (size_t i = 0; i < ids.size(); ++i) {
+#if defined(__GNUC__)
+        if (i + LOOKUP_AHEAD < ids.size()) {
+            __builtin_prefetch(&id_table_[hashes[i + LOOKUP_AHEAD] & mask]);
         }
+#endif
+        indexes[i] = findId(ids[i], hashes[i]);
     }
 }
 
 /**
-* @brief:Prints all the people in the family tree in alphabetical order by their ID.
-* @param output (The stream where the list of people is printed).
- */
-void Familytree::printPersons(Params, ostream& output) const {
-    // Sort the people by their IDs in alphabetical order.
-    vector<Person*> sorted_persons = persons_;
-    sort(sorted_persons.begin(), sorted_persons.end(),
-        [](Person* a, Person* b) {
-            return a->id_ < b->id_;
-        });
-
-    // Print each person's ID and height.
-    for (const auto& person : sorted_persons) {
-        output << person->id_ << ", " << person->height_ << endl;
+* @brief: Finds the person with an id from the id table.
+* @param: id
+* @param: hash: hashId of the id.
+* Returns the index of the person, or NO_PERSON if there is none.
+*/
+PersonIndex Familytree::findId(string_view id, uint32_t hash) const {
+    // Linear probing from the hashed slot until the id or an empty slot.
+    size_t mask = id_table_.size() - 1;
+    for (size_t slot = hash & mask; id_table_[slot].person_ != NO_PERSON; slot = (slot + 1) & mask) {
+        if (id_table_[slot].hash_ == hash && idOf(id_table_[slot].person_) == id) {
+            return id_table_[slot].person_;
+        }
     }
+    return NO_PERSON;
 }
 
 /**
-* @brief: Prints all children of a given person in the family tree.
-* @param A list where params[0] is the person's name.
-* @param output (The stream to print the list of children).
+* @brief: Returns the ID of a person.
+* @param: person: The index of the person.
+* Returns a view to the ID inside id_chars_, valid until the next addNewPerson.
 */
-void Familytree::printChildren(Params params, ostream& output) const {
-    // Find the person using their name (ID).
-    Person* person = getPointer(params.at(0));
-    if (person == nullptr) {
-        printNotFound(params.at(0), output); // If not found, print error and return.
-        return;
-    }
+string_view Familytree::idOf(PersonIndex person) const {
+    return string_view(id_chars_.data() + id_offsets_[person],
+                       id_offsets_[person + 1] - id_offsets_[person]);
+}
 
-    // Check if the person has children.
-    if (person->children_.empty()) {
-        output << person->id_ << " has no children." << endl;
-    } else {
-        // Convert the list of children to a set of their IDs and print them.
-        IdSet children_set = vectorToIdSet(person->children_);
-        printGroup(person->id_, "children", children_set, output);
-    }
+/**
+* @brief: Tells how much memory the IDs take.
+* Returns the bytes of the ID characters, their offsets and the ID hash table.
+*/
+size_t Familytree::idBytes() const {
+    return id_chars_.size() * sizeof(char) + id_offsets_.size() * sizeof(uint32_t)
+           + id_table_.size() * sizeof(IdSlot);
 }
 
 /**
-* @brief: Prints all parents of a given person in the family tree.
-* @param A list where params[0] is the person's name.
-* @param output (The stream to print the list of parents).
+* @brief: Adds a person to the ID hash table. Doubles the table and
+*         reinserts everybody when it would become more than half full.
+* @param: new_slot: The index of the person and the hash of the ID.
 */
-void Familytree::printParents(Params params, ostream& output) const {
-    // Find the person using their name (ID).
-    Person* person = getPointer(params.at(0));
-    if (person == nullptr) {
-        printNotFound(params.at(0), output); // If not found, print error and return.
-        return;
+void Familytree::insertToIdTable(const IdSlot& new_slot) {
+    if (2 * heights_.size() > id_table_.size()) {
+        growIdTable(max(MIN_ID_TABLE_SIZE, 2 * id_table_.size()));
     }
-
-    // Get the person's parents and print them.
-    vector<Person*> parents = person->parents_;
-    IdSet parents_set = vectorToIdSet(parents);
-    if (parents_set.empty()) {
-        output << person->id_ << " has no parents." << endl;
-    } else {
-        printGroup(person->id_, "parents", parents_set, output);
+    size_t mask = id_table_.size() - 1;
+    size_t slot = new_slot.hash_ & mask;
+    while (id_table_[slot].person_ != NO_PERSON) {
+        slot = (slot + 1) & mask;
     }
+    id_table_.set(slot, new_slot);
 }
 
 /**
-* @brief: Prints all siblings of a given person in the family tree.
-* @param: A list where params[0] is the person's name.
-* @param output (The stream to print the list of siblings).
+* @brief: Reinserts everybody into a new ID hash table.
+* @param: size: The number of slots of the new table, a power of two.
 */
-void Familytree::printSiblings(Params params, ostream& output) const {
-    // Find the person using their name (ID).
-    Person* person = getPointer(params.at(0));
-    if (person == nullptr) {
-        printNotFound(params.at(0), output); // If not found, print error and return.
-        return;
-    }
-
-    // Find siblings by looking at the parents' other children.
-    IdSet sibling_set;
-    for (Person* parent : person->parents_) {
-        if (parent != nullptr) {
-            for (Person* sibling : parent->children_) {
-                if (sibling->id_ != person->id_) {
-                    sibling_set.insert(sibling->id_);
+void Familytree::growIdTable(size_t size) {
+    vector<IdSlot> table(size);
+    size_t mask = size - 1;
+    id_table_.forEachChunk([&table, mask](const IdSlot* slots, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (slots[i].person_ != NO_PERSON) {
+                size_t slot = slots[i].hash_ & mask;
+                while (table[slot].person_ != NO_PERSON) {
+                    slot = (slot + 1) & mask;
                 }
+                table[slot] = slots[i];
             }
         }
+    });
+    id_table_.assign(table);
+}
+
+/**
+* @brief: Assigns the parent to the child's parent slot.
+* @param: child: The index of the child.
+* @param: slot: 0 for the first parent, 1 for the second.
+* @param: parent: The index of the parent.
+*/
+void Familytree::setParent(PersonIndex child, int slot, PersonIndex parent) {
+    ParentPair before = parents_[child];
+    ParentPair after = before;
+    after[slot] = parent;
+
+    // Take the child out of the lists it leaves, assign the parent to the
+    // slot and add the child to the lists it joins. The list of a parent
+    // that stays keeps its order.
+    for (int s = 0; s < 2; ++s) {
+        if (isListed(before, s) && (before[s] != after[s] || !isListed(after, s))) {
+            unlinkChild(child, s);
+        }
+    }
+    parents_.set(child, after);
+    for (int s = 0; s < 2; ++s) {
+        if (isListed(after, s) && (before[s] != after[s] || !isListed(before, s))) {
+            linkChild(child, s);
+        }
+    }
+    for (int s = 0; s < 2; ++s) {
+        if (before[s] != after[s]) {
+            updateAncestorIndex(child, before[s], after[s]);
+        }
     }
 
-    // Print the siblings, or show that none exist.
-    if (sibling_set.empty()) {
-        output << person->id_ << " has no siblings." << endl;
-    } else {
-        printGroup(person->id_, "siblings", sibling_set, output);
+    // The lineages of the old and the new parents changed.
+    if (extremes_deferred_) {
+        return;
+    }
+    vector<PersonIndex> changed;
+    for (const ParentPair& parents : {before, after}) {
+        for (PersonIndex changed_parent : parents) {
+            if (changed_parent != NO_PERSON) {
+                changed.push_back(changed_parent);
+            }
+        }
     }
+    updateExtremes(changed);
 }
 
 /**
-* @brief: Prints all cousins of a given person in the family tree.
-* @param: A list where params[0] is the person's name.
-* @param: output (The stream to print the list of cousins).
+* @brief: Appends the child to the end of the children list of the parent in the slot.
+*         A list that doesn't end the shared list is first copied to its end.
+* @param: child: The index of the child.
+* @param: slot: 0 for the first parent, 1 for the second.
 */
-void Familytree::printCousins(Params params, ostream& output) const {
-    // Find the person using their name (ID).
-    Person* person = getPointer(params.at(0));
-    if (person == nullptr) {
-        printNotFound(params.at(0), output); // If not found, print error and return.
-        return;
+void Familytree::linkChild(PersonIndex child, int slot) {
+    PersonIndex parent = parents_[child][slot];
+    uint32_t begin = child_begin_[parent];
+    uint32_t end = child_end_[parent];
+    if (end != child_list_.size()) {
+        uint32_t moved = static_cast<uint32_t>(child_list_.size());
+        child_list_.append(child_list_.data() + begin, end - begin);
+        begin = moved;
     }
+    child_list_.push_back(child);
+    child_begin_.set(parent, begin);
+    child_end_.set(parent, static_cast<uint32_t>(child_list_.size()));
+    ++listed_children_;
+    children_packed_ = false;
+}
 
-    // Find cousins by checking parents' siblings' children.
-    IdSet cousin_set;
-    for (Person* parent : person->parents_) {
-        if (parent != nullptr) {
-            for (Person* grandparent : parent->parents_) {
-                if (grandparent != nullptr) {
-                    for (Person* uncle_aunt : grandparent->children_) {
-                        if (uncle_aunt->id_ != parent->id_) {
-                            for (Person* cousin : uncle_aunt->children_) {
-                                cousin_set.insert(cousin->id_);
-                            }
-                        }
-                    }
-                }
-            }
+/**
+* @brief: Removes the child from the children list of the parent in the slot. The
+*         rest of the list is copied to the end of the shared list, since the places
+*         of the list may be shared with the versions before.
+* @param: child: The index of the child.
+* @param: slot: 0 for the first parent, 1 for the second.
+*/
+void Familytree::unlinkChild(PersonIndex child, int slot) {
+    PersonIndex parent = parents_[child][slot];
+    uint32_t begin = static_cast<uint32_t>(child_list_.size());
+    for (uint32_t i = child_begin_[parent]; i < child_end_[parent]; ++i) {
+        if (child_list_[i] != child) {
+            child_list_.push_back(child_list_[i]);
         }
     }
+    child_begin_.set(parent, begin);
+    child_end_.set(parent, static_cast<uint32_t>(child_list_.size()));
+    --listed_children_;
+    children_packed_ = false;
+}
 
-    // Print the cousins, or show that none exist.
-    if (cousin_set.empty()) {
-        output << person->id_ << " has no cousins." << endl;
-    } else {
-        printGroup(person->id_, "cousins", cousin_set, output);
-    }
+/**
+* @brief: Prints an error message if the person with the given ID is not found.
+* @param: id: The person's ID that couldn't be found.
+* @param: output (The stream to print the result).
+*/
+void Familytree::printNotFound(string_view id, ostream& output) const {
+    output << "Error. " << id << " not found." << '\n';
 }
 
 /**
-* @brief: Prints the grandchildren of a person up to a given level (generation).
-* @param: A list where params[0] is the person's name and params[1] is the level.
-* @param: output (The stream to print the list of grandchildren).
+* @brief: Prints the persons N + 1 generations above or below a person.
+* @param: A list where params[0] is the person's name and params[1] is the level N.
+* @param: direction: UP for grandparents, DOWN for grandchildren.
+* @param: group: "grandparents" or "grandchildren", prefixed with N - 1 "great-".
+* @param: output (The stream to print the result).
 */
-void Familytree::printGrandChildrenN(Params params, ostream& output) const {
+void Familytree::printGeneration(Params params, Direction direction,
+                                 const string& group, ostream& output) const {
     // Check if two parameters are provided.
     if (params.size() != 2) {
-        output << "Wrong amount of parameters." << endl;
+        output << "Wrong amount of parameters." << '\n';
         return;
     }
 
-    const std::string& id = params.at(0);
-    int generationLevel = std::stoi(params.at(1));
+    string_view id = params.at(0);
+    int N = params.number(1);
 
     // Error for invalid level.
-    if (generationLevel < 1) {
-        output << "Error. Level can't be less than 1." << endl;
+    if (N < 1) {
+        output << WRONG_LEVEL << '\n';
+        return;
+    }
+    // The label alone would grow with the level.
+    if (N > MAX_LEVEL) {
+        output << TOO_HIGH_LEVEL << '\n';
         return;
     }
 
     // Find the person using their name (ID).
-    Person* person = getPointer(id);
-    if (person == nullptr) {
+    PersonIndex person = getIndex(id);
+    if (person == NO_PERSON) {
         printNotFound(id, output);
         return;
     }
 
-    IdSet grandchildren_ids;
+    string label;
+    for (int i = 1; i < N; ++i) {
+        label += "great-";
+    }
+    label += group;
 
-    // Handle level 1 (direct grandchildren).
-    if (generationLevel == 1) {
-        for (Person* child : person->children_) {
-            for (Person* grandchild : child->children_) {
-                grandchildren_ids.insert(grandchild->id_);
-            }
-        }
+    // Level N is N + 1 steps away, grandparents being two steps up.
+    unsigned int distance = static_cast<unsigned int>(N) + 1;
+    vector<PersonIndex>& found = groupBuffer();
+    generation(person, distance, direction, found);
+    printGroup(id, label, found, output);
+}
 
-        // Print the grandchildren or show that none exist.
-        if (!grandchildren_ids.empty()) {
-            output << id << " has " << grandchildren_ids.size() << " grandchildren:" << endl;
-            for (const auto& grandchild_id : grandchildren_ids) {
-                output << grandchild_id << endl;
-            }
-        } else {
-            output << id << " has no grandchildren." << endl;
-        }
+/**
+* @brief: Finds the persons exactly the given number of steps above or below a person.
+* @param: person: The index of the person to start from.
+* @param: distance: Number of parent (UP) or child (DOWN) steps.
+* @param: direction: Which way to walk.
+* @param: found: Filled with each person at that distance once, in no particular order.
+* The walk goes one level at a time. Every level is deduplicated with a
+* bitmap, so a person reached along several paths, e.g. a shared ancestor,
+* is expanded only once per level. A person can still be on several levels,
+* the same as with a walk along every path.
+*/
+void Familytree::generation(PersonIndex person, unsigned int distance,
+                            Direction direction, vector<PersonIndex>& found) const {
+    // One bit per person, all clear between calls. Only the set bits are
+    // cleared after each level, so a small walk doesn't touch the whole map.
+    thread_local vector<uint64_t> marked;
+    if (marked.size() < size() / 64 + 1) {
+        marked.resize(size() / 64 + 1, 0);
     }
-    // Handle level 2 (great-grandchildren).
-    else if (generationLevel == 2) {
-        for (Person* child : person->children_) {
-            for (Person* grandchild : child->children_) {
-                for (Person* greatGrandchild : grandchild->children_) {
-                    grandchildren_ids.insert(greatGrandchild->id_);
-                }
-            }
+    auto mark = [](PersonIndex p) {
+        uint64_t bit = uint64_t(1) << (p % 64);
+        bool was_marked = marked[p / 64] & bit;
+        marked[p / 64] |= bit;
+        return !was_marked;
+    };
+    auto isMarked = [](PersonIndex p) {
+        return p != NO_PERSON && (marked[p / 64] >> (p % 64) & 1);
+    };
+    auto unmark = [](const vector<PersonIndex>& persons) {
+        for (PersonIndex p : persons) {
+            marked[p / 64] = 0;
         }
+    };
 
-        // Print the great-grandchildren or show that none exist.
-        if (!grandchildren_ids.empty()) {
-            output << id << " has " << grandchildren_ids.size() << " great-grandchildren:" << endl;
-            for (const auto& greatGrandchild_id : grandchildren_ids) {
-                output << greatGrandchild_id << endl;
+    // The levels are kept between calls too.
+    thread_local vector<PersonIndex> frontier;
+    thread_local vector<PersonIndex> next;
+    frontier.assign(1, person);
+    for (unsigned int level = 0; level < distance && !frontier.empty(); ++level) {
+        next.clear();
+        if (direction == Direction::UP) {
+            for (PersonIndex current : frontier) {
+                for (PersonIndex parent : parents_[current]) {
+                    if (parent != NO_PERSON && mark(parent)) {
+                        next.push_back(parent);
+                    }
+                }
+            }
+            unmark(next);
+        } else if (frontier.size() > size() / DENSE_FRONTIER_SHARE) {
+            // A wide frontier is cheaper to expand bottom up: one pass over
+            // the parents column in index order instead of jumping to the
+            // children of every frontier person.
+            for (PersonIndex current : frontier) {
+                mark(current);
+            }
+            for (PersonIndex child = 0; child < size(); ++child) {
+                const ParentPair& parents = parents_[child];
+                if (isMarked(parents[0]) || isMarked(parents[1])) {
+                    next.push_back(child);
+                }
             }
+            unmark(frontier);
         } else {
-            output << id << " has no great-grandchildren." << endl;
-        }
-    }
-    // Handle levels greater than 2.
-    else {
-        if (grandchildren_ids.empty()) {
-            output << id << " has no ";
-            for (int i = 2; i <= generationLevel; ++i) {
-                output << "great-";
+            for (PersonIndex current : frontier) {
+                forEachChild(current, [&](PersonIndex child) {
+                    if (mark(child)) {
+                        next.push_back(child);
+                    }
+                });
             }
-            output << "grandchildren." << endl;
+            unmark(next);
         }
+        STATS_VISITED(next.size());
+        frontier.swap(next);
     }
+    found.assign(frontier.begin(), frontier.end());
 }
 
 /**
-* @brief: Prints all the grandparents of a person up to a given generation.
-* @param: A list where params[0] is the person's name and params[1] is the level.
-* @param: output (The stream to print the list of grandparents).
+* @brief: Finds the persons a few parent or child steps away from some persons.
+* @param: persons: The persons to start from, NO_PERSON is skipped.
+* @param: radius: The most steps taken.
+* @param: limit: The most persons found.
+* @param: nearby: Filled with the persons found and their fewest steps, the start ones too.
+* Returns false if there were more than limit persons, nearby then being incomplete.
 */
-void Familytree::printGrandParentsN(Params params, std::ostream& output) const {
-    // Check if two parameters are provided.
-    if (params.size() != 2) {
-        output << "Wrong amount of parameters." << endl;
-        return;
-    }
-
-    const std::string& id = params.at(0);
-    int N = std::stoi(params.at(1));
-
-    // Error for invalid level.
-    if (N < 1) {
-        output << "Error. Level can't be less than 1." << endl;
-        return;
+bool Familytree::nearbyPersons(const vector<PersonIndex>& persons, unsigned int radius, size_t limit,
+                               vector<pair<PersonIndex, unsigned int>>& nearby) const {
+    thread_local PersonSet seen;
+    seen.resize(size());
+    nearby.clear();
+    for (PersonIndex person : persons) {
+        if (person != NO_PERSON && seen.insert(person)) {
+            nearby.push_back({person, 0});
+        }
     }
 
-    // Find the person using their name (ID).
-    Person* person = getPointer(id);
-    if (person == nullptr) {
-        printNotFound(id, output);
-        return;
+    // Breadth first, nearby being the queue.
+    bool complete = true;
+    auto visit = [&](PersonIndex relative, unsigned int steps) {
+        if (relative != NO_PERSON && seen.insert(relative)) {
+            nearby.push_back({relative, steps});
+            complete = nearby.size() <= limit;
+        }
+    };
+    for (size_t i = 0; i < nearby.size() && complete; ++i) {
+        auto [person, steps] = nearby[i];
+        if (steps == radius) {
+            break;
+        }
+        for (PersonIndex parent : parents_[person]) {
+            visit(parent, steps + 1);
+        }
+        forEachChild(person, [&](PersonIndex child) {
+            visit(child, steps + 1);
+        });
     }
+    seen.clear();
+    return complete;
+}
 
-    // Use a queue to perform a breadth-first search for grandparents up to level N.
-    std::queue<std::pair<Person*, int>> queue;
-    queue.push({person, 0});
-    IdSet grandparents;
-
-    while (!queue.empty()) {
-        Person* current = queue.front().first;
-        int depth = queue.front().second;
-        queue.pop();
-
-        if (depth == N) {
-            grandparents.merge(vectorToIdSet(current->parents_));
-        } else if (depth < N) {
-            for (Person* parent : current->parents_) {
-                if (parent != nullptr) {
-                    queue.push({parent, depth + 1});
+/**
+* @brief: Finds everyone in a person's lineage, or everyone in their ancestry.
+* @param: person: The index of the person.
+* @param: direction: DOWN for the descendants, UP for the ancestors.
+* @param: members: Filled with the person and each descendant or ancestor once, level by level.
+*/
+void Familytree::lineage(PersonIndex person, Direction direction, vector<PersonIndex>& members) const {
+    // Kept between calls and cleared after each, like the sets of cousins().
+    thread_local PersonSet reached;
+    reached.resize(size());
+    reached.insert(person);
+    members.assign(1, person);
+    auto reach = [&members](PersonIndex relative) {
+        if (reached.insert(relative)) {
+            members.push_back(relative);
+        }
+    };
+    for (size_t i = 0; i < members.size(); ++i) {
+        PersonIndex current = members[i];
+        if (direction == Direction::UP) {
+            for (PersonIndex parent : parents_[current]) {
+                if (parent != NO_PERSON) {
+                    reach(parent);
                 }
             }
+        } else {
+            forEachChild(current, reach);
         }
     }
+    STATS_VISITED(members.size());
+    reached.clear();
+}
 
-    // Print the grandparents or show that none exist.
-    if (!grandparents.empty()) {
-        output << id << " has " << grandparents.size();
-        if (N == 1) {
-            output << " grandparents:" << endl;
-        } else {
-            output << " great-";
-            for (int i = 2; i < N; ++i) {
-                output << "great-";
-            }
-            output << "grandparents:" << endl;
-        }
+/**
+* @brief: Tells if a person descends from another, without building the ancestor index.
+* @param: person: The index of the person.
+* @param: ancestor: The index of the possible ancestor.
+* The index of the version is used if a reader has built it, or if it was
+* patched from the index of the version before. Otherwise the walk goes up from
+* the person and down from the ancestor a person at a time by turns, and
+* stops when either side is done. Either side alone gives the answer, so
+* this costs at most twice the smaller side: a new person has no
+* descendants, an early one few ancestors.
+*/
+bool Familytree::descendsFrom(PersonIndex person, PersonIndex ancestor) const {
+    shared_ptr<const AncestorIndex> index = atomic_load(&ancestor_index_.index_);
+    if (index != nullptr) {
+        return index->isAncestor(ancestor, person);
+    }
 
-        for (const auto& grandparent_id : grandparents) {
-            output << grandparent_id << endl;
+    // Kept between calls and cleared after each, like the sets of cousins().
+    thread_local PersonSet reached[2];
+    thread_local vector<PersonIndex> queue[2];
+    const PersonIndex start[2] = {person, ancestor};
+    const PersonIndex target[2] = {ancestor, person};
+    size_t next[2] = {0, 0};
+    for (int side = 0; side < 2; ++side) {
+        reached[side].resize(size());
+        reached[side].insert(start[side]);
+        queue[side].assign(1, start[side]);
+    }
+    int found = -1;
+    for (int side = 0; found < 0; side = 1 - side) {
+        if (next[side] == queue[side].size()) {
+            found = 0;
+            break;
         }
-    } else {
-        output << id << " has no ";
-        if (N == 1) {
-            output << "grandparents." << endl;
-        } else {
-            output << "great-";
-            for (int i = 2; i < N; ++i) {
-                output << "great-";
+        auto reach = [&](PersonIndex relative) {
+            if (relative == target[side]) {
+                found = 1;
+            } else if (reached[side].insert(relative)) {
+                queue[side].push_back(relative);
+            }
+        };
+        PersonIndex current = queue[side][next[side]++];
+        if (side == 0) {
+            for (PersonIndex parent : parents_[current]) {
+                if (parent != NO_PERSON) {
+                    reach(parent);
+                }
             }
-            output << "grandparents." << endl;
+        } else {
+            forEachChild(current, reach);
         }
     }
+    reached[0].clear();
+    reached[1].clear();
+    return found == 1;
 }
 
 /**
-* @brief: Finds and prints the tallest person in a given person's lineage.
-* @param: A list where params[0] is the person's name.
-* @param: output (The stream to print the result).
+* @brief: Finds the n-th cousins k times removed of a person.
+* @param: person: The index of the person.
+* @param: degree: n, 1 for first cousins.
+* @param: removed: k, the number of generations between the person and the cousins.
+* @param: found: Filled with each cousin once, in no particular order.
+* The cousins removed downwards are reached from the ancestors n + 1 steps up, taking
+* n + 1 + k steps down, and those removed upwards from the ancestors n + 1 + k steps up,
+* taking n + 1 steps down. The first step down leaves out the person's own line, and the
+* person and its ancestors are left out of the result. Every level is a PersonSet, so
+* the levels are combined a word at a time and a person is expanded once per level.
+* Gives nobody for n + k of at least the number of persons.
 */
-void Familytree::printTallestInLineage(Params params, ostream& output) const {
-    // Find the person using their name (ID).
-    Person* person = getPointer(params.at(0));
-    if (person == nullptr) {
-        printNotFound(params.at(0), output); // If not found, print error and return.
+void Familytree::cousins(PersonIndex person, unsigned int degree,
+                         unsigned int removed, vector<PersonIndex>& found) const {
+    // Without cycles of relations nobody is as many steps away as there are persons.
+    found.clear();
+    if (degree + removed >= size()) {
         return;
     }
 
-    // Find the tallest person in their lineage.
-    Person* tallest = findTallest(person);
-    if (tallest != nullptr) {
-        if (tallest == person) {
-            // Print if the person themselves is the tallest.
-            output << "With the height of " << tallest->height_ << ", "
-                   << tallest->id_ << " is the tallest person in his/her lineage." << endl;
-        } else {
-            // Print if someone else in the lineage is taller.
-            output << "With the height of " << tallest->height_ << ", "
-                   << tallest->id_ << " is the tallest person in "
-                   << person->id_ << "'s lineage." << endl;
-        }
+    // Kept between calls and cleared after each, like the bitmap of generation().
+    thread_local vector<PersonSet> sets(10);
+    for (PersonSet& set : sets) {
+        set.resize(size());
     }
-}
+    PersonSet& line = sets[0];
+    PersonSet& level = sets[1];
+    PersonSet& above = sets[2];
+    PersonSet& frontier = sets[7];
+    PersonSet& next = sets[8];
+    PersonSet& reached = sets[9];
 
-/**
-* @brief: This is helper function to find the tallest person in a person's lineage used in previous fucntion
-* @param: A pointer to the person to start searching from.
-* Returns a pointer to the tallest person found.
-*/
-Person* findTallest(Person* p) {
-    if (!p) return nullptr;
+    // The levels the walks down start from and leave out, sets[3 + i] is
+    // the level wanted[i] steps up.
+    const unsigned int wanted[] = {degree, degree + 1, degree + removed, degree + 1 + removed};
+    unsigned int top = wanted[3];
+    level.insert(person);
+    for (unsigned int steps = 0; !level.empty(); ++steps) {
+        line.unite(level);
+        for (int i = 0; i < 4; ++i) {
+            if (wanted[i] == steps) {
+                sets[3 + i].unite(level);
+            }
+        }
+        if (steps == top) {
+            break;
+        }
+        level.forEach([&](PersonIndex current) {
+            for (PersonIndex parent : parents_[current]) {
+                if (parent != NO_PERSON) {
+                    above.insert(parent);
+                }
+            }
+        });
+        STATS_VISITED(above.count());
+        level.clear();
+        swap(level, above);
+    }
 
-    Person* tallest = p;
-    for (Person* child : p->children_) {
-        Person* tallest_descendant = findTallest(child);
-        if (tallest_descendant && tallest_descendant->height_ > tallest->height_) {
-            tallest = tallest_descendant;
+    // From the ancestors in start, down the given number of steps, leaving
+    // out the line through the ancestors in own_line on the first step.
+    auto walkDown = [&](const PersonSet& start, const PersonSet& own_line, unsigned int down) {
+        frontier.unite(start);
+        for (unsigned int step = 0; step < down && !frontier.empty(); ++step) {
+            if (frontier.count() > size() / DENSE_FRONTIER_SHARE) {
+                // A sweep over the parents column, as in generation().
+                for (PersonIndex child = 0; child < size(); ++child) {
+                    const ParentPair& parents = parents_[child];
+                    if (frontier.contains(parents[0]) || frontier.contains(parents[1])) {
+                        next.insert(child);
+                    }
+                }
+            } else {
+                frontier.forEach([&](PersonIndex current) {
+                    forEachChild(current, [&](PersonIndex child) {
+                        next.insert(child);
+                    });
+                });
+            }
+            if (step == 0) {
+                next.subtract(own_line);
+            }
+            STATS_VISITED(next.count());
+            frontier.clear();
+            swap(frontier, next);
         }
+        reached.unite(frontier);
+        frontier.clear();
+    };
+    walkDown(sets[4], sets[3], degree + 1 + removed);
+    if (removed > 0) {
+        walkDown(sets[6], sets[5], degree + 1);
+    }
+    reached.subtract(line);
+
+    found.reserve(reached.count());
+    reached.forEach([&found](PersonIndex cousin) {
+        found.push_back(cousin);
+    });
+    for (PersonSet& set : sets) {
+        set.clear();
     }
-    return tallest;
 }
 
 /**
-* @brief: Finds and prints the shortest person in a given person's lineage.
-* @param: A list where params[0] is the person's name.
-* @param: output (The stream to print the result).
+* @brief: Finds the closest common ancestors of two persons. Searches breadth first up from
+*         both persons, a level at a time on the side that is behind, until no common
+*         ancestor closer than the ones found can be left. Ancestors that can't share an
+*         ancestor with the other person by the ancestor index are not searched.
+* @param: person
+* @param: relative
+* Returns the ancestors with the fewest steps in total, then the most even steps.
 */
-void Familytree::printShortestInLineage(Params params, ostream& output) const {
-    // Find the person using their name (ID).
-    Person* person = getPointer(params.at(0));
-    if (person == nullptr) {
-        printNotFound(params.at(0), output); // If not found, print error and return.
-        return;
+Familytree::Kinship Familytree::kinship(PersonIndex person, PersonIndex relative) const {
+    Kinship best;
+    shared_ptr<const AncestorIndex> index = ancestorIndex();
+    if (!index->mayShareAncestor(person, relative)) {
+        return best;
     }
 
-    // Find the shortest person in their lineage.
-    Person* shortest = findShortest(person);
-    if (shortest != nullptr) {
-        output << "With the height of " << shortest->height_ << ", "
-               << shortest->id_ << " is the shortest person in his/her lineage." << endl;
+    struct Side {
+        StepMap steps;
+        vector<PersonIndex> frontier;
+        unsigned int radius = 0;
+    };
+    Side sides[2];
+    PersonIndex starts[2] = {person, relative};
+    for (int s = 0; s < 2; ++s) {
+        sides[s].steps.insert(starts[s], 0);
+        sides[s].frontier.push_back(starts[s]);
     }
-}
 
-/**
-* @brief: This is helper function to find the shortest person in a person's lineage used in previous fucntion.
-* @param: A pointer to the person to start searching from.
-* Returns a pointer to the shortest person found.
-*/
-Person* findShortest(Person* p) {
-    if (!p) return nullptr;
+    unsigned int best_total = UINT_MAX;
+    auto consider = [&](PersonIndex ancestor, unsigned int person_steps, unsigned int relative_steps) {
+        unsigned int total = person_steps + relative_steps;
+        unsigned int uneven = max(person_steps, relative_steps) - min(person_steps, relative_steps);
+        unsigned int best_uneven = max(best.person_steps_, best.relative_steps_)
+                                   - min(best.person_steps_, best.relative_steps_);
+        if (total < best_total || (total == best_total && (uneven < best_uneven
+            || (uneven == best_uneven && person_steps < best.person_steps_)))) {
+            best_total = total;
+            best.person_steps_ = person_steps;
+            best.relative_steps_ = relative_steps;
+            best.ancestors_.clear();
+        }
+        if (person_steps == best.person_steps_ && relative_steps == best.relative_steps_) {
+            best.ancestors_.push_back(ancestor);
+        }
+    };
+
+    vector<PersonIndex> next;
+    while (true) {
+        // A common ancestor not found yet is more steps away than the
+        // radius of a side that can still grow.
+        unsigned int bound = UINT_MAX;
+        int grow = -1;
+        for (int s = 0; s < 2; ++s) {
+            if (!sides[s].frontier.empty()) {
+                bound = min(bound, sides[s].radius + 1);
+                if (grow < 0 || sides[s].radius < sides[grow].radius
+                    || (sides[s].radius == sides[grow].radius
+                        && sides[s].frontier.size() < sides[grow].frontier.size())) {
+                    grow = s;
+                }
+            }
+        }
+        if (grow < 0 || bound > best_total) {
+            return best;
+        }
 
-    Person* shortest = p;
-    for (Person* child : p->children_) {
-        Person* shortest_descendant = findShortest(child);
-        if (shortest_descendant && shortest_descendant->height_ < shortest->height_) {
-            shortest = shortest_descendant;
+        Side& side = sides[grow];
+        const Side& other = sides[1 - grow];
+        next.clear();
+        for (PersonIndex current : side.frontier) {
+            for (PersonIndex parent : parents_[current]) {
+                if (parent == NO_PERSON || !index->mayShareAncestor(parent, starts[1 - grow])
+                    || !side.steps.insert(parent, side.radius + 1)) {
+                    continue;
+                }
+                next.push_back(parent);
+                uint32_t other_steps = other.steps.steps(parent);
+                if (other_steps != UINT32_MAX) {
+                    if (grow == 0) {
+                        consider(parent, side.radius + 1, other_steps);
+                    } else {
+                        consider(parent, other_steps, side.radius + 1);
+                    }
+                }
+            }
         }
+        STATS_VISITED(next.size());
+        side.frontier.swap(next);
+        ++side.radius;
     }
-    return shortest;
 }
 
-//UTILITY FUNCTIONS BELOW
-
 /**
-* @brief: Searches for a person in the family tree by their ID.
-* @param: id which is The person's name/ID.
-* Returns a pointer to the person if found, or nullptr if not found.
+* @brief: Returns the ancestor index, building it if the tree changed since the last one.
 */
-Person* Familytree::getPointer(const string& id) const {
-    for (const auto& person : persons_) {
-        if (person->id_ == id) {
-            return person;
-        }
+shared_ptr<const AncestorIndex> Familytree::ancestorIndex() const {
+    // Readers of the same version may build it at the same time, any of
+    // the equal results will do.
+    shared_ptr<const AncestorIndex> index = atomic_load(&ancestor_index_.index_);
+    if (index == nullptr) {
+        index = make_shared<const AncestorIndex>(parents_);
+        atomic_store(&ancestor_index_.index_, index);
     }
-    return nullptr;
+    return index;
 }
 
 /**
-* @brief: Prints an error message if the person with the given ID is not found.
-* @param: id: The person's ID that couldn't be found.
-* @param: output (The stream to print the result).
+* @brief: Patches the ancestor index for a parent the child got, adding the founders of
+*         the parent to the child and its descendants. The walk down stops at the
+*         persons that have the founders already. The index is dropped, to be built
+*         again by the next reader, if the child lost a parent or the index has been
+*         patched too often.
+* @param: child: The index of the child.
+* @param: removed: The parent the child lost, or NO_PERSON.
+* @param: added: The parent the child got, or NO_PERSON.
 */
-void Familytree::printNotFound(const string& id, ostream& output) const {
-    output << "Error. " << id << " not found." << endl;
+void Familytree::updateAncestorIndex(PersonIndex child, PersonIndex removed, PersonIndex added) {
+    shared_ptr<const AncestorIndex> index = atomic_load(&ancestor_index_.index_);
+    if (index == nullptr) {
+        return;
+    }
+    shared_ptr<AncestorIndex> patched = make_shared<AncestorIndex>(*index);
+    if (removed != NO_PERSON || !patched->addRelation(child, added)) {
+        atomic_store(&ancestor_index_.index_, shared_ptr<const AncestorIndex>());
+        return;
+    }
+    uint64_t founders = patched->founders(added);
+    vector<PersonIndex> queue = {child};
+    while (!queue.empty()) {
+        PersonIndex person = queue.back();
+        queue.pop_back();
+        if (patched->addFounders(person, founders)) {
+            forEachChild(person, [&queue](PersonIndex descendant) {
+                queue.push_back(descendant);
+            });
+        }
+    }
+    atomic_store(&ancestor_index_.index_, shared_ptr<const AncestorIndex>(move(patched)));
 }
 
 /**
 * @brief: Function to print a group of people (e.g., children, siblings, etc.)
 * @param: id: The person's name or ID.
 * @param: group: The group being printed (e.g., "children", "siblings").
-* @param: container: A set of person IDs to be printed.
+* @param: members: The persons to be printed, sorted here by their ranks.
 * @param: output (The stream to print the result).
 */
-void Familytree::printGroup(const string& id, const string& group, const IdSet& container, ostream& output) const {
-    // If the container is empty, the person has no members in the specified group.
-    if (container.empty()) {
-        output << id << " has no " << group << "." << endl;
+void Familytree::printGroup(string_view id, const string& group, vector<PersonIndex>& members, ostream& output) const {
+    sortById(members);
+    STATS_RESULTS(members.size());
+    // If there are no members, the person has no members in the specified group.
+    if (members.empty()) {
+        output << id << " has no " << group << "." << '\n';
     } else {
         // Print the number of people in the group and list them.
-        output << id << " has " << container.size() << " " << group << ":" << endl;
-        for (const auto& member : container) {
-            output << member << endl;
+        output << id << " has " << members.size() << " " << group << ":" << '\n';
+        for (PersonIndex member : members) {
+            output << idOf(member) << '\n';
         }
     }
 }
 
 /**
-* @brief: Converts a vector of Person pointers to a set of their IDs.
-* @param: container: A vector of Person pointers.
-* Returns a set of their IDs.
+* @brief: Prints the IDs and heights of persons, one per line.
+* @param: begin: The first person.
+* @param: end: Past the last person.
+* @param: output (The stream to print the result).
 */
-IdSet Familytree::vectorToIdSet(const vector<Person*>& container) const {
-    IdSet id_set;
-    for (const auto& person : container) {
-        if (person != nullptr) {
-            id_set.insert(person->id_);
-        }
+void Familytree::printHeights(const PersonIndex* begin, const PersonIndex* end, ostream& output) const {
+    for (const PersonIndex* person = begin; person != end; ++person) {
+        output << idOf(*person) << ", " << heights_[*person] << '\n';
     }
-    return id_set;
 }
 
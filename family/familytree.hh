@@ -14,31 +14,79 @@
 #ifndef FAMILYTREE_HH
 #define FAMILYTREE_HH
 
+#include "arguments.hh"
+#include "chunkedcolumn.hh"
+#include "column.hh"
+
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
-#include <set>
 #include <iostream>
+#include <memory>
+
+class AncestorIndex;
+class MappedFile;
 
-using Params = const std::vector<std::string>&;
+// Parameters of a command, viewing the command line, the numeric ones
+// parsed.
+using Params = const Arguments&;
 
 // Named constants to improve readability in other modules.
 const std::string NO_ID = "";
 const int NO_HEIGHT = -1;
 
+// Highest level of GRANDCHILDREN and GRANDPARENTS, see TOO_HIGH_LEVEL.
+const int MAX_LEVEL = 1000;
+
 // Error messages
 const std::string ALREADY_ADDED = "Error. Person already added.";
 const std::string WRONG_LEVEL = "Error. Level can't be less than 1.";
+const std::string TOO_HIGH_LEVEL = "Error. Level can't be more than 1000.";
+const std::string OWN_PARENT = "Error. A person can't be their own parent.";
+const std::string OWN_ANCESTOR = "Error. A person can't be a parent of their ancestor.";
+const std::string WRONG_ID = "Error. An id can't be empty or -.";
+const std::string WRONG_COUNT = "Error. Count can't be less than 1.";
 
-// Struct for the persons data.
+// Struct for the persons data read from the datafile.
 struct Person
 {
     std::string id_ = NO_ID;
     int height_ = NO_HEIGHT;
-    std::vector<Person*> parents_{nullptr, nullptr};
-    std::vector<Person*> children_;
 };
 
-using IdSet = std::set<std::string>;
+// Persons are stored in contiguous columns inside Familytree and referred
+// to by their 32-bit index in those columns.
+using PersonIndex = std::uint32_t;
+const PersonIndex NO_PERSON = std::numeric_limits<PersonIndex>::max();
+
+// Two fixed slots, one per parent (father first, mother second).
+using ParentPair = std::array<PersonIndex, 2>;
+
+// Parent-child relation between persons already looked up.
+struct IndexedRelation
+{
+    PersonIndex child_ = NO_PERSON;
+    ParentPair parents_{NO_PERSON, NO_PERSON};
+};
+
+// Slot of the id hash table. The hash of the id is stored next to the
+// index so that probing and growing the table rarely touch the ids.
+struct IdSlot
+{
+    PersonIndex person_ = NO_PERSON;
+    std::uint32_t hash_ = 0;
+};
+
+// Pair of persons asked about with areAncestors.
+struct AncestryPair
+{
+    PersonIndex ancestor_ = NO_PERSON;
+    PersonIndex person_ = NO_PERSON;
+};
 
 /**
  * @brief The Familytree class
@@ -58,7 +106,7 @@ public:
      * @param output
      * Add a new person to the datastructure.
      */
-    void addNewPerson(const std::string& id, int height,
+    void addNewPerson(std::string_view id, int height,
                       std::ostream &output);
 
     /**
@@ -72,10 +120,125 @@ public:
                      const std::vector<std::string>& parents,
                      std::ostream& output);
 
+    /**
+     * @brief addRelation
+     * @param child
+     * @param parents, NO_PERSON leaves the slot as it is
+     * Add a new parent-child relation between persons already looked up
+     * with getIndex.
+     */
+    void addRelation(PersonIndex child, const ParentPair& parents);
+
+    /**
+     * @brief addRelations
+     * @param relations, NO_PERSON parents leave the slots as they are
+     * @param threads used for applying the relations
+     * Add many parent-child relations at once, in the given order, and
+     * freeze the tree. Afterwards every person's children are in index
+     * order.
+     */
+    void addRelations(const std::vector<IndexedRelation>& relations,
+                      unsigned int threads);
+
+    /**
+     * @brief reserve
+     * @param persons
+     * @param id_chars total length of their ids
+     * Reserve room for the given number of persons to be added.
+     */
+    void reserve(std::size_t persons, std::size_t id_chars);
+
+    /**
+     * @brief size
+     * @return number of persons, persons are indexed from 0 to size() - 1
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief idBytes
+     * @return bytes taken by the ids of the persons: the pooled characters,
+     * their offsets and the id hash table
+     */
+    std::size_t idBytes() const;
+
+    /**
+     * @brief getIndex
+     * @param id
+     * @return the index of the person with the given id, or NO_PERSON.
+     * Safe to call from many threads while the tree isn't changed.
+     */
+    PersonIndex getIndex(std::string_view id) const;
+
+    /**
+     * @brief getIndexes
+     * @param ids
+     * @param indexes set to the index of the person with every id, or
+     * NO_PERSON
+     * Same as getIndex for every id, but the slots of the next ids are
+     * fetched from memory while one is looked up.
+     */
+    void getIndexes(const std::vector<std::string_view>& ids,
+                    std::vector<PersonIndex>& indexes) const;
+
+    /**
+     * @brief isAncestor
+     * @param ancestor
+     * @param person
+     * @return true if ancestor is a parent, grandparent etc. of person.
+     * Answered from an index built on the first call after a change that
+     * removed a parent, and patched by the changes that only add.
+     */
+    bool isAncestor(PersonIndex ancestor, PersonIndex person) const;
+
+    /**
+     * @brief areAncestors
+     * @param pairs
+     * @param threads used for answering
+     * @return 1 for every pair whose ancestor_ is an ancestor of its person_,
+     * 0 for the others
+     */
+    std::vector<std::uint8_t> areAncestors(const std::vector<AncestryPair>& pairs,
+                                           unsigned int threads) const;
+
+    /**
+     * @brief nearbyPersons
+     * @param persons to start from, NO_PERSON is skipped
+     * @param radius most parent or child steps taken
+     * @param limit most persons found
+     * @param nearby filled with the persons found, the start ones included,
+     * and their fewest steps from a start one
+     * @return false if there were more than limit persons, nearby then
+     * being incomplete
+     */
+    bool nearbyPersons(const std::vector<PersonIndex>& persons, unsigned int radius,
+                       std::size_t limit,
+                       std::vector<std::pair<PersonIndex, unsigned int>>& nearby) const;
+
+    /**
+     * @brief freeze
+     * Order the persons added since the last freeze by id and by height,
+     * and drop the unused places of the children lists once they take more
+     * room than the children. Costs about as much as the changes since the
+     * last freeze, apart from merging the new persons into the orders of
+     * everyone now and then. Adding more persons or relations afterwards is
+     * allowed, but the queries sort the persons added after the freeze
+     * until the tree is frozen again.
+     */
+    void freeze();
+
+    /**
+     * @brief deferExtremes
+     * Stop updating the tallest and shortest person of the lineages as
+     * relations are added, and compute them all when the tree is frozen
+     * next. Makes adding many relations to a big tree faster, but the
+     * lineages are stale until then.
+     */
+    void deferExtremes();
+
     /**
      * @brief printPersons
      * @param output
-     * Print all stored persons with their ids and heights.
+     * Print all stored persons with their ids and heights, in id order.
      */
     void printPersons(Params, std::ostream &output) const;
 
@@ -111,6 +274,15 @@ public:
      */
     void printCousins(Params params, std::ostream& output) const;
 
+    /**
+     * @brief printCousinsN
+     * @param params (contains person's id, the degree n and the removal k)
+     * @param output
+     * Print the n-th cousins k times removed of the given person, both the
+     * younger and the older ones.
+     */
+    void printCousinsN(Params params, std::ostream& output) const;
+
     /**
      * @brief printTallestInLineage
      * @param params (contains person's id)
@@ -127,6 +299,75 @@ public:
      */
     void printShortestInLineage(Params params, std::ostream& output) const;
 
+    /**
+     * @brief printHeightRange
+     * @param params (contains the lowest and the highest height)
+     * @param output
+     * Print the persons of those heights with their heights, by height and
+     * then by id.
+     */
+    void printHeightRange(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printHeightCount
+     * @param params (contains the lowest and the highest height)
+     * @param output
+     * Print the number of persons of those heights.
+     */
+    void printHeightCount(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printTallestK
+     * @param params (contains the number k)
+     * @param output
+     * Print the k tallest persons with their heights, the tallest first and
+     * those of the same height by id.
+     */
+    void printTallestK(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printLineageHeightRange
+     * @param params (contains person's id, the lowest and the highest height)
+     * @param output
+     * Print the persons of those heights in the given person's lineage, by
+     * height and then by id.
+     */
+    void printLineageHeightRange(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printLineageStats
+     * @param params (contains person's id)
+     * @param output
+     * Print the number, mean, variance, extremes and percentiles of the
+     * heights in the given person's lineage, the person included.
+     */
+    void printLineageStats(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printAncestryStats
+     * @param params (contains person's id)
+     * @param output
+     * Print the statistics of the heights of the given person and their
+     * ancestors, like printLineageStats.
+     */
+    void printAncestryStats(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printLineageStatsOfRoots
+     * @param output
+     * Print the statistics of the lineage of every person without parents,
+     * in id order. The lineages are walked in parallel.
+     */
+    void printLineageStatsOfRoots(Params, std::ostream& output) const;
+
+    /**
+     * @brief printAncestryStatsOfLeaves
+     * @param output
+     * Print the statistics of the ancestry of every person without
+     * children, in id order. The ancestries are walked in parallel.
+     */
+    void printAncestryStatsOfLeaves(Params, std::ostream& output) const;
+
     /**
      * @brief printGrandChildrenN
      * @param params (contains person's id, and distance as a string)
@@ -143,19 +384,395 @@ public:
      */
     void printGrandParentsN(Params params, std::ostream& output) const;
 
+    /**
+     * @brief printRelation
+     * @param params (contains the ids of the person and the relative)
+     * @param output
+     * Print how the relative is related to the person: a direct line,
+     * siblings, aunts and uncles, nieces and nephews, or cousins, and the
+     * lowest common ancestors they are related through.
+     */
+    void printRelation(Params params, std::ostream& output) const;
+
+    /**
+     * @brief printIsAncestor
+     * @param params (contains the ids of the ancestor and the person)
+     * @param output
+     * Print whether the first person is an ancestor of the second.
+     */
+    void printIsAncestor(Params params, std::ostream& output) const;
+
+    /**
+     * @brief saveSnapshot
+     * @param params (contains the file name)
+     * @param output
+     * Save the tree to a binary snapshot file that can be given as the
+     * input file later.
+     */
+    void saveSnapshot(Params params, std::ostream& output) const;
+
+    /**
+     * @brief saveDatafile
+     * @param path
+     * @return true if the file was written, false also for an empty id or
+     * "-", which the loader couldn't read back
+     * Save the tree as a CSV datafile, keeping the order of the persons.
+     */
+    bool saveDatafile(const std::string& path) const;
+
+    /**
+     * @brief addPerson
+     * @param params (contains the id and the height)
+     * @param output
+     * @return true if the person was added
+     * Add a new person without parents.
+     */
+    bool addPerson(Params params, std::ostream& output);
+
+    /**
+     * @brief addParents
+     * @param params (contains the ids of the child, the father and the
+     * mother, "-" for a parent that is kept as it is)
+     * @param output
+     * @return true if the parents were set
+     * Set the parents of a person, all of them already added.
+     */
+    bool addParents(Params params, std::ostream& output);
+
+    /**
+     * @brief changes
+     * @return the persons whose relations addParents has changed since
+     * clearChanges(): the children and their old and new parents
+     */
+    const std::vector<PersonIndex>& changes() const;
+
+    /**
+     * @brief clearChanges
+     */
+    void clearChanges();
+
 private:
-    /* The following functions are meant to make project easier.
-     * You can implement them if you want and/or create your own.
-     * Anyway it would be a good idea to implement more functions
-     * to make things easier and to avoid "copy-paste-coding".
+    // Snapshots read and write the columns directly.
+    friend class Snapshot;
+
+    /**
+     * @brief idOf
+     * @param person
+     * @return the id of the person, pointing into id_chars_.
+     */
+    std::string_view idOf(PersonIndex person) const;
+
+    /**
+     * @brief forEachChild
+     * @param person
+     * @param func called with the index of every child of the person
+     */
+    template <typename Func>
+    void forEachChild(PersonIndex person, Func func) const;
+
+    // Which way generation walks: towards the parents or the children.
+    enum class Direction { UP, DOWN };
+
+    /**
+     * @brief generation
+     * @param person
+     * @param distance number of steps to walk
+     * @param direction
+     * @param found filled with the persons exactly distance steps above or
+     * below the person, each once.
+     */
+    void generation(PersonIndex person, unsigned int distance,
+                    Direction direction, std::vector<PersonIndex>& found) const;
+
+    /**
+     * @brief lineage
+     * @param person
+     * @param direction DOWN for the descendants, UP for the ancestors
+     * @param members filled with the person and every person below or above
+     * them, each once, nearest first.
+     */
+    void lineage(PersonIndex person, Direction direction,
+                 std::vector<PersonIndex>& members) const;
+
+    /**
+     * @brief descendsFrom
+     * @param person
+     * @param ancestor
+     * @return true if ancestor is above person, also while the tree is
+     * being changed
+     */
+    bool descendsFrom(PersonIndex person, PersonIndex ancestor) const;
+
+    // Distribution of the heights of a group of persons, with the heights
+    // at the percentiles listed in familytree.cpp.
+    struct HeightStats
+    {
+        std::size_t count_ = 0;
+        double mean_ = 0;
+        double variance_ = 0;
+        int min_ = 0;
+        int max_ = 0;
+        std::array<int, 5> percentiles_{};
+    };
+
+    /**
+     * @brief heightStats
+     * @param person
+     * @param direction DOWN for the lineage, UP for the ancestry
+     * @return the statistics of the heights of the person and everyone
+     * below or above them
+     */
+    HeightStats heightStats(PersonIndex person, Direction direction) const;
+
+    /**
+     * @brief printHeightStats
+     * @param person
+     * @param direction
+     * @param stats of the person's lineage or ancestry
+     * @param output
+     */
+    void printHeightStats(PersonIndex person, Direction direction,
+                          const HeightStats& stats, std::ostream& output) const;
+
+    /**
+     * @brief printStatsOfAll
+     * @param direction DOWN for the lineages of the persons without
+     * parents, UP for the ancestries of the persons without children
+     * @param output
+     */
+    void printStatsOfAll(Direction direction, std::ostream& output) const;
+
+    /**
+     * @brief cousins
+     * @param person
+     * @param degree n of n-th cousins, 1 or more
+     * @param removed k of k times removed
+     * @param found filled with the n-th cousins k times removed of the
+     * person, both the younger and the older ones, each once.
      */
+    void cousins(PersonIndex person, unsigned int degree,
+                 unsigned int removed, std::vector<PersonIndex>& found) const;
 
     /**
-     * @brief getPointer
+     * @brief printGeneration
+     * @param params
+     * @param direction
+     * @param group "grandparents" or "grandchildren"
+     * @param output
+     * Print the grandparents or grandchildren of the level given in params.
+     */
+    void printGeneration(Params params, Direction direction,
+                         const std::string& group, std::ostream& output) const;
+
+    // Closest relation of two persons: the lowest common ancestors and the
+    // steps up to them from both persons.
+    struct Kinship
+    {
+        unsigned int person_steps_ = 0;
+        unsigned int relative_steps_ = 0;
+        std::vector<PersonIndex> ancestors_;
+    };
+
+    /**
+     * @brief kinship
+     * @param person
+     * @param relative
+     * @return the common ancestors with the fewest steps from both persons,
+     * none if they aren't related. A person counts as its own ancestor.
+     */
+    Kinship kinship(PersonIndex person, PersonIndex relative) const;
+
+    /**
+     * @brief ancestorIndex
+     * @return the ancestor index of the tree, built on the first call after
+     * a change
+     */
+    std::shared_ptr<const AncestorIndex> ancestorIndex() const;
+
+    /**
+     * @brief setParent
+     * @param child
+     * @param slot
+     * @param parent
+     * Put the parent to the slot and update the children lists.
+     */
+    void setParent(PersonIndex child, int slot, PersonIndex parent);
+
+    /**
+     * @brief updateAncestorIndex
+     * @param child
+     * @param removed parent the child lost, or NO_PERSON
+     * @param added parent the child got instead, or NO_PERSON
+     * Patch the ancestor index, if there is one, for the new parent, or
+     * drop it if a parent was removed or it has been patched too often.
+     */
+    void updateAncestorIndex(PersonIndex child, PersonIndex removed, PersonIndex added);
+
+    /**
+     * @brief pack
+     * Drop the unused places of the children lists and merge every person
+     * into the orders, as in a tree just loaded. Snapshots are saved from
+     * a packed tree.
+     */
+    void pack();
+
+    /**
+     * @brief isPacked
+     * @return true if the tree is packed and frozen
+     */
+    bool isPacked() const;
+
+    /**
+     * @brief placeNewPersons
+     * Add the persons added since the last call to the pending orders, or
+     * merge all of them into the orders of everyone if there are too many.
+     */
+    void placeNewPersons();
+
+    /**
+     * @brief orderIds
+     * Sort the persons added since the last call by id and merge them into
+     * id_order_, updating the ranks of the persons after them.
+     */
+    void orderIds();
+
+    /**
+     * @brief sortById
+     * @param persons sorted by id, with NO_PERSON and repeated persons
+     * removed
+     */
+    void sortById(std::vector<PersonIndex>& persons) const;
+
+    /**
+     * @brief orderHeights
+     * Merge the persons added since the last call into height_order_. The
+     * ids must be ordered first.
+     */
+    void orderHeights();
+
+    /**
+     * @brief sortByHeight
+     * @param persons sorted by height and then by id
+     */
+    void sortByHeight(std::vector<PersonIndex>& persons) const;
+
+    /**
+     * @brief heightBefore
+     * @param first
+     * @param second
+     * @return true if first is shorter than second, or as tall and before
+     * it by id
+     */
+    bool heightBefore(PersonIndex first, PersonIndex second) const;
+
+    // Persons from first to past the last.
+    using Persons = std::pair<const PersonIndex*, const PersonIndex*>;
+
+    /**
+     * @brief heightOrders
+     * @param sorted filled with everyone sorted by height, if some persons
+     * were added since the last freeze
+     * @return everyone in two parts, each by height and then by id:
+     * height_order_ and the pending persons, or sorted and nobody
+     */
+    std::array<Persons, 2> heightOrders(std::vector<PersonIndex>& sorted) const;
+
+    /**
+     * @brief heightRange
+     * @param low
+     * @param high
+     * @param sorted see heightOrders, also filled with the persons found if
+     * both parts have some
+     * @return the persons from low to high tall in the height order
+     */
+    Persons heightRange(int low, int high, std::vector<PersonIndex>& sorted) const;
+
+    /**
+     * @brief printHeights
+     * @param begin
+     * @param end
+     * @param output
+     * Print the ids and heights of the persons, one per line.
+     */
+    void printHeights(const PersonIndex* begin, const PersonIndex* end,
+                      std::ostream& output) const;
+
+    /**
+     * @brief packChildren
+     * Build the children lists from the parents with a counting sort,
+     * listing every person's children in index order.
+     */
+    void packChildren();
+
+    /**
+     * @brief compactChildren
+     * Copy the children lists next to each other in person order, keeping
+     * the order of every list, and drop the places left unused.
+     */
+    void compactChildren();
+
+    /**
+     * @brief linkChild
+     * @param child
+     * @param slot
+     * Append the child to the children list of its parent in the slot.
+     */
+    void linkChild(PersonIndex child, int slot);
+
+    /**
+     * @brief unlinkChild
+     * @param child
+     * @param slot
+     * Remove the child from the children list of its parent in the slot.
+     */
+    void unlinkChild(PersonIndex child, int slot);
+
+    /**
+     * @brief growIdTable
+     * @param size of the new table, a power of two
+     * Move everybody to a new id hash table of the given size.
+     */
+    void growIdTable(std::size_t size);
+
+    /**
+     * @brief insertToIdTable
+     * @param slot
+     * Add the person in the slot to the id hash table, growing it when
+     * needed.
+     */
+    void insertToIdTable(const IdSlot& slot);
+
+    /**
+     * @brief findId
      * @param id
-     * @return the pointer to Person object with the given id.
+     * @param hash of the id
+     * @return the index of the person with the given id, or NO_PERSON
+     */
+    PersonIndex findId(std::string_view id, std::uint32_t hash) const;
+
+    /**
+     * @brief foldExtremes
+     * @param person
+     * @return true if the tallest or shortest person of the lineage changed
+     * Recompute the tallest and shortest person in the lineage of the
+     * person from the values of the children.
      */
-    Person* getPointer(const std::string& id) const;
+    bool foldExtremes(PersonIndex person);
+
+    /**
+     * @brief computeExtremes
+     * Compute the tallest and shortest person in every lineage, children
+     * before their parents.
+     */
+    void computeExtremes();
+
+    /**
+     * @brief updateExtremes
+     * @param changed persons whose children lists changed
+     * Recompute the tallest and shortest persons of the changed persons and
+     * of their ancestors, as far as the values change.
+     */
+    void updateExtremes(std::vector<PersonIndex> changed);
 
     /**
      * @brief printNotFound
@@ -163,28 +780,102 @@ private:
      * @param output
      * Print the error message for id not found.
      */
-    void printNotFound(const std::string& id, std::ostream& output) const;
-
-    /**
-     * @brief vectorToIdSet
-     * @param container
-     * @return set of ids of those persons included in the given container
-     * vector.
-     */
-    IdSet vectorToIdSet(const std::vector<Person*> &container) const;
+    void printNotFound(std::string_view id, std::ostream& output) const;
 
     /**
      * @brief printGroup
      * @param id
      * @param group can be e.g. "children", "parents", "siblings", "cousins"
-     * @param container contains the ids of the group members
+     * @param members the group members, NO_PERSON and repeats are skipped.
+     * Sorted in place.
      * @param output
-     * Print the data in the container.
+     * Print the members in id order.
      */
-    void printGroup(const std::string& id, const std::string& group,
-                    const IdSet& container, std::ostream& output) const;
-    // Container to hold pointers to Person structs
-       std::vector<Person*> persons_;
+    void printGroup(std::string_view id, const std::string& group,
+                    std::vector<PersonIndex>& members, std::ostream& output) const;
+
+    // Person storage. Every column has one entry per person, so a person is
+    // just an index and adding one appends to the columns instead of doing
+    // per-person heap allocations. Ids are packed back to back into
+    // id_chars_, person i's id starting at id_offsets_[i] and ending at
+    // id_offsets_[i + 1]. The columns are shared with the copies of the
+    // tree, so a version made by a change copies only what it touches.
+    Column<char> id_chars_;
+    Column<std::uint32_t> id_offsets_{1, 0};
+    Column<int> heights_;
+    ChunkedColumn<ParentPair> parents_;
+
+    // The children of person i are child_list_[child_begin_[i]] ...
+    // child_list_[child_end_[i] - 1], in the order they were added. A list
+    // that gets a child is appended to in place if it is the last one in
+    // child_list_, and is otherwise copied to the end first. A list that
+    // loses a child is copied to the end without it. The places left behind
+    // are dropped by freeze once there are more of them than children.
+    Column<PersonIndex> child_list_;
+    ChunkedColumn<std::uint32_t> child_begin_;
+    ChunkedColumn<std::uint32_t> child_end_;
+    std::size_t listed_children_ = 0;
+
+    // True while the lists follow each other in person order with nothing
+    // in between, so that the begins and the last end are offsets.
+    bool children_packed_ = true;
+
+    // Are the tallest and shortest persons left to the next freeze.
+    bool extremes_deferred_ = false;
+
+    // Persons whose relations the commands have changed, see changes().
+    std::vector<PersonIndex> changed_;
+
+    // Persons in id order and the place of every person in it, so that
+    // printing sorts ranks instead of comparing ids.
+    Column<PersonIndex> id_order_;
+    Column<std::uint32_t> id_rank_;
+
+    // Persons by height and then by id, so that the persons of a range of
+    // heights are next to each other.
+    Column<PersonIndex> height_order_;
+
+    // Persons frozen since the orders above were built, by id and by
+    // height, merged into them once there are too many. Persons added since
+    // the last freeze are in neither.
+    std::vector<PersonIndex> pending_ids_;
+    std::vector<PersonIndex> pending_heights_;
+
+    // The tallest and the shortest person in the lineage of every person,
+    // the person included. Kept up to date on every change, so that
+    // TALLEST and SHORTEST don't walk the descendants.
+    ChunkedColumn<PersonIndex> tallest_;
+    ChunkedColumn<PersonIndex> shortest_;
+
+    // Open addressing hash table from id to index, kept in sync by
+    // addNewPerson. The size is a power of two and empty slots hold
+    // NO_PERSON.
+    ChunkedColumn<IdSlot> id_table_;
+
+    // Ancestor index, loaded atomically also when the tree is copied, as
+    // readers of the tree may be storing one meanwhile.
+    struct IndexHolder
+    {
+        IndexHolder() = default;
+        IndexHolder(const IndexHolder& other) :
+            index_(std::atomic_load(&other.index_))
+        {
+        }
+        IndexHolder& operator=(const IndexHolder& other)
+        {
+            std::atomic_store(&index_, std::atomic_load(&other.index_));
+            return *this;
+        }
+
+        std::shared_ptr<const AncestorIndex> index_;
+    };
+
+    // Built when first needed and shared with the copies of the tree. The
+    // changes patch it while they only add persons and parents.
+    mutable IndexHolder ancestor_index_;
+
+    // Snapshot file viewed by the columns, if the tree was loaded from one.
+    std::shared_ptr<const MappedFile> mapping_;
 };
 
 #endif // FAMILYTREE_HH
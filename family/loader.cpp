@@ -0,0 +1,411 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: loader.cpp                                                          #
+# Description: Reading the CSV datafile into a Familytree.                  #
+# Notes: * Check the loader.hh for more info.                               #
+#############################################################################
+*/
+#include "loader.hh"
+#include "utils.hh"
+
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// Constants to make CSV-parsing more readable.
+const char CSV_DELIMITER = ';';
+const char CSV_QUOTE = '"';
+const std::string_view NO_PARENT = "-";
+enum CsvFields { CSV_NAME, CSV_HEIGHT, CSV_FATHER, CSV_MOTHER, CSV_VALUES };
+
+// Struct for parent-child relations.
+struct Relation
+{
+    std::string child_;
+    std::vector<std::string> parents_;
+};
+
+// Person and the ids of the parents parsed from a line, the ids pointing
+// to the datafile contents.
+struct ParsedPerson
+{
+    std::string_view id_;
+    int height_ = NO_HEIGHT;
+    std::string_view parents_[2];
+};
+
+// Newline-aligned part of the datafile parsed by one thread.
+struct Chunk
+{
+    std::string_view contents_;
+
+    // Persons parsed from the chunk before the first erroneous line, and
+    // their indices in the database.
+    std::vector<ParsedPerson> persons_;
+    std::vector<PersonIndex> indices_;
+    std::deque<std::string> unquoted_;
+
+    // Lines in the chunk, or up to and including the erroneous line.
+    int lines_ = 0;
+    bool error_ = false;
+    bool invalid_height_ = false;
+
+    // Position of the chunk's first relation in the relations of the file.
+    std::size_t first_relation_ = 0;
+};
+
+/**
+ * @brief parsePerson
+ * @param line: string to be parsed
+ * @param relations
+ * @return Person struct that was created, in erroneuos input the fields id_
+ *         and height_ keep their initial values (NO_NAME and NO_HEIGTH)
+ * Parse the given line to a new person and child-parent relationship.
+ */
+Person parsePerson(const std::string& line, std::vector<Relation> &relations)
+{
+    Person new_person;
+    Relation new_relation;
+    std::vector<std::string> parsed_data = Utils::split(line, CSV_DELIMITER);
+
+    // Check that there was correct amount of fields in the line.
+    if( parsed_data.size() == CSV_VALUES )
+    {
+        new_person.id_ = parsed_data[CSV_NAME];
+
+        if( Utils::isNumeric(parsed_data[CSV_HEIGHT]) )
+        {
+            new_person.height_ = std::stoi(parsed_data[CSV_HEIGHT]);
+        }
+        else
+        {
+            std::cout << "Invalid argument." << std::endl;
+        }
+
+        new_relation.child_ = parsed_data[CSV_NAME];
+        new_relation.parents_.push_back(parsed_data[CSV_FATHER]);
+        new_relation.parents_.push_back(parsed_data[CSV_MOTHER]);
+        relations.push_back(new_relation);
+    }
+
+    return new_person;
+}
+
+/**
+ * @brief splitLine
+ * @param line
+ * @param fields: array of CSV_VALUES fields to fill
+ * @param unquoted: storage for the fields that contained quotes
+ * @return true iff the line has exactly CSV_VALUES fields
+ * Split the line at the delimiters outside quotes, like Utils::split.
+ * Fields without quotes point to the line itself. Quotes are removed from
+ * the other fields, which are copied to the unquoted storage.
+ */
+bool splitLine(std::string_view line, std::string_view* fields,
+               std::deque<std::string>& unquoted)
+{
+    unsigned int field = 0;
+    std::size_t field_start = 0;
+    bool has_quotes = false;
+    bool inside_quotation = false;
+
+    // Only the delimiters and quotes are looked at, jumping over the other
+    // chars many at a time.
+    for( std::size_t i = 0; i <= line.size(); ++i )
+    {
+        i += Utils::findSpecial(line.substr(i), CSV_DELIMITER);
+        if( i < line.size() and line[i] == CSV_QUOTE )
+        {
+            inside_quotation = not inside_quotation;
+            has_quotes = true;
+        }
+        else if( i == line.size() or not inside_quotation )
+        {
+            if( field == CSV_VALUES )
+            {
+                return false;
+            }
+            std::string_view value = line.substr(field_start, i - field_start);
+            if( has_quotes )
+            {
+                unquoted.emplace_back();
+                for( char c : value )
+                {
+                    if( c != CSV_QUOTE )
+                    {
+                        unquoted.back().push_back(c);
+                    }
+                }
+                value = unquoted.back();
+            }
+            fields[field++] = value;
+            field_start = i + 1;
+            has_quotes = false;
+        }
+    }
+    return field == CSV_VALUES;
+}
+
+/**
+ * @brief parseHeight
+ * @param field
+ * @return the height, or NO_HEIGHT if the field isn't a non-negative number
+ */
+int parseHeight(std::string_view field)
+{
+    int height = NO_HEIGHT;
+    if( field.empty() or not std::isdigit(static_cast<unsigned char>(field.front())) )
+    {
+        return NO_HEIGHT;
+    }
+    const char* end = field.data() + field.size();
+    std::from_chars_result result = std::from_chars(field.data(), end, height);
+    if( result.ec != std::errc() or result.ptr != end )
+    {
+        return NO_HEIGHT;
+    }
+    return height;
+}
+
+/**
+ * @brief findParent
+ * @param database
+ * @param id
+ * @return index of the parent, NO_PERSON for "-" or unknown ids
+ */
+PersonIndex findParent(const Familytree& database, std::string_view id)
+{
+    if( id == NO_PARENT )
+    {
+        return NO_PERSON;
+    }
+    return database.getIndex(id);
+}
+
+/**
+ * @brief splitToChunks
+ * @param contents
+ * @param count: wanted number of chunks
+ * @return chunks of about the same size, each ending at a newline or at
+ * the end of the contents
+ */
+std::vector<Chunk> splitToChunks(std::string_view contents, unsigned int count)
+{
+    std::vector<Chunk> chunks;
+    std::size_t chunk_start = 0;
+    for( unsigned int i = 1; i <= count and chunk_start < contents.size(); ++i )
+    {
+        std::size_t chunk_end = contents.size();
+        if( i < count )
+        {
+            chunk_end = std::max(chunk_start, contents.size() / count * i);
+            chunk_end = contents.find('\n', chunk_end);
+            chunk_end = chunk_end == std::string_view::npos
+                    ? contents.size() : chunk_end + 1;
+        }
+        chunks.emplace_back();
+        chunks.back().contents_ = contents.substr(chunk_start, chunk_end - chunk_start);
+        chunk_start = chunk_end;
+    }
+    return chunks;
+}
+
+/**
+ * @brief parseChunk
+ * @param chunk
+ * Parse the lines of the chunk until its end or the first erroneous line.
+ */
+void parseChunk(Chunk& chunk)
+{
+    std::string_view contents = chunk.contents_;
+    std::size_t line_start = 0;
+    while( line_start < contents.size() )
+    {
+        // Lines end at a newline or at the end of the file.
+        const void* newline = std::memchr(contents.data() + line_start, '\n',
+                                          contents.size() - line_start);
+        std::size_t line_end = newline == nullptr
+                ? contents.size()
+                : static_cast<const char*>(newline) - contents.data();
+        std::string_view line = contents.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        // Linenumbering for error-printing.
+        ++chunk.lines_;
+
+        // Skip empty and commented lines.
+        if( line.empty() or line[0] == '#' )
+        {
+            continue;
+        }
+
+        // Tokenize the line in place, the fields must be a non-empty id and
+        // a numeric height.
+        std::string_view fields[CSV_VALUES];
+        int height = NO_HEIGHT;
+        if( splitLine(line, fields, chunk.unquoted_) )
+        {
+            height = parseHeight(fields[CSV_HEIGHT]);
+            if( height == NO_HEIGHT )
+            {
+                chunk.invalid_height_ = true;
+            }
+        }
+        if( fields[CSV_NAME].empty() or height == NO_HEIGHT )
+        {
+            chunk.error_ = true;
+            return;
+        }
+        chunk.persons_.push_back({fields[CSV_NAME], height,
+                                  {fields[CSV_FATHER], fields[CSV_MOTHER]}});
+    }
+}
+
+/**
+ * @brief forEachChunk
+ * @param chunks
+ * @param func: called with every chunk, each in its own thread
+ */
+template <typename Func>
+void forEachChunk(std::vector<Chunk>& chunks, Func func)
+{
+    if( chunks.size() == 1 )
+    {
+        func(chunks.front());
+        return;
+    }
+    std::vector<std::thread> workers;
+    for( Chunk& chunk : chunks )
+    {
+        workers.emplace_back([&func, &chunk]() { func(chunk); });
+    }
+    for( std::thread& worker : workers )
+    {
+        worker.join();
+    }
+}
+}
+
+bool Loader::populateDatabase(std::istream& datafile,
+                              std::shared_ptr<Familytree> database)
+{
+    std::string line = "";
+    std::vector<std::string> parsed_line;
+    std::vector<Relation> relations;
+    int line_number = 0;
+
+    while( std::getline(datafile, line) )
+    {
+        // Linenumbering for error-printing.
+        ++line_number;
+
+        // Skip empty and commented lines.
+        if( line.empty() or line[0] == '#' )
+        {
+            continue;
+        }
+
+        // Parse the line to a new person and relation.
+        Person new_person = parsePerson(line, relations);
+        if( new_person.id_ == NO_ID or new_person.height_ == NO_HEIGHT )
+        {
+            std::cout << "Error in datafile, line " << line_number
+                      << std::endl;
+            return false;
+        }
+
+        // Add the new person to the database.
+        database->addNewPerson(new_person.id_, new_person.height_, std::cout);
+    }
+
+    // After the persons have been created, add the child-parent relations.
+    for( auto iter = relations.begin(); iter != relations.end(); ++iter )
+    {
+        database->addRelation(iter->child_, iter->parents_, std::cout);
+    }
+
+    // The tree is only queried from now on.
+    database->freeze();
+    return true;
+}
+
+bool Loader::populateDatabase(std::string_view contents,
+                              std::shared_ptr<Familytree> database,
+                              unsigned int threads)
+{
+    // Parse newline-aligned chunks of the file in parallel.
+    std::vector<Chunk> chunks = splitToChunks(contents, std::max(1U, threads));
+    forEachChunk(chunks, parseChunk);
+
+    // Add the persons in file order, so that the messages are the same as
+    // when reading line by line, and stop at the first erroneous line.
+    std::size_t persons = 0;
+    std::size_t id_chars = 0;
+    for( const Chunk& chunk : chunks )
+    {
+        persons += chunk.persons_.size();
+        for( const ParsedPerson& person : chunk.persons_ )
+        {
+            id_chars += person.id_.size();
+        }
+    }
+    database->reserve(persons, id_chars);
+
+    int line_number = 0;
+    std::size_t relations = 0;
+    for( Chunk& chunk : chunks )
+    {
+        // Add the new persons to the database, this is the only copy of the
+        // ids. A person already added keeps the index it has.
+        chunk.indices_.reserve(chunk.persons_.size());
+        for( const ParsedPerson& person : chunk.persons_ )
+        {
+            PersonIndex index = static_cast<PersonIndex>(database->size());
+            database->addNewPerson(person.id_, person.height_, std::cout);
+            if( database->size() == index )
+            {
+                index = database->getIndex(person.id_);
+            }
+            chunk.indices_.push_back(index);
+        }
+        line_number += chunk.lines_;
+        if( chunk.error_ )
+        {
+            if( chunk.invalid_height_ )
+            {
+                std::cout << "Invalid argument." << std::endl;
+            }
+            std::cout << "Error in datafile, line " << line_number
+                      << std::endl;
+            return false;
+        }
+        chunk.first_relation_ = relations;
+        relations += chunk.persons_.size();
+    }
+
+    // After the persons have been created, look up the children and parents
+    // of the relations in parallel and add them all at once.
+    std::vector<IndexedRelation> indexed_relations(relations);
+    forEachChunk(chunks, [&database, &indexed_relations](const Chunk& chunk) {
+        IndexedRelation* relation = indexed_relations.data() + chunk.first_relation_;
+        for( std::size_t i = 0; i < chunk.persons_.size(); ++i, ++relation )
+        {
+            const ParsedPerson& person = chunk.persons_[i];
+            relation->child_ = chunk.indices_[i];
+            relation->parents_ = {findParent(*database, person.parents_[0]),
+                                  findParent(*database, person.parents_[1])};
+        }
+    });
+    database->addRelations(indexed_relations, threads);
+    return true;
+}
@@ -0,0 +1,48 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: loader.hh                                                           #
+# Description: Reading the CSV datafile into a Familytree. Every line of    #
+#   the datafile holds one person: id;height;father;mother.                 #
+#############################################################################
+*/
+#ifndef LOADER_HH
+#define LOADER_HH
+
+#include "familytree.hh"
+
+#include <istream>
+#include <memory>
+#include <string_view>
+
+namespace Loader
+{
+/**
+ * @brief populateDatabase
+ * @param datafile
+ * @param database
+ * @return true iff there were no errors in the datafile
+ * Read the datafile line by line and populate database with its content.
+ */
+bool populateDatabase(std::istream& datafile,
+                      std::shared_ptr<Familytree> database);
+
+/**
+ * @brief populateDatabase
+ * @param contents whole datafile, e.g. a MappedFile
+ * @param database
+ * @param threads number of threads parsing the datafile
+ * @return true iff there were no errors in the datafile
+ * Populate database from a datafile already in memory. The datafile is
+ * split into newline-aligned chunks that are tokenized in place by their
+ * own threads, and only the ids are copied, into the database. Persons are
+ * added and the messages printed in file order, so the output is the same
+ * as the stream version's whatever the number of threads.
+ */
+bool populateDatabase(std::string_view contents,
+                      std::shared_ptr<Familytree> database,
+                      unsigned int threads = 1);
+}
+
+#endif // LOADER_HH
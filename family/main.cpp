@@ -7,149 +7,274 @@
 # File: main.cpp                                                            #
 # Description: Main-module performs the followin operations:                #
 #       * Query for input file.                                             #
-#       * Parse the CSV-data                                                #
-#       * Pass the parsed data to Familytree-module                         #
+#       * Parse the CSV-data with the Loader-module                         #
 #       * Launch Cli-module                                                 #
+#       * Or with --batch, run a script of commands without prompts         #
+#       * Or with --daemon, serve the commands over a UNIX domain socket    #
+#       * With --log, keep the changes in a log replayed at startup, and    #
+#         with --compact fold the log into the datafile                     #
+#       * With --stats, write the statistics of the commands as JSON at     #
+#         exit                                                              #
 # Notes: * This is an exercise program.                                     #
 #        * Student's don't touch this file.                                 #
 #############################################################################
 */
 #include "familytree.hh"
+#include "bufferedsink.hh"
 #include "cli.hh"
-#include "utils.hh"
+#include "loader.hh"
+#include "mappedfile.hh"
+#include "queryexecutor.hh"
+#include "server.hh"
+#include "snapshot.hh"
 
 #include <iostream>
-#include <vector>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 
-// Constants to make CSV-parsing more readable.
-const char CSV_DELIMITER = ';';
-enum CsvFields { CSV_NAME, CSV_HEIGHT, CSV_FATHER, CSV_MOTHER, CSV_VALUES };
+// Command line option for running a script without prompts.
+const std::string BATCH_OPTION = "--batch";
 
-// Struct for parent-child relations.
-struct Relation
-{
-    std::string child_;
-    std::vector<std::string> parents_;
-};
+// Command line option for serving the commands over a UNIX domain socket.
+const std::string DAEMON_OPTION = "--daemon";
+
+// Command line option for logging the changes to the tree.
+const std::string LOG_OPTION = "--log";
+
+// Command line option for folding the log into the datafile.
+const std::string COMPACT_OPTION = "--compact";
+
+// Command line option for writing the statistics of the commands at exit.
+const std::string STATS_OPTION = "--stats";
 
 /**
- * @brief parsePerson
- * @param line: string to be parsed
- * @param relations
- * @return Person struct that was created, in erroneuos input the fields id_
- *         and height_ keep their initial values (NO_NAME and NO_HEIGTH)
- * Parse the given line to a new person and child-parent relationship.
+ * @brief loadDatabase
+ * @param path
+ * @return the family tree read from the file, or nullptr if that failed
+ * Regular files are mapped to memory. Snapshots are used as they are,
+ * CSV files are parsed in place. Anything else is read as a stream.
  */
-Person parsePerson(const std::string& line, std::vector<Relation> &relations)
+std::shared_ptr<Familytree> loadDatabase(const std::string& path)
 {
-    Person new_person;
-    Relation new_relation;
-    std::vector<std::string> parsed_data = Utils::split(line, CSV_DELIMITER);
-
-    // Check that there was correct amount of fields in the line.
-    if( parsed_data.size() == CSV_VALUES )
+    std::shared_ptr<Familytree> database = std::make_shared<Familytree>();
+    std::shared_ptr<MappedFile> mapped_datafile = std::make_shared<MappedFile>();
+    if( mapped_datafile->open(path) )
     {
-        new_person.id_ = parsed_data[CSV_NAME];
-
-        if( Utils::isNumeric(parsed_data[CSV_HEIGHT]) )
+        if( Snapshot::isSnapshot(mapped_datafile->contents()) )
         {
-            new_person.height_ = std::stoi(parsed_data[CSV_HEIGHT]);
+            database = Snapshot::load(mapped_datafile);
+            if( database == nullptr )
+            {
+                std::cout << "Error in snapshot file: " << path
+                          << std::endl;
+            }
+            return database;
         }
-        else
+        // Unlike the columns of a snapshot, a CSV file is parsed in order.
+        mapped_datafile->advise(MappedFile::Access::SEQUENTIAL);
+        if( not Loader::populateDatabase(mapped_datafile->contents(), database,
+                                         std::thread::hardware_concurrency()) )
         {
-            std::cout << "Invalid argument." << std::endl;
+            return nullptr;
         }
-
-        new_relation.child_ = parsed_data[CSV_NAME];
-        new_relation.parents_.push_back(parsed_data[CSV_FATHER]);
-        new_relation.parents_.push_back(parsed_data[CSV_MOTHER]);
-        relations.push_back(new_relation);
+        return database;
     }
 
-    return new_person;
+    std::ifstream datafile(path);
+    if( not datafile )
+    {
+        std::cout << "Could not open file: " << path << std::endl;
+        return nullptr;
+    }
+    if( not Loader::populateDatabase(datafile, database) )
+    {
+        return nullptr;
+    }
+    return database;
 }
 
 /**
- * @brief populateDatabase
- * @param datafile
- * @param database
- * @return true iff there were no errors in the datafile
- * Read the datafile and populate database with its content
+ * @brief openLog
+ * @param commandline
+ * @param path of the log, empty if none was given
+ * @param stats_path file for the statistics, empty if none was given
+ * @return false if the log was given but couldn't be opened
  */
-bool populateDatabase(std::ifstream& datafile,
-                      std::shared_ptr<Familytree> database)
+bool openLog(Cli& commandline, const std::string& path, const std::string& stats_path)
 {
-    std::string line = "";
-    std::vector<std::string> parsed_line;
-    std::vector<Relation> relations;
-    int line_number = 0;
+    commandline.setStatsFile(stats_path);
+    if( not path.empty() and not commandline.openLog(path) )
+    {
+        std::cout << "Could not open log: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    while( std::getline(datafile, line) )
+/**
+ * @brief main
+ * @return
+ * Ask for the input file, populate database on it, and launch CLI.
+ * Started as "family --batch datafile [script]", runs the commands in the
+ * script, or in the standard input if no script is given, without prompts
+ * and with the results buffered. Started as "family --daemon datafile
+ * socket", serves the commands to familyclient until SIGINT or SIGTERM.
+ * Any of these can be preceded by "--log logfile": the changes in the log
+ * are made to the tree read from the datafile, and later changes are
+ * added to the log. "family --log logfile --compact datafile" replaces the
+ * datafile with the changed tree, in the same format, and empties the log.
+ * "--stats file" before the mode writes the counts, latencies and sizes of
+ * the commands run to the file as JSON at exit.
+ */
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    std::string log_path;
+    std::string stats_path;
+    while( args.size() >= 2 and (args.front() == LOG_OPTION or args.front() == STATS_OPTION) )
+    {
+        (args.front() == LOG_OPTION ? log_path : stats_path) = args.at(1);
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    std::string mode = args.empty() ? "" : args.front();
+    bool batch = mode == BATCH_OPTION;
+    bool daemon = mode == DAEMON_OPTION;
+    bool compact = mode == COMPACT_OPTION;
+    if( (batch and (args.size() < 2 or args.size() > 3))
+        or (daemon and args.size() != 3)
+        or (compact and (args.size() != 2 or log_path.empty()))
+        or (not batch and not daemon and not compact and not args.empty()) )
     {
-        // Linenumbering for error-printing.
-        ++line_number;
+        std::cout << "Usage: " << argv[0] << " [" << LOG_OPTION << " logfile] ["
+                  << STATS_OPTION << " file] ["
+                  << BATCH_OPTION << " datafile [script] | " << DAEMON_OPTION
+                  << " datafile socket | " << COMPACT_OPTION << " datafile]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
 
-        // Skip empty and commented lines.
-        if( line.empty() or line[0] == '#' )
+    if( compact )
+    {
+        std::shared_ptr<Familytree> database = loadDatabase(args.at(1));
+        if( database == nullptr )
         {
-            continue;
+            return EXIT_FAILURE;
         }
-
-        // Parse the line to a new person and relation.
-        Person new_person = parsePerson(line, relations);
-        if( new_person.id_ == NO_ID or new_person.height_ == NO_HEIGHT )
+        Cli commandline(database);
+        if( not openLog(commandline, log_path, stats_path) )
         {
-            std::cout << "Error in datafile, line " << line_number
-                      << std::endl;
-            return false;
+            return EXIT_FAILURE;
         }
-
-        // Add the new person to the database.
-        database->addNewPerson(new_person.id_, new_person.height_, std::cout);
+        MappedFile datafile;
+        bool snapshot = datafile.open(args.at(1))
+                        and Snapshot::isSnapshot(datafile.contents());
+        if( not commandline.compactLog(args.at(1), snapshot) )
+        {
+            std::cout << "Could not compact " << log_path << " into "
+                      << args.at(1) << "." << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Compacted " << log_path << " into " << args.at(1) << "."
+                  << std::endl;
+        return EXIT_SUCCESS;
     }
 
-    // After the persons have been created, add the child-parent relations.
-    for( auto iter = relations.begin(); iter != relations.end(); ++iter )
+    if( daemon )
     {
-        database->addRelation(iter->child_, iter->parents_, std::cout);
+        std::shared_ptr<Familytree> database = loadDatabase(args.at(1));
+        if( database == nullptr )
+        {
+            return EXIT_FAILURE;
+        }
+        Cli commandline(database);
+        if( not openLog(commandline, log_path, stats_path) )
+        {
+            return EXIT_FAILURE;
+        }
+        Server server(commandline);
+        if( not server.listen(args.at(2)) )
+        {
+            std::cout << "Could not listen on socket: " << args.at(2) << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Serving " << args.at(1) << " on " << args.at(2) << "." << std::endl;
+        return server.run() ? EXIT_SUCCESS : EXIT_FAILURE;
     }
-    return true;
-}
 
-/**
- * @brief main
- * @return
- * Ask for the input file, populate database on it, and launch CLI.
- */
-int main()
-{
-    std::string cmd_string;
-    std::shared_ptr<Familytree> database = std::make_shared<Familytree>();
+    if( not batch )
+    {
+        // File query
+        std::string cmd_string;
+        std::cout << "Input file: ";
+        std::getline(std::cin, cmd_string);
+
+        std::shared_ptr<Familytree> database = loadDatabase(cmd_string);
+        if( database == nullptr )
+        {
+            return EXIT_FAILURE;
+        }
 
-    // File query
-    std::cout << "Input file: ";
-    std::getline(std::cin, cmd_string);
-    std::ifstream datafile(cmd_string);
+        // Constructing the command-line interpreter with the given datastructure
+        Cli commandline(database);
+        if( not openLog(commandline, log_path, stats_path) )
+        {
+            return EXIT_FAILURE;
+        }
 
-    if( not datafile )
+        // Empty loop that runs the CLI.
+        // CLI returns false only on exit-command or at the end of the input
+        while( commandline.exec_prompt() ){}
+
+        return EXIT_SUCCESS;
+    }
+
+    std::shared_ptr<Familytree> database = loadDatabase(args.at(1));
+    if( database == nullptr )
     {
-        std::cout << "Could not open file: " << cmd_string << std::endl;
         return EXIT_FAILURE;
     }
 
-    if( not populateDatabase(datafile, database) )
+    std::ifstream script;
+    if( args.size() == 3 )
     {
-        return EXIT_FAILURE;
+        script.open(args.at(2));
+        if( not script )
+        {
+            std::cout << "Could not open file: " << args.at(2) << std::endl;
+            return EXIT_FAILURE;
+        }
     }
 
-    // Constructing the command-line interpreter with the given datastructure
-    Cli commandline(database);
+    // The results go to the standard output through one big buffer, after
+    // whatever the loader printed.
+    std::cout.flush();
+    BufferedSink sink(STDOUT_FILENO);
+    std::ostream output(&sink);
+    std::istream& input = args.size() == 3 ? script : std::cin;
+    Cli commandline(database, input, output, false);
+    if( not openLog(commandline, log_path, stats_path) )
+    {
+        return EXIT_FAILURE;
+    }
 
-    // Empty loop that runs the CLI.
-    // CLI returns false only on exit-command
-    while( commandline.exec_prompt() ){}
+    // With more cores the queries between two changes (ADD, RELATE) are run
+    // in parallel. Each change runs alone after the queries before it have
+    // finished, and the queries after it start only once it is done, so
+    // the results are the same, and printed in the same order, as one by
+    // one.
+    unsigned int threads = std::thread::hardware_concurrency();
+    if( threads > 1 )
+    {
+        QueryExecutor executor(commandline, threads);
+        executor.runStream(input, output);
+    }
+    else
+    {
+        while( commandline.exec_prompt() ){}
+    }
 
     return EXIT_SUCCESS;
 }
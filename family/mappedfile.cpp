@@ -0,0 +1,80 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: mappedfile.cpp                                                      #
+# Description: Read-only memory mapping of a whole file.                    #
+# Notes: * Check the mappedfile.hh for more info.                           #
+#############################################################################
+*/
+#include "mappedfile.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path, Access access)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+    {
+        return false;
+    }
+
+    // Pipes and other special files can't be mapped.
+    struct stat info;
+    if( fstat(fd, &info) != 0 or not S_ISREG(info.st_mode) )
+    {
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<std::size_t>(info.st_size);
+    if( size_ > 0 )
+    {
+        void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( mapping == MAP_FAILED )
+        {
+            size_ = 0;
+            ::close(fd);
+            return false;
+        }
+        data_ = static_cast<const char*>(mapping);
+        advise(access);
+    }
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::advise(Access access)
+{
+    // Pages read in order may be dropped soon after, so only a file read
+    // from start to end is told so.
+    if( data_ != nullptr )
+    {
+        madvise(const_cast<char*>(data_), size_,
+                access == Access::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_NORMAL);
+    }
+}
+
+std::string_view MappedFile::contents() const
+{
+    return std::string_view(data_, size_);
+}
+
+void MappedFile::close()
+{
+    if( data_ != nullptr )
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
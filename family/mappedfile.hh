@@ -0,0 +1,63 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: mappedfile.hh                                                       #
+# Description: Read-only memory mapping of a whole file.                    #
+#############################################################################
+*/
+#ifndef MAPPEDFILE_HH
+#define MAPPEDFILE_HH
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief The MappedFile class
+ * Maps a file to memory for reading and unmaps it when destroyed.
+ */
+class MappedFile
+{
+public:
+    // How the mapped bytes are read, told to the kernel for its read-ahead
+    enum class Access { NORMAL, SEQUENTIAL };
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief open
+     * @param path
+     * @param access how the contents are going to be read
+     * @return true if the file is a regular file and could be mapped
+     */
+    bool open(const std::string& path, Access access = Access::NORMAL);
+
+    /**
+     * @brief advise
+     * @param access how the contents are read from now on
+     */
+    void advise(Access access);
+
+    /**
+     * @brief contents
+     * @return the mapped bytes, empty for an empty file
+     */
+    std::string_view contents() const;
+
+private:
+    /**
+     * @brief close
+     * Unmap the current file, if any.
+     */
+    void close();
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif // MAPPEDFILE_HH
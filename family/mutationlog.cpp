@@ -0,0 +1,386 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: mutationlog.cpp                                                     #
+# Description: Append-only log of the changes made to a Familytree,         #
+#   replayed on top of the datafile at startup.                             #
+# Notes: * Check the mutationlog.hh for more info.                          #
+#############################################################################
+*/
+#include "mutationlog.hh"
+#include "mappedfile.hh"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+const char MAGIC[8] = {'F', 'A', 'M', 'I', 'L', 'O', 'G', '\n'};
+const std::uint32_t VERSION = 1;
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct Header
+{
+    char magic_[8];
+    std::uint32_t version_;
+    std::uint32_t byte_order_;
+};
+
+// Length and checksum before every payload
+const std::size_t RECORD_HEADER_SIZE = 2 * sizeof(std::uint32_t);
+
+/**
+ * @brief crcTables
+ * @return tables for computing the CRC-32 (IEEE 802.3) eight bytes at a
+ * time: the first is the usual table for one byte, table k gives the CRC
+ * of a byte followed by k zero bytes
+ */
+const std::array<std::array<std::uint32_t, 256>, 8>& crcTables()
+{
+    static const std::array<std::array<std::uint32_t, 256>, 8> tables = []()
+    {
+        std::array<std::array<std::uint32_t, 256>, 8> result;
+        for( std::uint32_t i = 0; i < 256; ++i )
+        {
+            std::uint32_t crc = i;
+            for( int bit = 0; bit < 8; ++bit )
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            result[0][i] = crc;
+        }
+        for( std::size_t k = 1; k < result.size(); ++k )
+        {
+            for( std::uint32_t i = 0; i < 256; ++i )
+            {
+                std::uint32_t previous = result[k - 1][i];
+                result[k][i] = result[0][previous & 0xFF] ^ (previous >> 8);
+            }
+        }
+        return result;
+    }();
+    return tables;
+}
+
+std::uint32_t crc32(std::string_view bytes)
+{
+    const std::array<std::array<std::uint32_t, 256>, 8>& tables = crcTables();
+    std::uint32_t crc = 0xFFFFFFFFu;
+    const unsigned char* next = reinterpret_cast<const unsigned char*>(bytes.data());
+    std::size_t left = bytes.size();
+
+    // Eight bytes are folded in with one lookup each, all independent of
+    // each other (slicing-by-8). The reflected CRC takes the first four
+    // of them as a little-endian word.
+    while( left >= 8 )
+    {
+        std::uint32_t low = crc ^ (std::uint32_t(next[0]) | std::uint32_t(next[1]) << 8
+                                   | std::uint32_t(next[2]) << 16 | std::uint32_t(next[3]) << 24);
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF]
+              ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24]
+              ^ tables[3][next[4]] ^ tables[2][next[5]]
+              ^ tables[1][next[6]] ^ tables[0][next[7]];
+        next += 8;
+        left -= 8;
+    }
+    for( ; left > 0; --left, ++next )
+    {
+        crc = tables[0][(crc ^ *next) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void appendNumber(std::string& buffer, std::uint32_t number)
+{
+    buffer.append(reinterpret_cast<const char*>(&number), sizeof(number));
+}
+
+/**
+ * @brief readNumber
+ * @param bytes
+ * @param number
+ * @return false if bytes is too short, otherwise drops the number from it
+ */
+bool readNumber(std::string_view& bytes, std::uint32_t& number)
+{
+    if( bytes.size() < sizeof(number) )
+    {
+        return false;
+    }
+    std::memcpy(&number, bytes.data(), sizeof(number));
+    bytes.remove_prefix(sizeof(number));
+    return true;
+}
+
+/**
+ * @brief decode
+ * @param payload
+ * @param fields set to view the payload
+ * @return true if the payload was a whole list of fields
+ */
+bool decode(std::string_view payload, std::vector<std::string_view>& fields)
+{
+    std::uint32_t count = 0;
+    if( not readNumber(payload, count) or count > payload.size() )
+    {
+        return false;
+    }
+    fields.resize(count);
+    for( std::string_view& field : fields )
+    {
+        std::uint32_t length = 0;
+        if( not readNumber(payload, length) or length > payload.size() )
+        {
+            return false;
+        }
+        field = payload.substr(0, length);
+        payload.remove_prefix(length);
+    }
+    return payload.empty();
+}
+
+bool writeAll(int fd, const char* data, std::size_t size)
+{
+    while( size > 0 )
+    {
+        ssize_t written = ::write(fd, data, size);
+        if( written < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+/**
+ * @brief syncDirectory
+ * @param path
+ * Make a newly created file at path survive a crash.
+ */
+void syncDirectory(const std::string& path)
+{
+    std::string::size_type slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if( fd >= 0 )
+    {
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+MutationLog::~MutationLog()
+{
+    if( flusher_.joinable() )
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        queued_.notify_one();
+        flusher_.join();
+    }
+    if( fd_ >= 0 )
+    {
+        ::close(fd_);
+    }
+}
+
+bool MutationLog::open(const std::string& path, const Replay& replay)
+{
+    // Replay the records up to the first one that isn't whole, which was
+    // being written when the program stopped.
+    std::size_t valid_size = 0;
+    MappedFile file;
+    if( file.open(path, MappedFile::Access::SEQUENTIAL) and not file.contents().empty() )
+    {
+        std::string_view contents = file.contents();
+        Header header;
+        if( contents.size() < sizeof(Header) )
+        {
+            return false;
+        }
+        std::memcpy(&header, contents.data(), sizeof(Header));
+        if( std::memcmp(header.magic_, MAGIC, sizeof(MAGIC)) != 0
+            or header.version_ != VERSION
+            or header.byte_order_ != BYTE_ORDER_MARK )
+        {
+            return false;
+        }
+
+        // The lists of fields are kept between the batches.
+        Records batch(REPLAY_BATCH);
+        std::size_t batched = 0;
+        std::string_view records = contents.substr(sizeof(Header));
+        valid_size = sizeof(Header);
+        while( records.size() >= RECORD_HEADER_SIZE )
+        {
+            std::uint32_t length = 0;
+            std::uint32_t checksum = 0;
+            readNumber(records, length);
+            readNumber(records, checksum);
+            if( length > records.size() )
+            {
+                break;
+            }
+            std::string_view payload = records.substr(0, length);
+            if( crc32(payload) != checksum or not decode(payload, batch[batched]) )
+            {
+                break;
+            }
+            ++records_;
+            records.remove_prefix(length);
+            valid_size += RECORD_HEADER_SIZE + length;
+            if( ++batched == REPLAY_BATCH )
+            {
+                replay(batch);
+                batched = 0;
+            }
+        }
+        if( batched > 0 )
+        {
+            batch.resize(batched);
+            replay(batch);
+        }
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if( fd_ < 0 )
+    {
+        return false;
+    }
+    if( valid_size == 0 )
+    {
+        Header header = {};
+        std::memcpy(header.magic_, MAGIC, sizeof(MAGIC));
+        header.version_ = VERSION;
+        header.byte_order_ = BYTE_ORDER_MARK;
+        if( ftruncate(fd_, 0) != 0
+            or not writeAll(fd_, reinterpret_cast<const char*>(&header), sizeof(Header))
+            or fdatasync(fd_) != 0 )
+        {
+            return false;
+        }
+        syncDirectory(path);
+    }
+    else if( ftruncate(fd_, static_cast<off_t>(valid_size)) != 0
+             or fdatasync(fd_) != 0 )
+    {
+        return false;
+    }
+
+    flusher_ = std::thread(&MutationLog::flush, this);
+    return true;
+}
+
+std::uint64_t MutationLog::append(const std::vector<std::string>& fields)
+{
+    std::string payload;
+    appendNumber(payload, static_cast<std::uint32_t>(fields.size()));
+    for( const std::string& field : fields )
+    {
+        appendNumber(payload, static_cast<std::uint32_t>(field.size()));
+        payload += field;
+    }
+
+    std::uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        appendNumber(pending_, static_cast<std::uint32_t>(payload.size()));
+        appendNumber(pending_, crc32(payload));
+        pending_ += payload;
+        sequence = ++appended_;
+        ++records_;
+    }
+    queued_.notify_one();
+    return sequence;
+}
+
+bool MutationLog::commit(std::uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    synced_changed_.wait(lock, [&]()
+    {
+        return synced_ >= sequence or failed_;
+    });
+    return synced_ >= sequence;
+}
+
+bool MutationLog::failed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+bool MutationLog::reset()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    synced_changed_.wait(lock, [&]()
+    {
+        return synced_ == appended_ or failed_;
+    });
+    if( failed_ or ftruncate(fd_, sizeof(Header)) != 0 or fdatasync(fd_) != 0 )
+    {
+        return false;
+    }
+    records_ = 0;
+    return true;
+}
+
+std::uint64_t MutationLog::records() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_;
+}
+
+void MutationLog::flush()
+{
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while( true )
+    {
+        queued_.wait(lock, [&]()
+        {
+            return stopping_ or not pending_.empty();
+        });
+        if( pending_.empty() )
+        {
+            return;
+        }
+
+        // Everything queued so far goes to the disk with one sync, while
+        // new records are queued for the next one.
+        // After a failure nothing more is written, so that the log never
+        // has records after a missing one.
+        batch.clear();
+        batch.swap(pending_);
+        std::uint64_t last = appended_;
+        bool failed = failed_;
+        lock.unlock();
+        bool written = not failed and writeAll(fd_, batch.data(), batch.size())
+                       and fdatasync(fd_) == 0;
+        lock.lock();
+        if( written )
+        {
+            synced_ = last;
+        }
+        else
+        {
+            failed_ = true;
+        }
+        synced_changed_.notify_all();
+    }
+}
@@ -0,0 +1,131 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: mutationlog.hh                                                      #
+# Description: Append-only log of the changes made to a Familytree,         #
+#   replayed on top of the datafile at startup.                             #
+#############################################################################
+*/
+#ifndef MUTATIONLOG_HH
+#define MUTATIONLOG_HH
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The MutationLog class
+ * Keeps the changing commands in a file, so that the changes survive a
+ * restart. The file starts with a header, followed by one record per
+ * command:
+ *
+ *   length (4 bytes) | CRC-32 of the payload (4 bytes) | payload
+ *
+ * where the payload is the number of fields followed by every field as
+ * its length and its bytes. The fields are the command name and its
+ * parameters. Numbers are stored in the byte order of the machine.
+ *
+ * Appended records are written and synced by a background thread. Records
+ * appended while a sync is running are written together with the next
+ * one, so many writers share the cost of a sync (group commit).
+ */
+class MutationLog
+{
+public:
+    // Records of the log, each a list of fields. The fields view the
+    // mapped log, only until the call they are given to returns.
+    using Records = std::vector<std::vector<std::string_view>>;
+
+    // Called with the records when the log is opened, REPLAY_BATCH at a
+    // time.
+    using Replay = std::function<void(const Records& records)>;
+
+    // Most records replayed with one call.
+    static const std::size_t REPLAY_BATCH = 1 << 16;
+
+    MutationLog() = default;
+    ~MutationLog();
+
+    MutationLog(const MutationLog&) = delete;
+    MutationLog& operator=(const MutationLog&) = delete;
+
+    /**
+     * @brief open
+     * @param path of the log, created if it doesn't exist
+     * @param replay called for the records already in the log, in order
+     * @return true if the log can be appended to. A record cut short by a
+     * crash ends the log and is removed, a corrupted header fails.
+     */
+    bool open(const std::string& path, const Replay& replay);
+
+    /**
+     * @brief append
+     * @param fields
+     * @return the sequence number of the record, for commit
+     * Queue a record to be written. Doesn't wait for the disk.
+     */
+    std::uint64_t append(const std::vector<std::string>& fields);
+
+    /**
+     * @brief commit
+     * @param sequence
+     * @return true once the record and all before it are on the disk,
+     * false if writing the log failed before they got there
+     */
+    bool commit(std::uint64_t sequence);
+
+    /**
+     * @brief failed
+     * @return true if writing the log has failed, after which no record
+     * gets to the disk anymore
+     */
+    bool failed() const;
+
+    /**
+     * @brief reset
+     * @return true if the log was emptied
+     * Drop all records, once they have been folded into a new datafile.
+     */
+    bool reset();
+
+    /**
+     * @brief records
+     * @return number of records in the log, replayed or appended
+     */
+    std::uint64_t records() const;
+
+private:
+    /**
+     * @brief flush
+     * Body of the thread writing the queued records.
+     */
+    void flush();
+
+    int fd_ = -1;
+
+    // Records queued for the flushing thread
+    std::string pending_;
+
+    // Sequence numbers of the last queued and the last synced record
+    std::uint64_t appended_ = 0;
+    std::uint64_t synced_ = 0;
+
+    // Records in the file, replayed or queued
+    std::uint64_t records_ = 0;
+
+    bool failed_ = false;
+    bool stopping_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable synced_changed_;
+    std::thread flusher_;
+};
+
+#endif // MUTATIONLOG_HH
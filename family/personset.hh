@@ -0,0 +1,168 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: personset.hh                                                        #
+# Description: Set of persons of a Familytree as a bitmap, for walking and  #
+#   combining large groups of relatives.                                    #
+#############################################################################
+*/
+#ifndef PERSONSET_HH
+#define PERSONSET_HH
+
+#include "familytree.hh"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief The PersonSet class
+ * One bit per person of the tree, and a list of the 64-bit words that have
+ * had a bit set. Membership is one bit test like in a dense bitmap, while
+ * combining, counting and clearing go through the listed words only, so a
+ * small set of a large tree stays cheap. A set is meant to be kept and
+ * reused across queries: clear() leaves the bitmap allocated.
+ */
+class PersonSet
+{
+public:
+    /**
+     * @brief resize
+     * @param persons size of the tree
+     * Make room for every person of the tree. Keeps the contents.
+     */
+    void resize(std::size_t persons)
+    {
+        if( words_.size() < persons / 64 + 1 )
+        {
+            words_.resize(persons / 64 + 1, 0);
+        }
+    }
+
+    /**
+     * @brief insert
+     * @param person
+     * @return true if the person was not in the set
+     */
+    bool insert(PersonIndex person)
+    {
+        std::uint64_t& word = words_[person / 64];
+        std::uint64_t bit = std::uint64_t(1) << (person % 64);
+        if( word & bit )
+        {
+            return false;
+        }
+        if( word == 0 )
+        {
+            touched_.push_back(person / 64);
+        }
+        word |= bit;
+        return true;
+    }
+
+    /**
+     * @brief contains
+     * @param person, NO_PERSON is never in the set
+     * @return true if the person is in the set
+     */
+    bool contains(PersonIndex person) const
+    {
+        return person != NO_PERSON and (words_[person / 64] >> (person % 64) & 1);
+    }
+
+    /**
+     * @brief empty
+     * @return true if there are no persons in the set
+     */
+    bool empty() const
+    {
+        return touched_.empty();
+    }
+
+    /**
+     * @brief count
+     * @return number of persons in the set
+     */
+    std::size_t count() const
+    {
+        std::size_t total = 0;
+        for( std::uint32_t w : touched_ )
+        {
+            total += __builtin_popcountll(words_[w]);
+        }
+        return total;
+    }
+
+    /**
+     * @brief unite
+     * @param other set of the same tree
+     * Add the persons of the other set, a word at a time.
+     */
+    void unite(const PersonSet& other)
+    {
+        for( std::uint32_t w : other.touched_ )
+        {
+            if( words_[w] == 0 )
+            {
+                touched_.push_back(w);
+            }
+            words_[w] |= other.words_[w];
+        }
+    }
+
+    /**
+     * @brief subtract
+     * @param other set of the same tree
+     * Remove the persons of the other set, a word at a time.
+     */
+    void subtract(const PersonSet& other)
+    {
+        std::size_t kept = 0;
+        for( std::uint32_t w : touched_ )
+        {
+            words_[w] &= ~other.words_[w];
+            if( words_[w] != 0 )
+            {
+                touched_[kept++] = w;
+            }
+        }
+        touched_.resize(kept);
+    }
+
+    /**
+     * @brief clear
+     * Remove every person, touching only the words in use.
+     */
+    void clear()
+    {
+        for( std::uint32_t w : touched_ )
+        {
+            words_[w] = 0;
+        }
+        touched_.clear();
+    }
+
+    /**
+     * @brief forEach
+     * @param func called with every person of the set, in no particular
+     * order
+     */
+    template <typename Func>
+    void forEach(Func func) const
+    {
+        for( std::uint32_t w : touched_ )
+        {
+            for( std::uint64_t bits = words_[w]; bits != 0; bits &= bits - 1 )
+            {
+                func(PersonIndex(w * 64 + __builtin_ctzll(bits)));
+            }
+        }
+    }
+
+private:
+    std::vector<std::uint64_t> words_;
+    // Indices of the nonzero words, each once.
+    std::vector<std::uint32_t> touched_;
+};
+
+#endif // PERSONSET_HH
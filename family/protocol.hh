@@ -0,0 +1,19 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: protocol.hh                                                         #
+# Description: Protocol between the query daemon and its clients.           #
+#############################################################################
+*/
+#ifndef PROTOCOL_HH
+#define PROTOCOL_HH
+
+// A client sends command lines, each ending in '\n', to the UNIX domain
+// socket of the daemon. For every line the daemon sends back the output of
+// the command, exactly as the interactive program prints it, followed by
+// END_OF_RESPONSE. The exit command gets no response, the daemon closes
+// the connection instead.
+const char END_OF_RESPONSE = '\0';
+
+#endif // PROTOCOL_HH
@@ -0,0 +1,94 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: queryexecutor.cpp                                                   #
+# Description: Runs many command lines at once on a thread pool and prints  #
+#   the results in the order of the lines.                                  #
+# Notes: * Check the queryexecutor.hh for more info.                        #
+#############################################################################
+*/
+#include "queryexecutor.hh"
+#include "stringsink.hh"
+
+QueryExecutor::QueryExecutor(const Cli& cli, unsigned int threads):
+    cli_(cli), pool_(threads)
+{
+}
+
+bool QueryExecutor::run(const std::vector<std::string>& lines, std::ostream& output)
+{
+    std::size_t begin = 0;
+    while( begin < lines.size() )
+    {
+        // The lines up to the next change or the exit command only read,
+        // so they run in parallel. A change runs alone, so that the lines
+        // after it see it and the ones before it don't.
+        std::size_t end = begin;
+        const CommandInfo* command = nullptr;
+        while( end < lines.size() )
+        {
+            command = cli_.commandOf(lines.at(end));
+            if( command != nullptr and (command->kind_ == CommandKind::QUIT or command->mutatorPtr_ != nullptr) )
+            {
+                break;
+            }
+            ++end;
+        }
+        runParallel(lines, begin, end, output);
+        if( end == lines.size() )
+        {
+            return true;
+        }
+        if( command->kind_ == CommandKind::QUIT )
+        {
+            return false;
+        }
+        cli_.execute(lines.at(end), output);
+        begin = end + 1;
+    }
+    return true;
+}
+
+void QueryExecutor::runParallel(const std::vector<std::string>& lines,
+                                std::size_t begin, std::size_t end,
+                                std::ostream& output)
+{
+    if( results_.size() < end - begin )
+    {
+        results_.resize(end - begin);
+    }
+    pool_.forEach(end - begin, [this, &lines, begin](std::size_t line)
+    {
+        // One stream per thread, pointed to the buffer of the line.
+        thread_local StringSink sink;
+        thread_local std::ostream stream(&sink);
+        results_[line].clear();
+        sink.setTarget(&results_[line]);
+        cli_.execute(lines[begin + line], stream);
+    });
+
+    for( std::size_t line = 0; line < end - begin; ++line )
+    {
+        output << results_.at(line);
+    }
+}
+
+void QueryExecutor::runStream(std::istream& input, std::ostream& output)
+{
+    std::vector<std::string> lines(BLOCK_LINES);
+    while( true )
+    {
+        std::size_t count = 0;
+        while( count < BLOCK_LINES and std::getline(input, lines.at(count)) )
+        {
+            ++count;
+        }
+        lines.resize(count);
+        if( not run(lines, output) or count < BLOCK_LINES )
+        {
+            return;
+        }
+        lines.resize(BLOCK_LINES);
+    }
+}
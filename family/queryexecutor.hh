@@ -0,0 +1,80 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: queryexecutor.hh                                                    #
+# Description: Runs many command lines at once on a thread pool and prints  #
+#   the results in the order of the lines.                                  #
+#############################################################################
+*/
+#ifndef QUERYEXECUTOR_HH
+#define QUERYEXECUTOR_HH
+
+#include "cli.hh"
+#include "threadpool.hh"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The QueryExecutor class
+ * Executes command lines in parallel against the tree of a Cli. Every line
+ * prints to a buffer of its own, and the buffers are written out in the
+ * order of the lines, so the output is the same as when executing the
+ * lines one by one. Lines changing the tree are executed alone, between
+ * the lines before and after them.
+ */
+class QueryExecutor
+{
+public:
+    /**
+     * @brief QueryExecutor
+     * @param cli interface whose commands are executed, must outlive the
+     * executor
+     * @param threads number of threads executing the lines
+     */
+    QueryExecutor(const Cli& cli, unsigned int threads);
+
+    /**
+     * @brief run
+     * @param lines command lines
+     * @param output
+     * @return false if the lines contained the exit command, the lines
+     * after it are not executed
+     */
+    bool run(const std::vector<std::string>& lines, std::ostream& output);
+
+    /**
+     * @brief runStream
+     * @param input
+     * @param output
+     * Execute the lines of the input in blocks of BLOCK_LINES until the exit
+     * command or the end of the input.
+     */
+    void runStream(std::istream& input, std::ostream& output);
+
+    // Number of lines read and executed at a time by runStream.
+    static const std::size_t BLOCK_LINES = 1 << 14;
+
+private:
+    /**
+     * @brief runParallel
+     * @param lines
+     * @param begin first line to execute
+     * @param end line after the last one to execute
+     * @param output
+     * Execute the lines, none of which change the tree, in parallel.
+     */
+    void runParallel(const std::vector<std::string>& lines, std::size_t begin,
+                     std::size_t end, std::ostream& output);
+
+    const Cli& cli_;
+    ThreadPool pool_;
+
+    // Output of every line of the current block, reused between blocks.
+    std::vector<std::string> results_;
+};
+
+#endif // QUERYEXECUTOR_HH
@@ -0,0 +1,140 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: querystats.cpp                                                      #
+# Description: Counts and latency histograms of the commands, and the sizes #
+#   of their results and traversals.                                        #
+# Notes: * Check the querystats.hh for more info.                           #
+#############################################################################
+*/
+#include "querystats.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+QueryStats::QueryStats(std::vector<std::string> names) :
+    names_(std::move(names)), commands_(new Command[names_.size()])
+{
+}
+
+void QueryStats::record(std::size_t command, std::uint64_t nanoseconds,
+                        std::uint64_t results, std::uint64_t visited)
+{
+    Command& stats = commands_[command];
+    stats.count_.fetch_add(1, std::memory_order_relaxed);
+    stats.results_.fetch_add(results, std::memory_order_relaxed);
+    stats.visited_.fetch_add(visited, std::memory_order_relaxed);
+    stats.buckets_[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    std::uint64_t longest = stats.max_.load(std::memory_order_relaxed);
+    while( longest < nanoseconds
+           and not stats.max_.compare_exchange_weak(longest, nanoseconds, std::memory_order_relaxed) )
+    {
+    }
+}
+
+void QueryStats::print(std::ostream& output) const
+{
+    bool any = false;
+    for( std::size_t i = 0; i < names_.size(); ++i )
+    {
+        const Command& stats = commands_[i];
+        std::uint64_t count = stats.count_.load();
+        if( count == 0 )
+        {
+            continue;
+        }
+        any = true;
+        output << names_.at(i) << ": " << count << " queries, p50 "
+               << percentile(stats, 0.5) / 1e3 << " us, p99 "
+               << percentile(stats, 0.99) / 1e3 << " us, p999 "
+               << percentile(stats, 0.999) / 1e3 << " us, max "
+               << stats.max_.load() / 1e3 << " us, "
+               << double(stats.results_.load()) / count << " results and "
+               << double(stats.visited_.load()) / count << " visited per query." << '\n';
+    }
+    if( not any )
+    {
+        output << "No queries yet." << '\n';
+    }
+}
+
+void QueryStats::printJson(std::ostream& output) const
+{
+    output << "{\"commands\":[";
+    bool first = true;
+    for( std::size_t i = 0; i < names_.size(); ++i )
+    {
+        const Command& stats = commands_[i];
+        std::uint64_t count = stats.count_.load();
+        if( count == 0 )
+        {
+            continue;
+        }
+        output << (first ? "" : ",") << "{\"command\":\"" << names_.at(i)
+               << "\",\"count\":" << count
+               << ",\"p50_ns\":" << percentile(stats, 0.5)
+               << ",\"p99_ns\":" << percentile(stats, 0.99)
+               << ",\"p999_ns\":" << percentile(stats, 0.999)
+               << ",\"max_ns\":" << stats.max_.load()
+               << ",\"results\":" << stats.results_.load()
+               << ",\"visited\":" << stats.visited_.load() << "}";
+        first = false;
+    }
+    output << "]}" << '\n';
+}
+
+std::uint64_t& QueryStats::visited()
+{
+    thread_local std::uint64_t visited = 0;
+    return visited;
+}
+
+std::uint64_t& QueryStats::results()
+{
+    thread_local std::uint64_t results = 0;
+    return results;
+}
+
+int QueryStats::bucketOf(std::uint64_t nanoseconds)
+{
+    if( nanoseconds < SUB_BUCKETS )
+    {
+        return int(nanoseconds);
+    }
+    // The highest bit picks the group, the next SUB_BITS the bucket in it.
+    int power = 63 - __builtin_clzll(nanoseconds);
+    int group = std::min(power - SUB_BITS + 1, POWERS - SUB_BITS);
+    int shift = group - 1;
+    std::uint64_t sub = std::min<std::uint64_t>(nanoseconds >> shift, 2 * SUB_BUCKETS - 1);
+    return group * SUB_BUCKETS + int(sub) - SUB_BUCKETS;
+}
+
+std::uint64_t QueryStats::highestOf(int bucket)
+{
+    if( bucket < SUB_BUCKETS )
+    {
+        return std::uint64_t(bucket);
+    }
+    int group = bucket / SUB_BUCKETS;
+    std::uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+    int shift = group - 1;
+    return ((sub + 1) << shift) - 1;
+}
+
+std::uint64_t QueryStats::percentile(const Command& command, double share) const
+{
+    std::uint64_t count = command.count_.load();
+    std::uint64_t rank = std::max<std::uint64_t>(1, std::uint64_t(std::ceil(share * count)));
+    std::uint64_t seen = 0;
+    for( int bucket = 0; bucket < BUCKETS; ++bucket )
+    {
+        seen += command.buckets_[bucket].load(std::memory_order_relaxed);
+        if( seen >= rank )
+        {
+            return std::min(highestOf(bucket), command.max_.load());
+        }
+    }
+    return command.max_.load();
+}
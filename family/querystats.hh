@@ -0,0 +1,137 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: querystats.hh                                                       #
+# Description: Counts and latency histograms of the commands, and the sizes #
+#   of their results and traversals.                                        #
+# Notes: * Compiled out with FAMILY_NO_STATS.                               #
+#############################################################################
+*/
+#ifndef QUERYSTATS_HH
+#define QUERYSTATS_HH
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The Familytree queries report their work with these. Without
+// FAMILY_NO_STATS they add to counters of the thread, which the Cli reads
+// after every command; with it they compile to nothing.
+#ifndef FAMILY_NO_STATS
+#define STATS_VISITED(persons) (QueryStats::visited() += (persons))
+#define STATS_RESULTS(persons) (QueryStats::results() += (persons))
+#else
+#define STATS_VISITED(persons) ((void)0)
+#define STATS_RESULTS(persons) ((void)0)
+#endif
+
+/**
+ * @brief The QueryStats class
+ * Statistics of every command: how many times it was run, a histogram of
+ * its latencies, and the persons in its results and visited by its
+ * traversals. Recording is a few relaxed atomic additions, so many threads
+ * can record at once.
+ *
+ * The histogram is HDR style: the latencies in nanoseconds are grouped by
+ * their highest bit, and every group is split into SUB_BUCKETS linear
+ * buckets, so a percentile is off by at most 1 / SUB_BUCKETS of itself.
+ */
+class QueryStats
+{
+public:
+    /**
+     * @brief QueryStats
+     * @param names of the commands, recorded by their number in this list
+     */
+    explicit QueryStats(std::vector<std::string> names);
+
+    QueryStats(const QueryStats&) = delete;
+    QueryStats& operator=(const QueryStats&) = delete;
+
+    /**
+     * @brief record
+     * @param command number of the command
+     * @param nanoseconds the command took
+     * @param results persons in the result, see STATS_RESULTS
+     * @param visited persons visited, see STATS_VISITED
+     */
+    void record(std::size_t command, std::uint64_t nanoseconds,
+                std::uint64_t results, std::uint64_t visited);
+
+    /**
+     * @brief print
+     * @param output
+     * Print a line for every command run so far.
+     */
+    void print(std::ostream& output) const;
+
+    /**
+     * @brief printJson
+     * @param output
+     * Print every command run so far as one JSON object.
+     */
+    void printJson(std::ostream& output) const;
+
+    /**
+     * @brief visited
+     * @return the persons visited by the current command of the thread
+     */
+    static std::uint64_t& visited();
+
+    /**
+     * @brief results
+     * @return the persons in the result of the current command of the
+     * thread
+     */
+    static std::uint64_t& results();
+
+private:
+    // Linear buckets per power of two, and the powers of two covered,
+    // up to about 18 minutes.
+    static const int SUB_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int POWERS = 40;
+    static const int BUCKETS = (POWERS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    struct Command
+    {
+        std::atomic<std::uint64_t> count_{0};
+        std::atomic<std::uint64_t> results_{0};
+        std::atomic<std::uint64_t> visited_{0};
+        std::atomic<std::uint64_t> max_{0};
+        std::array<std::atomic<std::uint64_t>, BUCKETS> buckets_{};
+    };
+
+    /**
+     * @brief bucketOf
+     * @param nanoseconds
+     * @return the histogram bucket of the latency
+     */
+    static int bucketOf(std::uint64_t nanoseconds);
+
+    /**
+     * @brief highestOf
+     * @param bucket
+     * @return the highest latency in the bucket
+     */
+    static std::uint64_t highestOf(int bucket);
+
+    /**
+     * @brief percentile
+     * @param command
+     * @param share of the runs, e.g. 0.99
+     * @return the latency share of the runs took at most
+     */
+    std::uint64_t percentile(const Command& command, double share) const;
+
+    std::vector<std::string> names_;
+    std::unique_ptr<Command[]> commands_;
+};
+
+#endif // QUERYSTATS_HH
@@ -0,0 +1,140 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: resultcache.cpp                                                     #
+# Description: Cache of the printed results of the queries about a person,  #
+#   dropped when the relations near the person change.                      #
+# Notes: * Check the resultcache.hh for more info.                          #
+#############################################################################
+*/
+#include "resultcache.hh"
+
+#include <algorithm>
+#include <functional>
+
+ResultCache::ResultCache(std::size_t capacity) :
+    shards_(new Shard[SHARDS]), shard_capacity_(std::max<std::size_t>(1, capacity / SHARDS))
+{
+}
+
+std::shared_ptr<const std::string> ResultCache::find(const std::string& key)
+{
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    auto found = shard.index_.find(key);
+    if( found == shard.index_.end() )
+    {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    shard.entries_.splice(shard.entries_.begin(), shard.entries_, found->second);
+    return found->second->result_;
+}
+
+std::uint64_t ResultCache::generation() const
+{
+    return generation_.load();
+}
+
+void ResultCache::insert(const std::string& key, std::string result, PersonIndex subject,
+                         unsigned int radius, std::uint64_t generation)
+{
+    if( radius > MAX_RADIUS )
+    {
+        return;
+    }
+
+    // The radius is raised before the generation is checked, so a change
+    // that bumps the generation after the check looks far enough.
+    unsigned int largest = radius_.load();
+    while( largest < radius and not radius_.compare_exchange_weak(largest, radius) )
+    {
+    }
+
+    std::shared_ptr<const std::string> shared = std::make_shared<const std::string>(std::move(result));
+    Shard& shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex_);
+    if( generation != generation_.load() or shard.index_.count(key) != 0 )
+    {
+        return;
+    }
+    shard.entries_.push_front({key, shared, subject, radius});
+    shard.index_.emplace(shard.entries_.front().key_, shard.entries_.begin());
+    ++entries_;
+    if( shard.entries_.size() > shard_capacity_ )
+    {
+        drop(shard, std::prev(shard.entries_.end()));
+    }
+}
+
+void ResultCache::invalidate(const Familytree& tree, const std::vector<PersonIndex>& changed)
+{
+    // Results computed from older versions are no longer added from now on,
+    // the ones added already are dropped below.
+    ++generation_;
+    std::vector<std::pair<PersonIndex, unsigned int>> nearby;
+    if( changed.empty() )
+    {
+        return;
+    }
+    if( not tree.nearbyPersons(changed, radius_.load(), MAX_NEARBY, nearby) )
+    {
+        dropAll();
+        return;
+    }
+
+    std::unordered_map<PersonIndex, unsigned int> steps(nearby.begin(), nearby.end());
+    for( std::size_t s = 0; s < SHARDS; ++s )
+    {
+        Shard& shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        for( auto entry = shard.entries_.begin(); entry != shard.entries_.end(); )
+        {
+            auto near = steps.find(entry->subject_);
+            auto next = std::next(entry);
+            if( near != steps.end() and near->second <= entry->radius_ )
+            {
+                drop(shard, entry);
+                ++invalidated_;
+            }
+            entry = next;
+        }
+    }
+}
+
+ResultCache::Stats ResultCache::stats() const
+{
+    Stats stats;
+    stats.entries_ = entries_.load();
+    stats.hits_ = hits_.load();
+    stats.misses_ = misses_.load();
+    stats.invalidated_ = invalidated_.load();
+    return stats;
+}
+
+ResultCache::Shard& ResultCache::shardOf(const std::string& key)
+{
+    return shards_[std::hash<std::string>()(key) % SHARDS];
+}
+
+void ResultCache::drop(Shard& shard, std::list<Entry>::iterator entry)
+{
+    shard.index_.erase(entry->key_);
+    shard.entries_.erase(entry);
+    --entries_;
+}
+
+void ResultCache::dropAll()
+{
+    for( std::size_t s = 0; s < SHARDS; ++s )
+    {
+        Shard& shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        invalidated_ += shard.entries_.size();
+        entries_ -= shard.entries_.size();
+        shard.index_.clear();
+        shard.entries_.clear();
+    }
+}
@@ -0,0 +1,165 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: resultcache.hh                                                      #
+# Description: Cache of the printed results of the queries about a person,  #
+#   dropped when the relations near the person change.                      #
+#############################################################################
+*/
+#ifndef RESULTCACHE_HH
+#define RESULTCACHE_HH
+
+#include "familytree.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The ResultCache class
+ * Least recently used results of queries, keyed by the command and its
+ * parameters. Every result is about a subject person and depends only on
+ * the relations at most a radius of parent or child steps away from it.
+ * When relations change, the results whose subject is that near one of
+ * the changed persons are dropped, and the rest stay. Adding a person
+ * without relations changes no result.
+ *
+ * The keys are spread over shards, each with a lock and a list in the
+ * order of use. A result computed from a version of the tree older than
+ * the last change is not added, see generation().
+ */
+class ResultCache
+{
+public:
+    // Counters of the cache.
+    struct Stats
+    {
+        std::size_t entries_ = 0;
+        std::uint64_t hits_ = 0;
+        std::uint64_t misses_ = 0;
+        std::uint64_t invalidated_ = 0;
+    };
+
+    /**
+     * @brief ResultCache
+     * @param capacity most results kept, at least one per shard
+     */
+    explicit ResultCache(std::size_t capacity);
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /**
+     * @brief find
+     * @param key
+     * @return the result of the key, or nullptr if it isn't cached
+     * Counts a hit or a miss.
+     */
+    std::shared_ptr<const std::string> find(const std::string& key);
+
+    /**
+     * @brief generation
+     * @return number of changes so far. Read before reading the tree a
+     * result is computed from, and given to insert.
+     */
+    std::uint64_t generation() const;
+
+    /**
+     * @brief insert
+     * @param key
+     * @param result
+     * @param subject person the result is about
+     * @param radius steps from the subject the result depends on
+     * @param generation read before computing the result
+     * Add the result, unless the tree has changed since the generation or
+     * the radius is over MAX_RADIUS.
+     */
+    void insert(const std::string& key, std::string result, PersonIndex subject,
+                unsigned int radius, std::uint64_t generation);
+
+    /**
+     * @brief invalidate
+     * @param tree version with the change
+     * @param changed persons whose parents or children changed
+     * Drop the results about the persons that are no further from a change
+     * than their radius, or every result if too many persons are that near.
+     */
+    void invalidate(const Familytree& tree, const std::vector<PersonIndex>& changed);
+
+    // Largest radius of a cached result.
+    static const unsigned int MAX_RADIUS = 12;
+
+    // Most persons near a change looked at before dropping every result.
+    static const std::size_t MAX_NEARBY = 1 << 14;
+
+    /**
+     * @brief stats
+     * @return the counters so far
+     */
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        std::string key_;
+        std::shared_ptr<const std::string> result_;
+        PersonIndex subject_;
+        unsigned int radius_;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex_;
+        // Most recently used first.
+        std::list<Entry> entries_;
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    };
+
+    /**
+     * @brief shardOf
+     * @param key
+     * @return the shard of the key
+     */
+    Shard& shardOf(const std::string& key);
+
+    /**
+     * @brief drop
+     * @param shard, locked
+     * @param entry
+     * Remove the entry from the shard.
+     */
+    void drop(Shard& shard, std::list<Entry>::iterator entry);
+
+    /**
+     * @brief dropAll
+     * Remove every entry.
+     */
+    void dropAll();
+
+    static const std::size_t SHARDS = 16;
+
+    std::unique_ptr<Shard[]> shards_;
+    std::size_t shard_capacity_;
+
+    // Changes so far, bumped before the results are dropped.
+    std::atomic<std::uint64_t> generation_{0};
+    // Largest radius of the results added so far, raised before the
+    // generation of a result is checked.
+    std::atomic<unsigned int> radius_{0};
+
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> invalidated_{0};
+    std::atomic<std::size_t> entries_{0};
+};
+
+#endif // RESULTCACHE_HH
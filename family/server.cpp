@@ -0,0 +1,471 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: server.cpp                                                          #
+# Description: Query daemon serving the commands of the Cli to many clients #
+#   over a UNIX domain socket.                                              #
+# Notes: * Check the server.hh for more info.                               #
+#############################################################################
+*/
+#include "server.hh"
+#include "protocol.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+// Events handled per epoll_wait.
+const int MAX_EVENTS = 64;
+
+// Fewest worker threads, so that a long query doesn't hold up a change.
+const unsigned int MIN_WORKERS = 2;
+
+// Reply to a line whose command failed, e.g. ran out of memory.
+const std::string COMMAND_FAILED = "Error. The command could not be completed.";
+
+/**
+ * @brief socketAddress
+ * @param path
+ * @param address filled with the path
+ * @return false if the path doesn't fit to the address
+ */
+bool socketAddress(const std::string& path, sockaddr_un& address)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if( path.empty() or path.size() >= sizeof(address.sun_path) )
+    {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+}
+
+Server::Server(const Cli& cli):
+    cli_(cli)
+{
+}
+
+Server::~Server()
+{
+    // The workers finish their jobs before the descriptors they wake the
+    // loop through are closed.
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex_);
+        stopping_ = true;
+    }
+    job_queued_.notify_all();
+    for( std::thread& worker : workers_ )
+    {
+        worker.join();
+    }
+    if( wake_fd_ >= 0 )
+    {
+        ::close(wake_fd_);
+    }
+    while( not connections_.empty() )
+    {
+        close(connections_.begin()->first);
+    }
+    if( listen_fd_ >= 0 )
+    {
+        ::close(listen_fd_);
+        unlink(path_.c_str());
+    }
+    if( signal_fd_ >= 0 )
+    {
+        ::close(signal_fd_);
+    }
+    if( epoll_fd_ >= 0 )
+    {
+        ::close(epoll_fd_);
+    }
+}
+
+bool Server::listen(const std::string& path)
+{
+    sockaddr_un address;
+    if( listen_fd_ >= 0 or not socketAddress(path, address) )
+    {
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if( fd < 0 )
+    {
+        return false;
+    }
+
+    // A socket left behind by a daemon that died is removed, one that
+    // still answers is not.
+    struct stat info;
+    if( stat(path.c_str(), &info) == 0 and S_ISSOCK(info.st_mode) )
+    {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool alive = probe >= 0
+                     and connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if( probe >= 0 )
+        {
+            ::close(probe);
+        }
+        if( not alive )
+        {
+            unlink(path.c_str());
+        }
+    }
+
+    if( bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        or ::listen(fd, SOMAXCONN) != 0 )
+    {
+        ::close(fd);
+        return false;
+    }
+    listen_fd_ = fd;
+    path_ = path;
+    return true;
+}
+
+bool Server::run()
+{
+    if( listen_fd_ < 0 )
+    {
+        return false;
+    }
+
+    // SIGINT and SIGTERM are read from a descriptor, so that they stop the
+    // loop between events.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    if( sigprocmask(SIG_BLOCK, &signals, nullptr) != 0 )
+    {
+        return false;
+    }
+    signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if( signal_fd_ < 0 or epoll_fd_ < 0 or wake_fd_ < 0 )
+    {
+        return false;
+    }
+    for( int fd : {listen_fd_, signal_fd_, wake_fd_} )
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if( epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0 )
+        {
+            return false;
+        }
+    }
+    unsigned int workers = std::max(MIN_WORKERS, std::thread::hardware_concurrency());
+    for( unsigned int i = 0; i < workers; ++i )
+    {
+        workers_.emplace_back(&Server::work, this);
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while( true )
+    {
+        int count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if( count < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            return false;
+        }
+        for( int i = 0; i < count; ++i )
+        {
+            int fd = events[i].data.fd;
+            if( fd == signal_fd_ )
+            {
+                return true;
+            }
+            if( fd == listen_fd_ )
+            {
+                accept();
+                continue;
+            }
+            if( fd == wake_fd_ )
+            {
+                if( not finishJobs() )
+                {
+                    return false;
+                }
+                continue;
+            }
+            auto connection = connections_.find(fd);
+            if( connection == connections_.end() )
+            {
+                continue;
+            }
+            bool readable = events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP);
+            if( not serve(fd, connection->second, readable) )
+            {
+                close(fd);
+            }
+        }
+    }
+}
+
+void Server::accept()
+{
+    while( true )
+    {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if( fd < 0 )
+        {
+            // EAGAIN when all are accepted. Other errors, such as running
+            // out of descriptors, are retried on the next event.
+            return;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        if( epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0 )
+        {
+            ::close(fd);
+            continue;
+        }
+        connections_[fd].id_ = ++connections_accepted_;
+    }
+}
+
+bool Server::serve(int fd, Connection& connection, bool readable)
+{
+    // Read everything available, unless the client is behind in reading
+    // the output.
+    while( readable and not connection.input_closed_ and not connection.closing_
+           and connection.output_.size() - connection.written_ < MAX_PENDING_OUTPUT )
+    {
+        char buffer[1 << 14];
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if( received < 0 and errno == EINTR )
+        {
+            continue;
+        }
+        if( received < 0 and (errno == EAGAIN or errno == EWOULDBLOCK) )
+        {
+            break;
+        }
+        if( received < 0 )
+        {
+            return false;
+        }
+        if( received == 0 )
+        {
+            // A last line without a newline is executed too, the same as
+            // in batch mode.
+            connection.input_closed_ = true;
+            if( not connection.input_.empty() and connection.input_.back() != '\n' )
+            {
+                connection.input_ += '\n';
+            }
+            break;
+        }
+        connection.input_.append(buffer, static_cast<std::size_t>(received));
+        if( connection.input_.size() > MAX_LINE_LENGTH
+            and connection.input_.find('\n') == std::string::npos )
+        {
+            return false;
+        }
+        execute(fd, connection);
+    }
+
+    // Also the lines left unexecuted earlier because of pending output.
+    execute(fd, connection);
+
+    while( connection.written_ < connection.output_.size() )
+    {
+        ssize_t sent = send(fd, connection.output_.data() + connection.written_,
+                            connection.output_.size() - connection.written_, MSG_NOSIGNAL);
+        if( sent < 0 and errno == EINTR )
+        {
+            continue;
+        }
+        if( sent < 0 and (errno == EAGAIN or errno == EWOULDBLOCK) )
+        {
+            break;
+        }
+        if( sent < 0 )
+        {
+            return false;
+        }
+        connection.written_ += static_cast<std::size_t>(sent);
+    }
+    if( connection.written_ == connection.output_.size() )
+    {
+        connection.output_.clear();
+        connection.written_ = 0;
+    }
+
+    bool finished = connection.closing_
+                    or (connection.input_closed_ and connection.input_.empty()
+                        and not connection.busy_);
+    if( finished and connection.output_.empty() )
+    {
+        return false;
+    }
+    return watch(fd, connection);
+}
+
+void Server::execute(int fd, Connection& connection)
+{
+    sink_.setTarget(&connection.output_);
+    std::size_t begin = 0;
+    while( not connection.closing_ and not connection.busy_
+           and connection.output_.size() - connection.written_ < MAX_PENDING_OUTPUT )
+    {
+        std::size_t end = connection.input_.find('\n', begin);
+        if( end == std::string::npos )
+        {
+            break;
+        }
+        std::string line = connection.input_.substr(begin, end - begin);
+        begin = end + 1;
+
+        // A change or a long query is left to a worker, and the lines after
+        // it wait for its reply.
+        const CommandInfo* command = cli_.commandOf(line);
+        if( command != nullptr and (command->mutatorPtr_ != nullptr or command->long_) )
+        {
+            {
+                std::lock_guard<std::mutex> lock(jobs_mutex_);
+                queued_jobs_.push_back({fd, connection.id_, std::move(line), {}});
+            }
+            job_queued_.notify_one();
+            connection.busy_ = true;
+            break;
+        }
+        if( not respond(line, output_, connection.output_) )
+        {
+            connection.closing_ = true;
+        }
+    }
+    connection.input_.erase(0, begin);
+}
+
+bool Server::respond(const std::string& line, std::ostream& output, std::string& reply) const
+{
+    // A failing command gets an error instead of its partial output, and
+    // the other clients are not affected.
+    std::size_t response_begin = reply.size();
+    bool go_on = true;
+    try
+    {
+        go_on = cli_.execute(line, output, true);
+    }
+    catch( const std::exception& )
+    {
+        output.clear();
+        reply.resize(response_begin);
+        reply += COMMAND_FAILED + '\n';
+    }
+    if( go_on )
+    {
+        reply += END_OF_RESPONSE;
+    }
+    return go_on;
+}
+
+void Server::work()
+{
+    StringSink sink;
+    std::ostream output(&sink);
+    std::unique_lock<std::mutex> lock(jobs_mutex_);
+    while( true )
+    {
+        job_queued_.wait(lock, [this]()
+        {
+            return stopping_ or not queued_jobs_.empty();
+        });
+        if( queued_jobs_.empty() )
+        {
+            return;
+        }
+        Job job = std::move(queued_jobs_.front());
+        queued_jobs_.pop_front();
+        lock.unlock();
+
+        sink.setTarget(&job.reply_);
+        job.go_on_ = respond(job.line_, output, job.reply_);
+
+        lock.lock();
+        finished_jobs_.push_back(std::move(job));
+        // Fails only if the counter is full, when the loop is woken anyway.
+        std::uint64_t one = 1;
+        ssize_t written = write(wake_fd_, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+bool Server::finishJobs()
+{
+    std::uint64_t count;
+    if( read(wake_fd_, &count, sizeof(count)) < 0 and errno != EAGAIN )
+    {
+        return false;
+    }
+    std::vector<Job> finished;
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex_);
+        finished.swap(finished_jobs_);
+    }
+
+    // The reply of a client that has gone meanwhile is dropped.
+    for( Job& job : finished )
+    {
+        auto connection = connections_.find(job.fd_);
+        if( connection == connections_.end() or connection->second.id_ != job.id_ )
+        {
+            continue;
+        }
+        connection->second.output_ += job.reply_;
+        connection->second.busy_ = false;
+        connection->second.closing_ = not job.go_on_;
+        if( not serve(job.fd_, connection->second, false) )
+        {
+            close(job.fd_);
+        }
+    }
+    return true;
+}
+
+bool Server::watch(int fd, const Connection& connection)
+{
+    epoll_event event{};
+    event.data.fd = fd;
+    event.events = 0;
+    if( not connection.output_.empty() )
+    {
+        event.events |= EPOLLOUT;
+    }
+    if( not connection.input_closed_ and not connection.closing_
+        and connection.output_.size() - connection.written_ < MAX_PENDING_OUTPUT )
+    {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void Server::close(int fd)
+{
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+}
@@ -0,0 +1,197 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: server.hh                                                           #
+# Description: Query daemon serving the commands of the Cli to many clients #
+#   over a UNIX domain socket.                                              #
+# Notes: * The protocol is described in protocol.hh.                        #
+#############################################################################
+*/
+#ifndef SERVER_HH
+#define SERVER_HH
+
+#include "cli.hh"
+#include "stringsink.hh"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The Server class
+ * Single-threaded event loop on epoll. Every connection has an input and
+ * an output buffer, and a connection is only looked at when the socket is
+ * ready, so idle clients cost nothing but their buffers.
+ *
+ * Quick queries are executed by the loop itself. The commands changing the
+ * tree, which wait for the log, and the long queries go to worker threads,
+ * and the loop serves the other clients meanwhile. The connection waits
+ * for the reply before its next line is executed, so the replies keep the
+ * order of the lines.
+ */
+class Server
+{
+public:
+    /**
+     * @brief Server
+     * @param cli interface whose commands are served, must outlive the
+     * server
+     */
+    explicit Server(const Cli& cli);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    /**
+     * @brief listen
+     * @param path of the socket, replaced if a stale one exists
+     * @return true if the socket could be created
+     */
+    bool listen(const std::string& path);
+
+    /**
+     * @brief run
+     * @return true if the server was stopped by SIGINT or SIGTERM, false
+     * if the event loop failed
+     * Serve the clients until stopped.
+     */
+    bool run();
+
+    // Largest line accepted from a client.
+    static const std::size_t MAX_LINE_LENGTH = 1 << 16;
+
+    // Output pending for a client after which its input is not read until
+    // the client has read some of the output.
+    static const std::size_t MAX_PENDING_OUTPUT = 1 << 20;
+
+private:
+    // Buffers of one client.
+    struct Connection
+    {
+        std::string input_;
+        std::string output_;
+        std::size_t written_ = 0;
+
+        // The client has closed its end for writing.
+        bool input_closed_ = false;
+
+        // The exit command was received, nothing more is executed.
+        bool closing_ = false;
+
+        // Number of the connection, not reused like the descriptor.
+        std::uint64_t id_ = 0;
+
+        // A line is being executed by a worker.
+        bool busy_ = false;
+    };
+
+    // Line given to a worker, and its reply.
+    struct Job
+    {
+        int fd_;
+        std::uint64_t id_;
+        std::string line_;
+        std::string reply_;
+        bool go_on_ = true;
+    };
+
+    /**
+     * @brief accept
+     * Accept all pending connections.
+     */
+    void accept();
+
+    /**
+     * @brief serve
+     * @param fd socket of the client
+     * @param connection
+     * @param readable true if the socket has input or was closed
+     * @return false if the connection is to be closed
+     * Read the input, execute the complete lines and send the output.
+     */
+    bool serve(int fd, Connection& connection, bool readable);
+
+    /**
+     * @brief execute
+     * @param fd socket of the client
+     * @param connection
+     * Execute the complete lines of the input while the pending output is
+     * below MAX_PENDING_OUTPUT, until a line is given to a worker.
+     */
+    void execute(int fd, Connection& connection);
+
+    /**
+     * @brief respond
+     * @param line
+     * @param output stream printing to reply
+     * @param reply the response to the line is appended to
+     * @return false for the exit command
+     * Execute the line, replacing the output of a failed command with an
+     * error.
+     */
+    bool respond(const std::string& line, std::ostream& output, std::string& reply) const;
+
+    /**
+     * @brief work
+     * Body of the worker threads: execute the queued jobs and hand the
+     * replies back to the loop.
+     */
+    void work();
+
+    /**
+     * @brief finishJobs
+     * @return false if epoll failed
+     * Add the replies of the finished jobs to their connections, and go on
+     * serving them.
+     */
+    bool finishJobs();
+
+    /**
+     * @brief watch
+     * @param fd
+     * @param connection
+     * @return false if epoll failed
+     * Wait for input, output space or both, depending on the buffers.
+     */
+    bool watch(int fd, const Connection& connection);
+
+    /**
+     * @brief close
+     * @param fd
+     * Close a client connection and drop its buffers.
+     */
+    void close(int fd);
+
+    const Cli& cli_;
+    int epoll_fd_ = -1;
+    int listen_fd_ = -1;
+    int signal_fd_ = -1;
+    std::string path_;
+    std::unordered_map<int, Connection> connections_;
+    std::uint64_t connections_accepted_ = 0;
+
+    // Jobs waiting for a worker and finished ones waiting for the loop,
+    // which the workers wake through wake_fd_.
+    std::mutex jobs_mutex_;
+    std::condition_variable job_queued_;
+    std::deque<Job> queued_jobs_;
+    std::vector<Job> finished_jobs_;
+    bool stopping_ = false;
+    int wake_fd_ = -1;
+    std::vector<std::thread> workers_;
+
+    // Stream the commands print to, pointed to the output of a connection.
+    StringSink sink_;
+    std::ostream output_{&sink_};
+};
+
+#endif // SERVER_HH
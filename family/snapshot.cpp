@@ -0,0 +1,267 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: snapshot.cpp                                                        #
+# Description: Binary snapshot files of a Familytree.                       #
+# Notes: * Check the snapshot.hh for more info.                             #
+#############################################################################
+*/
+#include "snapshot.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+const char MAGIC[8] = {'F', 'A', 'M', 'T', 'R', 'E', 'E', '\0'};
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+const std::size_t SECTION_ALIGNMENT = 8;
+
+// Number of temporary files written by this process.
+std::atomic<unsigned int> temporary_files{0};
+
+enum Sections { ID_CHARS, ID_OFFSETS, HEIGHTS, PARENTS,
+                CHILD_OFFSETS, CHILD_LIST, ID_TABLE, TALLEST, SHORTEST,
+                ID_ORDER, ID_RANK, HEIGHT_ORDER, SECTIONS };
+
+// Place of a column in the file.
+struct Section
+{
+    std::uint64_t offset_;
+    std::uint64_t count_;
+};
+
+// Beginning of every snapshot file.
+struct Header
+{
+    char magic_[sizeof(MAGIC)];
+    std::uint32_t version_;
+    std::uint32_t byte_order_;
+    std::uint64_t persons_;
+    Section sections_[SECTIONS];
+};
+
+/**
+ * @brief alignUp
+ * @param offset
+ * @return the offset rounded up to SECTION_ALIGNMENT
+ */
+std::uint64_t alignUp(std::uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+/**
+ * @brief addSection
+ * @param header
+ * @param section
+ * @param column
+ * @param file_size: end of the file so far, moved past the section
+ * Place the column to the end of the file.
+ */
+template <typename Values>
+void addSection(Header& header, Sections section, const Values& column,
+                std::uint64_t& file_size)
+{
+    file_size = alignUp(file_size);
+    header.sections_[section] = {file_size, column.size()};
+    file_size += column.size() * sizeof(typename Values::value_type);
+}
+
+/**
+ * @brief writeValues
+ * @param file
+ * @param column
+ * Write the elements of a column as they are.
+ */
+template <typename T>
+void writeValues(std::ofstream& file, const Column<T>& column)
+{
+    file.write(reinterpret_cast<const char*>(column.data()),
+               column.size() * sizeof(T));
+}
+
+template <typename T>
+void writeValues(std::ofstream& file, const ChunkedColumn<T>& column)
+{
+    column.forEachChunk([&file](const T* values, std::size_t count)
+    {
+        file.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+    });
+}
+
+/**
+ * @brief writeSection
+ * @param file
+ * @param header
+ * @param section
+ * @param column
+ */
+template <typename Values>
+void writeSection(std::ofstream& file, const Header& header,
+                  Sections section, const Values& column)
+{
+    // Pad up to the start of the section.
+    static const char padding[SECTION_ALIGNMENT] = {};
+    std::uint64_t position = static_cast<std::uint64_t>(file.tellp());
+    file.write(padding, header.sections_[section].offset_ - position);
+    writeValues(file, column);
+}
+
+/**
+ * @brief viewSection
+ * @param contents
+ * @param header
+ * @param section
+ * @param expected_count: required number of elements, 0 for any
+ * @param column
+ * @return true iff the section lies within the file and has the
+ * expected number of elements; then column views it.
+ */
+template <typename Values>
+bool viewSection(std::string_view contents, const Header& header,
+                 Sections section, std::uint64_t expected_count,
+                 Values& column)
+{
+    using T = typename Values::value_type;
+    const Section& place = header.sections_[section];
+    if( place.offset_ % SECTION_ALIGNMENT != 0 or place.offset_ > contents.size()
+        or place.count_ > (contents.size() - place.offset_) / sizeof(T)
+        or (expected_count != 0 and place.count_ != expected_count) )
+    {
+        return false;
+    }
+    column.view(reinterpret_cast<const T*>(contents.data() + place.offset_),
+                place.count_);
+    return true;
+}
+}
+
+bool Snapshot::isSnapshot(std::string_view contents)
+{
+    return contents.size() >= sizeof(MAGIC)
+            and std::memcmp(contents.data(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool Snapshot::save(const Familytree& tree, const std::string& path)
+{
+    // Only a packed tree is saved, its children lists following each other.
+    if( not tree.isPacked() )
+    {
+        Familytree packed_tree = tree;
+        packed_tree.pack();
+        return save(packed_tree, path);
+    }
+    Column<std::uint32_t> child_offsets;
+    child_offsets.reserve(tree.size() + 1);
+    tree.child_begin_.forEachChunk([&child_offsets](const std::uint32_t* begins,
+                                                    std::size_t count)
+    {
+        child_offsets.append(begins, count);
+    });
+    child_offsets.push_back(static_cast<std::uint32_t>(tree.child_list_.size()));
+
+    Header header = {};
+    std::memcpy(header.magic_, MAGIC, sizeof(MAGIC));
+    header.version_ = VERSION;
+    header.byte_order_ = BYTE_ORDER_MARK;
+    header.persons_ = tree.size();
+    std::uint64_t file_size = sizeof(Header);
+    addSection(header, ID_CHARS, tree.id_chars_, file_size);
+    addSection(header, ID_OFFSETS, tree.id_offsets_, file_size);
+    addSection(header, HEIGHTS, tree.heights_, file_size);
+    addSection(header, PARENTS, tree.parents_, file_size);
+    addSection(header, CHILD_OFFSETS, child_offsets, file_size);
+    addSection(header, CHILD_LIST, tree.child_list_, file_size);
+    addSection(header, ID_TABLE, tree.id_table_, file_size);
+    addSection(header, TALLEST, tree.tallest_, file_size);
+    addSection(header, SHORTEST, tree.shortest_, file_size);
+    addSection(header, ID_ORDER, tree.id_order_, file_size);
+    addSection(header, ID_RANK, tree.id_rank_, file_size);
+    addSection(header, HEIGHT_ORDER, tree.height_order_, file_size);
+
+    // Write next to the target and rename, so that a reader never sees a
+    // half written snapshot.
+    // The name is unique, so that saves running at the same time don't
+    // write to the same file.
+    std::string temporary_path = path + ".tmp." + std::to_string(getpid())
+                                 + "." + std::to_string(temporary_files++);
+    std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    writeSection(file, header, ID_CHARS, tree.id_chars_);
+    writeSection(file, header, ID_OFFSETS, tree.id_offsets_);
+    writeSection(file, header, HEIGHTS, tree.heights_);
+    writeSection(file, header, PARENTS, tree.parents_);
+    writeSection(file, header, CHILD_OFFSETS, child_offsets);
+    writeSection(file, header, CHILD_LIST, tree.child_list_);
+    writeSection(file, header, ID_TABLE, tree.id_table_);
+    writeSection(file, header, TALLEST, tree.tallest_);
+    writeSection(file, header, SHORTEST, tree.shortest_);
+    writeSection(file, header, ID_ORDER, tree.id_order_);
+    writeSection(file, header, ID_RANK, tree.id_rank_);
+    writeSection(file, header, HEIGHT_ORDER, tree.height_order_);
+    file.close();
+    if( not file or std::rename(temporary_path.c_str(), path.c_str()) != 0 )
+    {
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<Familytree> Snapshot::load(std::shared_ptr<const MappedFile> file)
+{
+    std::string_view contents = file->contents();
+    Header header;
+    if( not isSnapshot(contents) or contents.size() < sizeof(Header) )
+    {
+        return nullptr;
+    }
+    std::memcpy(&header, contents.data(), sizeof(Header));
+    if( header.version_ != VERSION or header.byte_order_ != BYTE_ORDER_MARK )
+    {
+        return nullptr;
+    }
+
+    // Check that the sections are inside the file and fit together, the
+    // contents themselves are trusted.
+    std::shared_ptr<Familytree> tree = std::make_shared<Familytree>();
+    std::uint64_t persons = header.persons_;
+    Column<std::uint32_t> child_offsets;
+    if( persons >= NO_PERSON
+        or not viewSection(contents, header, ID_CHARS, 0, tree->id_chars_)
+        or not viewSection(contents, header, ID_OFFSETS, persons + 1, tree->id_offsets_)
+        or not viewSection(contents, header, HEIGHTS, persons, tree->heights_)
+        or not viewSection(contents, header, PARENTS, persons, tree->parents_)
+        or not viewSection(contents, header, CHILD_OFFSETS, persons + 1, child_offsets)
+        or not viewSection(contents, header, CHILD_LIST, 0, tree->child_list_)
+        or not viewSection(contents, header, ID_TABLE, 0, tree->id_table_)
+        or not viewSection(contents, header, TALLEST, persons, tree->tallest_)
+        or not viewSection(contents, header, SHORTEST, persons, tree->shortest_)
+        or not viewSection(contents, header, ID_ORDER, persons, tree->id_order_)
+        or not viewSection(contents, header, ID_RANK, persons, tree->id_rank_)
+        or not viewSection(contents, header, HEIGHT_ORDER, persons, tree->height_order_) )
+    {
+        return nullptr;
+    }
+    std::size_t table_size = tree->id_table_.size();
+    if( tree->id_offsets_.back() != tree->id_chars_.size()
+        or child_offsets.back() != tree->child_list_.size()
+        or table_size < 2 * persons or (table_size & (table_size - 1)) != 0 )
+    {
+        return nullptr;
+    }
+
+    // The tree is packed, every children list ending where the next begins.
+    tree->mapping_ = file;
+    tree->child_begin_.view(child_offsets.data(), persons);
+    tree->child_end_.view(child_offsets.data() + 1, persons);
+    tree->listed_children_ = tree->child_list_.size();
+    tree->children_packed_ = true;
+    return tree;
+}
@@ -0,0 +1,64 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: snapshot.hh                                                         #
+# Description: Binary snapshot files of a Familytree. A snapshot holds the  #
+#   frozen columns of the tree as they are in memory, so a mapped snapshot  #
+#   can be queried without parsing or copying it.                           #
+#############################################################################
+*/
+#ifndef SNAPSHOT_HH
+#define SNAPSHOT_HH
+
+#include "familytree.hh"
+#include "mappedfile.hh"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief The Snapshot class
+ * Saves and loads Familytree snapshots. The file starts with a header
+ * listing the sections: the id characters, id offsets, heights, parent
+ * pairs, packed children (offsets and list), the id hash table, the
+ * tallest and shortest person of every lineage, the persons in id order
+ * with their ranks and the persons in height order. All
+ * offsets are from the start of the file, so the file can be mapped
+ * anywhere. Numbers are stored in the byte order of the machine that wrote
+ * them, which is checked when loading.
+ */
+class Snapshot
+{
+public:
+    // Bump when the layout of the file changes.
+    static const std::uint32_t VERSION = 4;
+
+    /**
+     * @brief isSnapshot
+     * @param contents
+     * @return true if the contents start like a snapshot file
+     */
+    static bool isSnapshot(std::string_view contents);
+
+    /**
+     * @brief save
+     * @param tree
+     * @param path
+     * @return true iff the snapshot was written
+     * Write the tree to a new file that replaces path only when complete.
+     */
+    static bool save(const Familytree& tree, const std::string& path);
+
+    /**
+     * @brief load
+     * @param file mapped snapshot file
+     * @return tree whose columns view the file, nullptr if the file isn't
+     * a valid snapshot. The tree keeps the file mapped.
+     */
+    static std::shared_ptr<Familytree> load(std::shared_ptr<const MappedFile> file);
+};
+
+#endif // SNAPSHOT_HH
@@ -0,0 +1,53 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: stringsink.hh                                                       #
+# Description: Output stream buffer that appends everything to a string.    #
+#############################################################################
+*/
+#ifndef STRINGSINK_HH
+#define STRINGSINK_HH
+
+#include <streambuf>
+#include <string>
+
+/**
+ * @brief The StringSink class
+ * Stream buffer appending everything to a target string. Unlike
+ * std::ostringstream, the target can be changed without copying, so one
+ * stream can fill many strings one after another.
+ */
+class StringSink : public std::streambuf
+{
+public:
+    /**
+     * @brief setTarget
+     * @param target string to append to from now on
+     */
+    void setTarget(std::string* target)
+    {
+        target_ = target;
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if( not traits_type::eq_int_type(c, traits_type::eof()) )
+        {
+            target_->push_back(traits_type::to_char_type(c));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize count) override
+    {
+        target_->append(data, static_cast<std::size_t>(count));
+        return count;
+    }
+
+private:
+    std::string* target_ = nullptr;
+};
+
+#endif // STRINGSINK_HH
@@ -0,0 +1,181 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: threadpool.cpp                                                      #
+# Description: Work-stealing thread pool for running many independent       #
+#   tasks, such as queries, in parallel.                                    #
+# Notes: * Check the threadpool.hh for more info.                           #
+#############################################################################
+*/
+#include "threadpool.hh"
+
+namespace
+{
+
+// Whether the thread is running tasks of a pool.
+thread_local bool on_worker = false;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    threads = threads > 0 ? threads : 1;
+    for( unsigned int i = 0; i < threads; ++i )
+    {
+        ranges_.push_back(std::make_unique<Range>());
+    }
+    // The calling thread works on range 0.
+    for( unsigned int i = 1; i < threads; ++i )
+    {
+        threads_.emplace_back(&ThreadPool::loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    batch_started_.notify_all();
+    for( std::thread& thread : threads_ )
+    {
+        thread.join();
+    }
+}
+
+unsigned int ThreadPool::size() const
+{
+    return static_cast<unsigned int>(ranges_.size());
+}
+
+void ThreadPool::forEach(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    if( count == 0 )
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> batch_lock(batch_mutex_);
+
+    // Even shares, the first ones one bigger when count doesn't divide.
+    std::size_t share = count / ranges_.size();
+    std::size_t extra = count % ranges_.size();
+    std::size_t begin = 0;
+    for( std::size_t i = 0; i < ranges_.size(); ++i )
+    {
+        std::lock_guard<std::mutex> lock(ranges_.at(i)->mutex_);
+        ranges_.at(i)->next_ = begin;
+        begin += share + (i < extra ? 1 : 0);
+        ranges_.at(i)->end_ = begin;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        ++batch_;
+        busy_ = static_cast<unsigned int>(threads_.size());
+    }
+    batch_started_.notify_all();
+
+    bool was_on_worker = on_worker;
+    on_worker = true;
+    work(0);
+    on_worker = was_on_worker;
+
+    // The ranges are empty, wait for the tasks still running elsewhere.
+    std::unique_lock<std::mutex> lock(mutex_);
+    batch_done_.wait(lock, [this]() { return busy_ == 0; });
+    task_ = nullptr;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+bool ThreadPool::onWorker()
+{
+    return on_worker;
+}
+
+void ThreadPool::work(unsigned int worker)
+{
+    Range& own = *ranges_.at(worker);
+    while( true )
+    {
+        bool found = false;
+        std::size_t number = 0;
+        {
+            std::lock_guard<std::mutex> lock(own.mutex_);
+            if( own.next_ < own.end_ )
+            {
+                number = own.next_++;
+                found = true;
+            }
+        }
+        if( found )
+        {
+            (*task_)(number);
+        }
+        else if( not steal(worker) )
+        {
+            // Every number left is in the range of, or being moved by, a
+            // thread that is still working.
+            return;
+        }
+    }
+}
+
+bool ThreadPool::steal(unsigned int worker)
+{
+    for( std::size_t i = 1; i < ranges_.size(); ++i )
+    {
+        Range& victim = *ranges_.at((worker + i) % ranges_.size());
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex_);
+            if( victim.next_ >= victim.end_ )
+            {
+                continue;
+            }
+            begin = victim.end_ - (victim.end_ - victim.next_ + 1) / 2;
+            end = victim.end_;
+            victim.end_ = begin;
+        }
+        Range& own = *ranges_.at(worker);
+        std::lock_guard<std::mutex> lock(own.mutex_);
+        own.next_ = begin;
+        own.end_ = end;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::loop(unsigned int worker)
+{
+    on_worker = true;
+    std::size_t seen_batch = 0;
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            batch_started_.wait(lock, [&]() { return stopping_ or batch_ != seen_batch; });
+            if( stopping_ )
+            {
+                return;
+            }
+            seen_batch = batch_;
+        }
+
+        work(worker);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if( --busy_ == 0 )
+        {
+            batch_done_.notify_one();
+        }
+    }
+}
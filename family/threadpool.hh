@@ -0,0 +1,121 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: threadpool.hh                                                       #
+# Description: Work-stealing thread pool for running many independent       #
+#   tasks, such as queries, in parallel.                                    #
+#############################################################################
+*/
+#ifndef THREADPOOL_HH
+#define THREADPOOL_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The ThreadPool class
+ * Runs a batch of tasks, numbered 0 ... count - 1, on a fixed set of
+ * threads. Every thread starts with an even share of the numbers and takes
+ * them one at a time from the front. A thread out of work steals the back
+ * half of the remaining numbers of another thread, so slow tasks don't
+ * leave the other threads idle.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief ThreadPool
+     * @param threads number of threads running the tasks, the calling
+     * thread included; zero is taken as one
+     */
+    explicit ThreadPool(unsigned int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief size
+     * @return number of threads running the tasks, the calling thread
+     * included
+     */
+    unsigned int size() const;
+
+    /**
+     * @brief forEach
+     * @param count number of tasks
+     * @param task called once with every number 0 ... count - 1
+     * Run the tasks and return when all of them are done. Only one batch
+     * runs at a time.
+     */
+    void forEach(std::size_t count, const std::function<void(std::size_t)>& task);
+
+    /**
+     * @brief shared
+     * @return pool with a thread per core, created at the first call, for
+     * work split within one query
+     */
+    static ThreadPool& shared();
+
+    /**
+     * @brief onWorker
+     * @return true if the calling thread is running tasks of some pool, so
+     * the other threads are busy already and a pool of its own would only
+     * add more threads than cores
+     */
+    static bool onWorker();
+
+private:
+    // Numbers still to be run by one thread, kept on a cache line of its
+    // own. Thieves lock the range too.
+    struct alignas(64) Range
+    {
+        std::mutex mutex_;
+        std::size_t next_ = 0;
+        std::size_t end_ = 0;
+    };
+
+    /**
+     * @brief work
+     * @param worker index of the range of the thread
+     * Run tasks from the own range, then stolen ones, until no range has
+     * any left.
+     */
+    void work(unsigned int worker);
+
+    /**
+     * @brief steal
+     * @param worker index of the range of the thread
+     * @return true if some numbers were moved to the range of the thread
+     */
+    bool steal(unsigned int worker);
+
+    /**
+     * @brief loop
+     * @param worker
+     * Body of the pool threads: wait for a batch, work on it, repeat.
+     */
+    void loop(unsigned int worker);
+
+    std::vector<std::unique_ptr<Range>> ranges_;
+    std::vector<std::thread> threads_;
+
+    // Current batch, and its number so that the threads see a new one.
+    const std::function<void(std::size_t)>* task_ = nullptr;
+    std::size_t batch_ = 0;
+    unsigned int busy_ = 0;
+    bool stopping_ = false;
+    std::mutex mutex_;
+    std::condition_variable batch_started_;
+    std::condition_variable batch_done_;
+    std::mutex batch_mutex_;
+};
+
+#endif // THREADPOOL_HH
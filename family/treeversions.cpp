@@ -0,0 +1,163 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: treeversions.cpp                                                    #
+# Description: Versions of a Familytree for changing the tree while others  #
+#   read it. Readers never wait, old versions are freed by epoch-based      #
+#   reclamation.                                                            #
+# Notes: * Check the treeversions.hh for more info.                         #
+#############################################################################
+*/
+#include "treeversions.hh"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+TreeVersions::ReadGuard::ReadGuard(Slot* slot, const Familytree* tree):
+    slot_(slot), tree_(tree)
+{
+}
+
+TreeVersions::ReadGuard::ReadGuard(ReadGuard&& other):
+    slot_(other.slot_), tree_(other.tree_)
+{
+    other.slot_ = nullptr;
+}
+
+TreeVersions::ReadGuard::~ReadGuard()
+{
+    if( slot_ != nullptr )
+    {
+        slot_->epoch_.store(0);
+        slot_->used_.store(false);
+    }
+}
+
+const Familytree& TreeVersions::ReadGuard::tree() const
+{
+    return *tree_;
+}
+
+TreeVersions::TreeVersions(std::shared_ptr<const Familytree> tree):
+    current_(tree.get()), current_owner_(tree)
+{
+}
+
+TreeVersions::~TreeVersions()
+{
+    Slot* slot = slots_.load();
+    while( slot != nullptr )
+    {
+        Slot* next = slot->next_;
+        delete slot;
+        slot = next;
+    }
+}
+
+TreeVersions::ReadGuard TreeVersions::read() const
+{
+    // Take a free slot, or add one if all are in use.
+    Slot* slot = slots_.load();
+    for( ; slot != nullptr; slot = slot->next_ )
+    {
+        bool expected = false;
+        if( not slot->used_.load(std::memory_order_relaxed)
+            and slot->used_.compare_exchange_strong(expected, true) )
+        {
+            break;
+        }
+    }
+    if( slot == nullptr )
+    {
+        slot = new Slot();
+        slot->used_.store(true);
+        slot->next_ = slots_.load();
+        while( not slots_.compare_exchange_weak(slot->next_, slot) ){}
+    }
+
+    // The epoch is announced before the version is loaded, so a writer
+    // replacing the version either sees the announcement or has already
+    // published the new version this reader then loads.
+    slot->epoch_.store(epoch_.load());
+    return ReadGuard(slot, current_.load());
+}
+
+void TreeVersions::update(const std::function<bool(Familytree&)>& change)
+{
+    std::uint64_t prepared = prepare(change);
+    if( prepared != 0 )
+    {
+        publish(prepared);
+    }
+}
+
+std::uint64_t TreeVersions::prepare(const std::function<bool(Familytree&)>& change)
+{
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const Familytree& newest = prepared_.empty() ? *current_owner_ : *prepared_.back().second;
+    std::shared_ptr<Familytree> copy = std::make_shared<Familytree>(newest);
+    if( not change(*copy) )
+    {
+        return 0;
+    }
+    copy->freeze();
+    prepared_.emplace_back(++last_prepared_, std::move(copy));
+    return last_prepared_;
+}
+
+void TreeVersions::publish(std::uint64_t prepared)
+{
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    auto last = std::find_if(prepared_.begin(), prepared_.end(),
+                             [prepared](const auto& version)
+                             { return version.first > prepared; });
+    if( last == prepared_.begin() )
+    {
+        return;
+    }
+
+    // The versions before the published one were never current, so no
+    // reader can see them.
+    std::shared_ptr<const Familytree> published = std::prev(last)->second;
+    current_.store(published.get());
+    retired_.emplace_back(epoch_.fetch_add(1), std::move(current_owner_));
+    current_owner_ = std::move(published);
+    version_.fetch_add(last - prepared_.begin());
+    prepared_.erase(prepared_.begin(), last);
+    reclaim();
+}
+
+void TreeVersions::discard(std::uint64_t prepared)
+{
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    prepared_.erase(std::find_if(prepared_.begin(), prepared_.end(),
+                                 [prepared](const auto& version)
+                                 { return version.first >= prepared; }),
+                    prepared_.end());
+}
+
+std::uint64_t TreeVersions::version() const
+{
+    return version_.load();
+}
+
+void TreeVersions::reclaim()
+{
+    // A version replaced in epoch e may be read by readers that announced
+    // e or earlier.
+    std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+    for( Slot* slot = slots_.load(); slot != nullptr; slot = slot->next_ )
+    {
+        std::uint64_t epoch = slot->epoch_.load();
+        if( epoch != 0 )
+        {
+            oldest = std::min(oldest, epoch);
+        }
+    }
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                  [oldest](const auto& retired)
+                                  { return retired.first < oldest; }),
+                   retired_.end());
+}
@@ -0,0 +1,167 @@
+/*
+#############################################################################
+# COMP.CS.110 Ohjelmointi 2: Tekniikat / Programming 2: Techniques          #
+# Project: Suku on pahin / All in the family                                #
+# File: treeversions.hh                                                     #
+# Description: Versions of a Familytree for changing the tree while others  #
+#   read it. Readers never wait, old versions are freed by epoch-based      #
+#   reclamation.                                                            #
+#############################################################################
+*/
+#ifndef TREEVERSIONS_HH
+#define TREEVERSIONS_HH
+
+#include "familytree.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief The TreeVersions class
+ * Holds the current version of a tree. The versions are immutable: a
+ * change is made to a copy, which then replaces the current version with
+ * one atomic store. Readers only load the pointer, so they never block
+ * and never see a half done change.
+ *
+ * The copy shares the columns of the version, see Column and
+ * ChunkedColumn, so a change costs about what it changes, not the size of
+ * the tree, and so does the freeze of the copy.
+ *
+ * A reader announces the epoch it started in, and a replaced version is
+ * freed once no reader of its epoch or earlier is left. Writers are
+ * serialized among themselves.
+ *
+ * A writer that must make its change durable first prepares the version,
+ * then publishes it once the change is on the disk, or discards it. The
+ * versions prepared meanwhile build on the ones before, so many writers
+ * may wait for the disk at the same time, and are published in order.
+ */
+class TreeVersions
+{
+private:
+    // Announcement of one reader, reused by later readers. Epoch 0 means
+    // the slot is not reading.
+    struct alignas(64) Slot
+    {
+        std::atomic<bool> used_{false};
+        std::atomic<std::uint64_t> epoch_{0};
+        Slot* next_ = nullptr;
+    };
+
+public:
+    /**
+     * @brief The ReadGuard class
+     * Keeps the version it was created with alive until destroyed.
+     */
+    class ReadGuard
+    {
+    public:
+        ReadGuard(ReadGuard&& other);
+        ~ReadGuard();
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+        ReadGuard& operator=(ReadGuard&&) = delete;
+
+        /**
+         * @brief tree
+         * @return the version being read
+         */
+        const Familytree& tree() const;
+
+    private:
+        friend class TreeVersions;
+        ReadGuard(Slot* slot, const Familytree* tree);
+
+        Slot* slot_;
+        const Familytree* tree_;
+    };
+
+    /**
+     * @brief TreeVersions
+     * @param tree the first version, not to be changed by others anymore
+     */
+    explicit TreeVersions(std::shared_ptr<const Familytree> tree);
+    ~TreeVersions();
+
+    TreeVersions(const TreeVersions&) = delete;
+    TreeVersions& operator=(const TreeVersions&) = delete;
+
+    /**
+     * @brief read
+     * @return guard to the current version
+     * Lock-free. Should not be held for long, as the versions replaced
+     * meanwhile are kept until it is destroyed.
+     */
+    ReadGuard read() const;
+
+    /**
+     * @brief update
+     * @param change applied to a copy of the current version, returns true
+     * if it changed the copy
+     * Publish the changed copy, frozen, as the new current version. The
+     * current version stays if nothing was changed.
+     */
+    void update(const std::function<bool(Familytree&)>& change);
+
+    /**
+     * @brief prepare
+     * @param change applied to a copy of the newest version, prepared or
+     * published, returns true if it changed the copy
+     * @return number of the prepared version, for publish or discard, or 0
+     * if nothing was changed
+     * Freeze the changed copy without making it current.
+     */
+    std::uint64_t prepare(const std::function<bool(Familytree&)>& change);
+
+    /**
+     * @brief publish
+     * @param prepared number of a prepared version
+     * Make the version current, with the ones prepared before it. Nothing
+     * is done if a version prepared after it has been published already.
+     */
+    void publish(std::uint64_t prepared);
+
+    /**
+     * @brief discard
+     * @param prepared number of a prepared version
+     * Drop the version and the ones prepared after it, which build on it.
+     */
+    void discard(std::uint64_t prepared);
+
+    /**
+     * @brief version
+     * @return number of versions published so far, starting from 1
+     */
+    std::uint64_t version() const;
+
+private:
+    /**
+     * @brief reclaim
+     * Free the replaced versions no reader can still see.
+     */
+    void reclaim();
+
+    std::atomic<const Familytree*> current_;
+    mutable std::atomic<std::uint64_t> epoch_{1};
+    mutable std::atomic<Slot*> slots_{nullptr};
+
+    // Owners of the current and the replaced versions, with the epoch each
+    // was replaced in. Only touched by writers.
+    std::mutex writer_mutex_;
+    std::shared_ptr<const Familytree> current_owner_;
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<const Familytree>>> retired_;
+    std::atomic<std::uint64_t> version_{1};
+
+    // Versions prepared but not published yet, in order with their
+    // numbers, and the number of the last prepared one.
+    std::vector<std::pair<std::uint64_t, std::shared_ptr<const Familytree>>> prepared_;
+    std::uint64_t last_prepared_ = 0;
+};
+
+#endif // TREEVERSIONS_HH
@@ -11,29 +11,406 @@
 */
 #include "utils.hh"
 
-std::vector<std::string> Utils::split(const std::string& str, char delim)
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+
+#if defined(__GNUC__) and (defined(__x86_64__) or defined(__i386__))
+#include <immintrin.h>
+#define UTILS_X86_SCAN
+#endif
+
+namespace
+{
+const char QUOTE = '"';
+
+/**
+ * @brief findScalar
+ * @param str
+ * @param delim
+ * @param from first position to look at
+ * @return position of the first delim or quote char at or after from
+ */
+inline std::size_t findScalar(std::string_view str, char delim, std::size_t from)
+{
+    for( std::size_t i = from; i < str.size(); ++i )
+    {
+        if( str[i] == delim or str[i] == QUOTE )
+        {
+            return i;
+        }
+    }
+    return str.size();
+}
+
+#ifdef UTILS_X86_SCAN
+/**
+ * @brief find16
+ * @param str
+ * @param delim
+ * @param from first position to look at
+ * @return position of the first delim or quote char at or after from, 16
+ * chars at a time
+ * Always inlined, so that it is compiled to AVX instructions in findAvx2.
+ * Running SSE instructions right after AVX ones is slow.
+ */
+__attribute__((always_inline))
+inline std::size_t find16(std::string_view str, char delim, std::size_t from)
+{
+    const __m128i delims = _mm_set1_epi8(delim);
+    const __m128i quotes = _mm_set1_epi8(QUOTE);
+    std::size_t i = from;
+    for( ; i + 16 <= str.size(); i += 16 )
+    {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i));
+        int found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, delims),
+                                                   _mm_cmpeq_epi8(chars, quotes)));
+        if( found != 0 )
+        {
+            return i + __builtin_ctz(found);
+        }
+    }
+    return findScalar(str, delim, i);
+}
+
+/**
+ * @brief findSse2
+ * @param str
+ * @param delim
+ * @return position of the first delim or quote char, 16 chars at a time
+ */
+__attribute__((target("sse2")))
+std::size_t findSse2(std::string_view str, char delim)
+{
+    return find16(str, delim, 0);
+}
+
+/**
+ * @brief findAvx2
+ * @param str
+ * @param delim
+ * @return position of the first delim or quote char, 32 chars at a time
+ */
+__attribute__((target("avx2")))
+std::size_t findAvx2(std::string_view str, char delim)
+{
+    const __m256i delims = _mm256_set1_epi8(delim);
+    const __m256i quotes = _mm256_set1_epi8(QUOTE);
+    std::size_t i = 0;
+    for( ; i + 32 <= str.size(); i += 32 )
+    {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str.data() + i));
+        unsigned int found = static_cast<unsigned int>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chars, delims), _mm256_cmpeq_epi8(chars, quotes))));
+        if( found != 0 )
+        {
+            return i + __builtin_ctz(found);
+        }
+    }
+    return find16(str, delim, i);
+}
+
+// For every 8-bit mask the lanes of its set bits first, for packing the
+// selected lanes of a vector with one permute.
+constexpr std::array<std::array<std::uint32_t, 8>, 256> PACK_LANES = []()
+{
+    std::array<std::array<std::uint32_t, 8>, 256> lanes = {};
+    for( unsigned int mask = 0; mask < 256; ++mask )
+    {
+        unsigned int packed = 0;
+        for( unsigned int lane = 0; lane < 8; ++lane )
+        {
+            if( mask >> lane & 1 )
+            {
+                lanes[mask][packed++] = lane;
+            }
+        }
+    }
+    return lanes;
+}();
+
+/**
+ * @brief selectAvx2
+ * @param values
+ * @param indexes
+ * @param count of the indexes
+ * @param low
+ * @param high
+ * @param selected room for count + 8 indexes
+ * @return number of the selected indexes, 8 at a time
+ */
+__attribute__((target("avx2")))
+std::size_t selectAvx2(const int* values, const std::uint32_t* indexes, std::size_t count,
+                       int low, int high, std::uint32_t* selected)
+{
+    const __m256i lows = _mm256_set1_epi32(low);
+    const __m256i highs = _mm256_set1_epi32(high);
+    std::size_t found = 0;
+    std::size_t i = 0;
+    for( ; i + 8 <= count; i += 8 )
+    {
+        __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indexes + i));
+        __m256i heights = _mm256_i32gather_epi32(values, lanes, 4);
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lows, heights),
+                                          _mm256_cmpgt_epi32(heights, highs));
+        unsigned int mask = ~static_cast<unsigned int>(
+            _mm256_movemask_ps(_mm256_castsi256_ps(outside))) & 0xff;
+        __m256i order = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(PACK_LANES[mask].data()));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(selected + found),
+                            _mm256_permutevar8x32_epi32(lanes, order));
+        found += __builtin_popcount(mask);
+    }
+    for( ; i < count; ++i )
+    {
+        selected[found] = indexes[i];
+        found += values[indexes[i]] >= low and values[indexes[i]] <= high;
+    }
+    return found;
+}
+
+/**
+ * @brief gatherAvx2
+ * @param values
+ * @param indexes
+ * @param count of the indexes
+ * @param gathered room for count values
+ * @return the summary of the gathered values, 8 at a time
+ */
+__attribute__((target("avx2")))
+Utils::Summary gatherAvx2(const int* values, const std::uint32_t* indexes, std::size_t count,
+                          int* gathered)
+{
+    __m256i sums = _mm256_setzero_si256();
+    __m256i mins = _mm256_set1_epi32(INT_MAX);
+    __m256i maxs = _mm256_set1_epi32(INT_MIN);
+    std::size_t i = 0;
+    for( ; i + 8 <= count; i += 8 )
+    {
+        __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indexes + i));
+        __m256i heights = _mm256_i32gather_epi32(values, lanes, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gathered + i), heights);
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(heights)));
+        sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(heights, 1)));
+        mins = _mm256_min_epi32(mins, heights);
+        maxs = _mm256_max_epi32(maxs, heights);
+    }
+
+    alignas(32) std::int64_t sum_lanes[4];
+    alignas(32) int min_lanes[8];
+    alignas(32) int max_lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(sum_lanes), sums);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(min_lanes), mins);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(max_lanes), maxs);
+    Utils::Summary summary;
+    for( int lane = 0; lane < 8; ++lane )
+    {
+        summary.sum_ += lane < 4 ? sum_lanes[lane] : 0;
+        summary.min_ = std::min(summary.min_, min_lanes[lane]);
+        summary.max_ = std::max(summary.max_, max_lanes[lane]);
+    }
+    for( ; i < count; ++i )
+    {
+        gathered[i] = values[indexes[i]];
+        summary.sum_ += gathered[i];
+        summary.min_ = std::min(summary.min_, gathered[i]);
+        summary.max_ = std::max(summary.max_, gathered[i]);
+    }
+    return summary;
+}
+
+/**
+ * @brief deviationsAvx2
+ * @param values
+ * @param count of the values
+ * @param mean
+ * @return the sum of the squared differences from the mean, 8 at a time
+ */
+__attribute__((target("avx2")))
+double deviationsAvx2(const int* values, std::size_t count, double mean)
+{
+    const __m256d means = _mm256_set1_pd(mean);
+    __m256d low_sums = _mm256_setzero_pd();
+    __m256d high_sums = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for( ; i + 8 <= count; i += 8 )
+    {
+        __m256i heights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        __m256d low = _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(heights)), means);
+        __m256d high = _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(heights, 1)), means);
+        low_sums = _mm256_add_pd(low_sums, _mm256_mul_pd(low, low));
+        high_sums = _mm256_add_pd(high_sums, _mm256_mul_pd(high, high));
+    }
+
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(low_sums, high_sums));
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for( ; i < count; ++i )
+    {
+        double deviation = values[i] - mean;
+        total += deviation * deviation;
+    }
+    return total;
+}
+#endif
+
+} // namespace
+
+Utils::Scan Utils::bestScan()
+{
+#ifdef UTILS_X86_SCAN
+    static const Scan best = __builtin_cpu_supports("avx2") ? Scan::AVX2
+                             : __builtin_cpu_supports("sse2") ? Scan::SSE2
+                             : Scan::SCALAR;
+    return best;
+#else
+    return Scan::SCALAR;
+#endif
+}
+
+std::size_t Utils::findSpecial(std::string_view str, char delim, Scan scan)
 {
-    std::vector<std::string> result = {""};
-    bool insideQuotation = false;
-    for ( char currentChar : str )
+#ifdef UTILS_X86_SCAN
+    if( scan == Scan::AVX2 )
     {
-        if ( currentChar == '"' )
+        return findAvx2(str, delim);
+    }
+    if( scan == Scan::SSE2 )
+    {
+        return findSse2(str, delim);
+    }
+#endif
+    return findScalar(str, delim, 0);
+}
+
+void Utils::tokenize(std::string_view str, char delim, Tokens& tokens, Scan scan)
+{
+    tokens.tokens_.clear();
+    tokens.unquoted_.clear();
+    // The unquoted parts are never longer than the line, so the buffer
+    // isn't moved while the views to it are made.
+    tokens.unquoted_.reserve(str.size());
+
+    std::size_t token_start = 0;
+    std::size_t copy_start = 0;
+    std::size_t unquoted_start = 0;
+    bool has_quotes = false;
+    bool inside_quotation = false;
+    std::size_t i = 0;
+    while( true )
+    {
+        i += findSpecial(str.substr(i), delim, scan);
+        if( i < str.size() and str[i] == QUOTE )
         {
-            insideQuotation = not insideQuotation;
+            // The chars up to a quote are copied without it.
+            if( not has_quotes )
+            {
+                has_quotes = true;
+                unquoted_start = tokens.unquoted_.size();
+            }
+            tokens.unquoted_.append(str.substr(copy_start, i - copy_start));
+            copy_start = i + 1;
+            inside_quotation = not inside_quotation;
+            ++i;
+            continue;
         }
-        else if ( currentChar == delim and not insideQuotation)
+        if( i < str.size() and inside_quotation )
         {
-            result.push_back("");
+            ++i;
+            continue;
+        }
+
+        // A delim outside quotes or the end of the line ends the token.
+        if( has_quotes )
+        {
+            tokens.unquoted_.append(str.substr(copy_start, i - copy_start));
+            tokens.tokens_.push_back(std::string_view(tokens.unquoted_).substr(unquoted_start));
         }
         else
         {
-            result.back().push_back(currentChar);
+            tokens.tokens_.push_back(str.substr(token_start, i - token_start));
+        }
+        if( i == str.size() )
+        {
+            return;
         }
+        token_start = copy_start = ++i;
+        has_quotes = false;
     }
-    return result;
 }
 
-bool Utils::isEmpty(const std::string &str)
+void Utils::selectInRange(const int* values, const std::vector<std::uint32_t>& indexes,
+                          int low, int high, std::vector<std::uint32_t>& selected, Scan scan)
+{
+    // The vector loop stores 8 indexes at a time, the unselected ones to be
+    // written over.
+    selected.resize(indexes.size() + 8);
+    std::size_t found = 0;
+#ifdef UTILS_X86_SCAN
+    if( scan == Scan::AVX2 )
+    {
+        found = selectAvx2(values, indexes.data(), indexes.size(), low, high, selected.data());
+        selected.resize(found);
+        return;
+    }
+#endif
+    (void)scan;
+    for( std::uint32_t index : indexes )
+    {
+        selected[found] = index;
+        found += values[index] >= low and values[index] <= high;
+    }
+    selected.resize(found);
+}
+
+Utils::Summary Utils::gatherValues(const int* values, const std::vector<std::uint32_t>& indexes,
+                                   std::vector<int>& gathered, Scan scan)
+{
+    gathered.resize(indexes.size());
+#ifdef UTILS_X86_SCAN
+    if( scan == Scan::AVX2 )
+    {
+        return gatherAvx2(values, indexes.data(), indexes.size(), gathered.data());
+    }
+#endif
+    (void)scan;
+    Summary summary;
+    for( std::size_t i = 0; i < indexes.size(); ++i )
+    {
+        gathered[i] = values[indexes[i]];
+        summary.sum_ += gathered[i];
+        summary.min_ = std::min(summary.min_, gathered[i]);
+        summary.max_ = std::max(summary.max_, gathered[i]);
+    }
+    return summary;
+}
+
+double Utils::squaredDeviations(const std::vector<int>& values, double mean, Scan scan)
+{
+#ifdef UTILS_X86_SCAN
+    if( scan == Scan::AVX2 )
+    {
+        return deviationsAvx2(values.data(), values.size(), mean);
+    }
+#endif
+    (void)scan;
+    double total = 0;
+    for( int value : values )
+    {
+        double deviation = value - mean;
+        total += deviation * deviation;
+    }
+    return total;
+}
+
+std::vector<std::string> Utils::split(const std::string& str, char delim)
+{
+    Tokens tokens;
+    tokenize(str, delim, tokens);
+    return std::vector<std::string>(tokens.begin(), tokens.end());
+}
+
+bool Utils::isEmpty(std::string_view str)
 {
     for ( char ch : str )
     {
@@ -45,7 +422,7 @@ bool Utils::isEmpty(const std::string &str)
     return true;
 }
 
-bool Utils::isNumeric(const std::string& s)
+bool Utils::isNumeric(std::string_view s)
 {
     for ( unsigned int i = 0; i < s.size(); ++i )
     {
@@ -57,3 +434,14 @@ bool Utils::isNumeric(const std::string& s)
     return true;
 }
 
+bool Utils::parseNumber(std::string_view s, int& number)
+{
+    // from_chars would take a sign too.
+    if( s.empty() or not isdigit(static_cast<unsigned char>(s.front())) )
+    {
+        return false;
+    }
+    const char* end = s.data() + s.size();
+    std::from_chars_result result = std::from_chars(s.data(), end, number);
+    return result.ec == std::errc() and result.ptr == end;
+}
@@ -13,17 +13,124 @@
 #ifndef UTILS_HH
 #define UTILS_HH
 
-#include <vector>
+#include <cstddef>
+#include <climits>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace Utils
 {
+// Instruction sets the delimiters can be scanned, and the values filtered
+// and summed with.
+enum class Scan { SCALAR, SSE2, AVX2 };
+
+// Sum, smallest and largest of some values, see gatherValues.
+struct Summary
+{
+    std::int64_t sum_ = 0;
+    int min_ = INT_MAX;
+    int max_ = INT_MIN;
+};
+
+/**
+ * @brief The Tokens class
+ * Parts of a line split by tokenize. The parts without quotes view the line
+ * itself and the others the unquoted copies kept here, so the line must
+ * outlive the parts. A Tokens reused for every line keeps its buffers, so
+ * that splitting doesn't allocate once they are big enough.
+ */
+class Tokens
+{
+public:
+    using const_iterator = std::vector<std::string_view>::const_iterator;
+
+    std::size_t size() const { return tokens_.size(); }
+    bool empty() const { return tokens_.empty(); }
+    std::string_view operator[](std::size_t i) const { return tokens_[i]; }
+    const_iterator begin() const { return tokens_.begin(); }
+    const_iterator end() const { return tokens_.end(); }
+
+private:
+    friend void tokenize(std::string_view str, char delim, Tokens& tokens, Scan scan);
+
+    std::vector<std::string_view> tokens_;
+    std::string unquoted_;
+};
+
+/**
+ * @brief bestScan
+ * @return the widest instruction set the processor can scan with
+ */
+Scan bestScan();
+
+/**
+ * @brief findSpecial
+ * @param str
+ * @param delim
+ * @param scan instruction set to use, one the processor supports
+ * @return position of the first delim or quote char in str, str.size() if
+ * there is none
+ * Compares 16 (SSE2) or 32 (AVX2) chars at a time.
+ */
+std::size_t findSpecial(std::string_view str, char delim, Scan scan = bestScan());
+
+/**
+ * @brief tokenize
+ * @param str
+ * @param delim
+ * @param tokens filled with the parts, the same ones split gives
+ * @param scan instruction set to use, one the processor supports
+ */
+void tokenize(std::string_view str, char delim, Tokens& tokens, Scan scan = bestScan());
+
+/**
+ * @brief selectInRange
+ * @param values column the indexes point to, fewer than 2^31 values
+ * @param indexes
+ * @param low
+ * @param high
+ * @param selected filled with the indexes whose value is from low to high,
+ * in the same order
+ * @param scan instruction set to use, one the processor supports
+ * Filters 8 indexes at a time with AVX2, gathering their values and packing
+ * the selected ones with one shuffle. SSE2 has no gather, so it goes one at
+ * a time like the scalar loop, without branches.
+ */
+void selectInRange(const int* values, const std::vector<std::uint32_t>& indexes,
+                   int low, int high, std::vector<std::uint32_t>& selected,
+                   Scan scan = bestScan());
+
+/**
+ * @brief gatherValues
+ * @param values column the indexes point to, fewer than 2^31 values
+ * @param indexes
+ * @param gathered filled with the values of the indexes, in the same order
+ * @param scan instruction set to use, one the processor supports
+ * @return the sum, the smallest and the largest of the gathered values
+ * Gathers and sums 8 values at a time with AVX2, the sum in 64-bit lanes.
+ */
+Summary gatherValues(const int* values, const std::vector<std::uint32_t>& indexes,
+                     std::vector<int>& gathered, Scan scan = bestScan());
+
+/**
+ * @brief squaredDeviations
+ * @param values
+ * @param mean
+ * @param scan instruction set to use, one the processor supports
+ * @return the sum of the squared differences of the values from the mean
+ * Sums 8 values at a time with AVX2, in two vectors of 4 doubles.
+ */
+double squaredDeviations(const std::vector<int>& values, double mean, Scan scan = bestScan());
+
 /**
  * @brief split
  * @param str
  * @param delim
  * @return vector containing the parts, no delim chars
- * Splits the given string at every delim char.
+ * Splits the given string at every delim char outside quotes, and removes
+ * the quotes.
  */
 std::vector<std::string> split(const std::string& str, char delim = ';');
 
@@ -32,14 +139,22 @@ std::vector<std::string> split(const std::string& str, char delim = ';');
  * @param str
  * @return true if given string consists only of empty spaces
  */
-bool isEmpty(const std::string& str);
+bool isEmpty(std::string_view str);
 
 /**
  * @brief isNumeric
  * @param str
  * @return true if given string is numeric
  */
-bool isNumeric(const std::string& str);
+bool isNumeric(std::string_view str);
+
+/**
+ * @brief parseNumber
+ * @param str
+ * @param number set to the value of str
+ * @return true if str is a non-negative number that fits to an int
+ */
+bool parseNumber(std::string_view str, int& number);
 
 }
 